@@ -2,27 +2,19 @@
 // (C) SEGMENTATION FAULT Software Inc, 2003
 
 #include <stdio.h>
-
+
+#include "WordReader.h"
+
 // MAIN FUNCTION
-int main()
+int main(int argc, char * argv[])
 {
-    FILE * F = fopen("text.dat", "r");
-    if (!F) return 0;
+    WordReader R;
+    if (!R.open(argc > 1 ? argv[1] : "text.dat")) return 0;
     int WordCount = 0;
-    bool WordStarted = false;
-    while (true)
-    {
-	int C = fgetc(F);
-	if (C >= 'A' && C <= 'z') WordStarted = true;
-	else
-	    if (WordStarted) { WordCount++; WordStarted = false; }
-	if (C == EOF || feof(F))
-	{
-	    if (WordStarted) WordCount++;
-	    break;
-	}
-    }
-    fclose(F);
+    const char * W;
+    int L;
+    while (R.nextWord(W, L)) WordCount++;
     printf("\nWord count: %d.\n", WordCount);    
+    R.printStatistics(stderr);
     return 0;	
 }
@@ -4,9 +4,121 @@
 // Unautorized Duplication Appreciated!
 // =====================================
 
+#include <stdlib.h>
+#include <sys/time.h>
 #include "matrix.h"
 
-int main() {
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+// The naive product (i-j-k loops)
+static void naiveMultiply(const TMatrix &A, const TMatrix &B, TMatrix &R,
+                          int N) {
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++) {
+      double S = 0;
+      for (int k = 0; k < N; k++)
+        S += A[j][k] * B[k][i];
+      R[j][i] = S;
+    }
+}
+
+// The arithmetic with a temporary matrix for every operation
+static TMatrix sum(const TMatrix &A, const TMatrix &B) {
+  TMatrix R(A);
+  for (int j = 0; j < A.Height(); j++)
+    for (int i = 0; i < A.Width(); i++)
+      R[j][i] += B[j][i];
+  return R;
+}
+
+static TMatrix product(const TMatrix &A, const TMatrix &B) {
+  TMatrix R(B.Width(), A.Height());
+  R.Multiply(A, B);
+  return R;
+}
+
+// Compare the expressions with the temporaries for every operation
+static void benchmarkExpressions(int N) {
+  TMatrix A(N, N), B(N, N), C(N, N), D(N, N), R(N, N), S(N, N);
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++) {
+      A[j][i] = rand() / (double)RAND_MAX - 0.5;
+      B[j][i] = rand() / (double)RAND_MAX - 0.5;
+      C[j][i] = rand() / (double)RAND_MAX - 0.5;
+      D[j][i] = rand() / (double)RAND_MAX - 0.5;
+    }
+  double T0 = currentTime();
+  S = sum(product(product(A, B), C), D);
+  double T1 = currentTime();
+  R = A * B * C + D;
+  double T2 = currentTime();
+  double Error = 0;
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++)
+      Error = fmax(Error, fabs(R[j][i] - S[j][i]));
+  printf("A*B*C + D: temporaries %.3f s, expression %.3f s (error %lg)\n",
+         T1 - T0, T2 - T1, Error);
+
+  // The sums are cheap, so they are repeated
+  int Repeats = 1 + 100000000 / (N * N);
+  T0 = currentTime();
+  for (int r = 0; r < Repeats; r++)
+    S = sum(sum(A, B), C);
+  T1 = currentTime();
+  for (int r = 0; r < Repeats; r++)
+    R = A + B + C;
+  T2 = currentTime();
+  Error = 0;
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++)
+      Error = fmax(Error, fabs(R[j][i] - S[j][i]));
+  printf("A + B + C (%d times): temporaries %.3f s, expression %.3f s "
+         "(error %lg)\n",
+         Repeats, T1 - T0, T2 - T1, Error);
+}
+
+// Compare the products and determinants of random matrices N x N
+static void benchmark(int N) {
+  TMatrix A(N, N), B(N, N), R(N, N), P(N, N);
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++) {
+      A[j][i] = rand() / (double)RAND_MAX - 0.5;
+      B[j][i] = rand() / (double)RAND_MAX - 0.5;
+    }
+  double T0 = currentTime();
+  naiveMultiply(A, B, R, N);
+  double T1 = currentTime();
+  P.Multiply(A, B, 1);
+  double T2 = currentTime();
+  P.Multiply(A, B);
+  double T3 = currentTime();
+  double Error = 0;
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++)
+      Error = fmax(Error, fabs(P[j][i] - R[j][i]));
+  printf("Product %dx%d: naive %.3f s, blocked %.3f s, threaded %.3f s "
+         "(error %lg)\n",
+         N, N, T1 - T0, T2 - T1, T3 - T2, Error);
+
+  int Sign;
+  T0 = currentTime();
+  double Log = A.LogDet(Sign);
+  T1 = currentTime();
+  printf("Determinant: %s exp(%.6lf), %.3f s\n", (Sign < 0) ? "-" : "",
+         Log, T1 - T0);
+
+  benchmarkExpressions(N);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    benchmark(atoi(argv[1]));
+    return 0;
+  }
   int N = 0;
   printf("enter size: ");
   scanf("%d", &N);
@@ -8,44 +8,305 @@
 // Matrix class implementation
 // ===========================
 
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "matrix.h"
 
-double TMatrix::Det() {
-  if (W != H)
-    throw Exception("Matrix in not square");
-  TMatrix D(*this);
-  double det = 1.0;
-  for (int C = 0; C < D.W - 1; C++) {
-    // Searching maximum abs of element
-    int MaxIndex = -1;
-    double MaxElement = 0;
-    for (int K = C; K < D.H; K++) {
-      double Element = fabs(D.MATR(C, K));
-      if (Element > MaxElement) {
-        MaxIndex = K;
-        MaxElement = Element;
+const int ROW_BLOCK = 64;            // Rows of a block of product
+const int COL_BLOCK = 64;            // Columns of a block of product
+const int SUM_BLOCK = 256;           // Length of dot products in a block
+const int LU_BLOCK = 64;             // Columns of a panel of LU
+const int MIN_THREAD_WORK = 1 << 22; // Multiplications per thread
+
+// Dot product of the vectors of length K
+static inline double Dot(const double *A, const double *B, int K) {
+  double S = 0;
+  for (int k = 0; k < K; k++)
+    S += A[k] * B[k];
+  return S;
+}
+
+// C[j][i] += Alpha * (A[j] , BT[i]) for the rows j < N of C and A,
+// the columns i < M of C (the rows of BT); the rows of A and BT are K long.
+// LDA, LDB, LDC are the distances between rows.
+static void MulAddT(int N, int M, int K, double Alpha, const double *A,
+                    int LDA, const double *BT, int LDB, double *C, int LDC) {
+  for (int k0 = 0; k0 < K; k0 += SUM_BLOCK) {
+    int kb = (K - k0 < SUM_BLOCK) ? K - k0 : SUM_BLOCK;
+    for (int j0 = 0; j0 < N; j0 += ROW_BLOCK) {
+      int j1 = (N - j0 < ROW_BLOCK) ? N : j0 + ROW_BLOCK;
+      for (int i0 = 0; i0 < M; i0 += COL_BLOCK) {
+        int i1 = (M - i0 < COL_BLOCK) ? M : i0 + COL_BLOCK;
+        int j = j0;
+#ifdef __SSE2__
+        // Blocks 2 x 2 of product: 4 dot products at once
+        for (; j + 2 <= j1; j += 2) {
+          const double *A0 = A + j * LDA + k0;
+          const double *A1 = A0 + LDA;
+          double *C0 = C + j * LDC;
+          double *C1 = C0 + LDC;
+          int i = i0;
+          for (; i + 2 <= i1; i += 2) {
+            const double *B0 = BT + i * LDB + k0;
+            const double *B1 = B0 + LDB;
+            __m128d S00 = _mm_setzero_pd(), S01 = _mm_setzero_pd();
+            __m128d S10 = _mm_setzero_pd(), S11 = _mm_setzero_pd();
+            int k = 0;
+            for (; k + 2 <= kb; k += 2) {
+              __m128d a0 = _mm_loadu_pd(A0 + k), a1 = _mm_loadu_pd(A1 + k);
+              __m128d b0 = _mm_loadu_pd(B0 + k), b1 = _mm_loadu_pd(B1 + k);
+              S00 = _mm_add_pd(S00, _mm_mul_pd(a0, b0));
+              S01 = _mm_add_pd(S01, _mm_mul_pd(a0, b1));
+              S10 = _mm_add_pd(S10, _mm_mul_pd(a1, b0));
+              S11 = _mm_add_pd(S11, _mm_mul_pd(a1, b1));
+            }
+            double S[8];
+            _mm_storeu_pd(S, S00);
+            _mm_storeu_pd(S + 2, S01);
+            _mm_storeu_pd(S + 4, S10);
+            _mm_storeu_pd(S + 6, S11);
+            if (k < kb) { // Odd length
+              S[0] += A0[k] * B0[k];
+              S[2] += A0[k] * B1[k];
+              S[4] += A1[k] * B0[k];
+              S[6] += A1[k] * B1[k];
+            }
+            C0[i] += Alpha * (S[0] + S[1]);
+            C0[i + 1] += Alpha * (S[2] + S[3]);
+            C1[i] += Alpha * (S[4] + S[5]);
+            C1[i + 1] += Alpha * (S[6] + S[7]);
+          }
+          for (; i < i1; i++) {
+            const double *B0 = BT + i * LDB + k0;
+            C0[i] += Alpha * Dot(A0, B0, kb);
+            C1[i] += Alpha * Dot(A1, B0, kb);
+          }
+        }
+#endif
+        // The rest of rows (all rows without SSE2)
+        for (; j < j1; j++)
+          for (int i = i0; i < i1; i++)
+            C[j * LDC + i] += Alpha * Dot(A + j * LDA + k0,
+                                          BT + i * LDB + k0, kb);
       }
     }
-    if (MaxIndex == -1) {
-      //      D.Print();
-      return 0;
+  }
+}
+
+class MulJob {
+public:
+  int N, M, K;
+  double Alpha;
+  const double *A;
+  int LDA;
+  const double *BT;
+  int LDB;
+  double *C;
+  int LDC;
+
+  void Run() { MulAddT(N, M, K, Alpha, A, LDA, BT, LDB, C, LDC); }
+  static void *Start(void *Arg) {
+    ((MulJob *)Arg)->Run();
+    return 0;
+  }
+};
+
+// MulAddT by NumThreads threads (0: by the size), each one takes
+// a part of rows of C
+static void MulAddTThreaded(int N, int M, int K, double Alpha,
+                            const double *A, int LDA, const double *BT,
+                            int LDB, double *C, int LDC, int NumThreads) {
+  double Work = (double)N * M * K;
+  if (NumThreads <= 0) {
+    NumThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (NumThreads > Work / MIN_THREAD_WORK)
+      NumThreads = (int)(Work / MIN_THREAD_WORK);
+  }
+  if (NumThreads > N / 2)
+    NumThreads = N / 2;
+  if (NumThreads <= 1) {
+    MulAddT(N, M, K, Alpha, A, LDA, BT, LDB, C, LDC);
+    return;
+  }
+  MulJob *Jobs = new MulJob[NumThreads];
+  pthread_t *Threads = new pthread_t[NumThreads];
+  bool *Started = new bool[NumThreads];
+  for (int t = 0; t < NumThreads; t++) {
+    int j0 = (int)((long long)N * t / NumThreads) & ~1; // Even: 2 x 2 blocks
+    int j1 = (t + 1 < NumThreads)
+                 ? (int)((long long)N * (t + 1) / NumThreads) & ~1
+                 : N;
+    MulJob &Job = Jobs[t];
+    Job.N = j1 - j0;
+    Job.M = M;
+    Job.K = K;
+    Job.Alpha = Alpha;
+    Job.A = A + j0 * LDA;
+    Job.LDA = LDA;
+    Job.BT = BT;
+    Job.LDB = LDB;
+    Job.C = C + j0 * LDC;
+    Job.LDC = LDC;
+    Started[t] = (t > 0 &&
+                  pthread_create(&Threads[t], 0, &MulJob::Start, &Job) == 0);
+  }
+  for (int t = 0; t < NumThreads; t++) // The main thread runs the rest
+    if (!Started[t])
+      Jobs[t].Run();
+  for (int t = 1; t < NumThreads; t++)
+    if (Started[t])
+      pthread_join(Threads[t], 0);
+  delete[] Started;
+  delete[] Threads;
+  delete[] Jobs;
+}
+
+// BT = transposed B (B has N rows of M elements with distance LDB)
+static void Transpose(const double *B, int N, int M, int LDB, double *BT) {
+  for (int j0 = 0; j0 < N; j0 += ROW_BLOCK)
+    for (int i0 = 0; i0 < M; i0 += COL_BLOCK) {
+      int j1 = (N - j0 < ROW_BLOCK) ? N : j0 + ROW_BLOCK;
+      int i1 = (M - i0 < COL_BLOCK) ? M : i0 + COL_BLOCK;
+      for (int j = j0; j < j1; j++)
+        for (int i = i0; i < i1; i++)
+          BT[i * N + j] = B[j * LDB + i];
     }
-    // Swapping line [C] and [MaxIndex]
-    if (C != MaxIndex) {
-      D.SwapRows(C, MaxIndex);
-      det = -det;
+}
+
+TMatrix &TMatrix::Multiply(const TMatrix &A, const TMatrix &B,
+                           int NumThreads) {
+  if (A.W != B.H)
+    throw Exception("Cannot multiply matrices"); // width of M1 = height of M2
+  if (&A == this || &B == this) {
+    TMatrix R(B.W, A.H);
+    R.Multiply(A, B, NumThreads);
+    Swap(R);
+    return *this;
+  }
+  Reshape(B.W, A.H);
+  memset(Arr, 0, W * H * sizeof(double));
+  return AddProduct(A, B, 1, NumThreads);
+}
+
+TMatrix &TMatrix::AddProduct(const TMatrix &A, const TMatrix &B, double Alpha,
+                             int NumThreads) {
+  if (A.W != B.H || A.H != H || B.W != W)
+    throw Exception("Cannot multiply matrices");
+  if (&A == this || &B == this) {
+    TMatrix R(W, H);
+    R.AddProduct(A, B, Alpha, NumThreads);
+    return (*this += R);
+  }
+  double *BT = new double[B.W * B.H];
+  Transpose(B.Arr, B.H, B.W, B.W, BT);
+  MulAddTThreaded(H, W, A.W, Alpha, A.Arr, A.W, BT, B.H, Arr, W, NumThreads);
+  delete[] BT;
+  return *this;
+}
+
+// LU decomposition with partial pivoting of the matrix N x N in place:
+// the rows are swapped, L (without the unit diagonal) is below
+// the diagonal, U is on and above it. Returns the sign of permutation
+// of rows, 0 if the matrix is singular.
+// The panels of LU_BLOCK columns are decomposed in turn, the rest of
+// matrix is updated by one product of blocks.
+static int BlockedLU(double *A, int N) {
+  int Sign = 1;
+  double *UT = new double[LU_BLOCK * N];
+  for (int K0 = 0; K0 < N; K0 += LU_BLOCK) {
+    int K1 = (N - K0 < LU_BLOCK) ? N : K0 + LU_BLOCK;
+    for (int C = K0; C < K1; C++) {
+      // Searching maximum abs of element
+      int MaxIndex = -1;
+      double MaxElement = 0;
+      for (int K = C; K < N; K++) {
+        double Element = fabs(A[K * N + C]);
+        if (Element > MaxElement) {
+          MaxIndex = K;
+          MaxElement = Element;
+        }
+      }
+      if (MaxIndex == -1) {
+        delete[] UT;
+        return 0;
+      }
+      if (MaxIndex != C) {
+        double *R1 = A + C * N;
+        double *R2 = A + MaxIndex * N;
+        for (int i = 0; i < N; i++) {
+          double Temp = R1[i];
+          R1[i] = R2[i];
+          R2[i] = Temp;
+        }
+        Sign = -Sign;
+      }
+      // The columns of panel
+      const double *RC = A + C * N;
+      double Inv = 1 / RC[C];
+      for (int j = C + 1; j < N; j++) {
+        double *R = A + j * N;
+        double Lambda = (R[C] *= Inv);
+        for (int i = C + 1; i < K1; i++)
+          R[i] -= Lambda * RC[i];
+      }
     }
-    // Now [C][C] is nonzero.
-    double Norm = D.MATR(C, C);
-    for (int j = C + 1; j < D.H; j++) // j-th column
-    {
-      double Lambda = D.MATR(C, j) / Norm;
-      D.SubRows(j, C, Lambda);
+    if (K1 == N)
+      break;
+    // The rows of panel: U12 = L11^-1 A12
+    for (int j = K0 + 1; j < K1; j++) {
+      double *R = A + j * N;
+      for (int k = K0; k < j; k++) {
+        double Lambda = R[k];
+        const double *RK = A + k * N;
+        for (int i = K1; i < N; i++)
+          R[i] -= Lambda * RK[i];
+      }
     }
+    // A22 -= L21 U12
+    Transpose(A + K0 * N + K1, K1 - K0, N - K1, N, UT);
+    MulAddTThreaded(N - K1, N - K1, K1 - K0, -1, A + K1 * N + K0, N, UT,
+                    K1 - K0, A + K1 * N + K1, N, 0);
   }
-  //  D.Print();
-  for (int i = 0; i < D.W; i++)
-    det *= D.MATR(i, i);
+  delete[] UT;
+  return Sign;
+}
+
+int TMatrix::FactorLU() {
+  if (W != H)
+    throw Exception("Matrix in not square");
+  return BlockedLU(Arr, W);
+}
+
+double TMatrix::DetInPlace() {
+  double det = FactorLU();
+  for (int i = 0; i < W && det != 0; i++)
+    det *= MATR(i, i);
   return det;
 }
 
+double TMatrix::LogDetInPlace(int &Sign) {
+  Sign = FactorLU();
+  double Log = 0;
+  for (int i = 0; i < W && Sign != 0; i++) {
+    double D = MATR(i, i);
+    if (D < 0)
+      Sign = -Sign;
+    Log += log(fabs(D));
+  }
+  return Log;
+}
+
+double TMatrix::Det() const {
+  TMatrix LU(*this);
+  return LU.DetInPlace();
+}
+
+double TMatrix::LogDet(int &Sign) const {
+  TMatrix LU(*this);
+  return LU.LogDetInPlace(Sign);
+}
@@ -6,8 +6,80 @@
 
 #include "polynom.h"
 #include "stdio.h"
+#include <stdlib.h>
+#include <sys/time.h>
 
-int main() {
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+// Product and quotient of random polynoms of the degree
+static void measure(int Degree) {
+  double *CA = new double[Degree + 1];
+  double *CB = new double[Degree + 1];
+  for (int I = 0; I <= Degree; I++) {
+    CA[I] = rand() % 21 - 10;
+    CB[I] = rand() % 21 - 10;
+  }
+  CA[Degree] = 1;
+  CB[Degree] = 20.0 * Degree + 20; // Roots of B in |x| < 1: stable division
+  const TPolynom A(Degree, CA), B(Degree, CB);
+  CB[Degree] = 1; // Monic: roots in |x| > 1, the inverse series grows
+  const TPolynom M(Degree, CB);
+  delete[] CB;
+  delete[] CA;
+  double T0 = currentTime();
+  TPolynom C = A * B;
+  double T1 = currentTime();
+  const TPolynom Q = C / B;
+  double T2 = currentTime();
+  double Error = 0;
+  for (int I = 0; I <= Degree; I++)
+    Error = fmax(Error, fabs(Q[I] - A[I]));
+  printf("Degree %d: product %.3f s, quotient %.3f s (error %lg)\n", Degree,
+         T1 - T0, T2 - T1, Error);
+
+  // The product is rounded to exact integers, because the division
+  // by M magnifies any error of it; the quotient must be exact
+  const TPolynom AM = A * M;
+  double *CM = new double[2 * Degree + 1];
+  for (int I = 0; I <= 2 * Degree; I++)
+    CM[I] = nearbyint(AM[I]);
+  C = TPolynom(2 * Degree, CM);
+  delete[] CM;
+  T0 = currentTime();
+  const TPolynom QM = C / M;
+  T1 = currentTime();
+  Error = 0;
+  for (int I = 0; I <= Degree; I++)
+    Error = fmax(Error, fabs(QM[I] - A[I]));
+  printf("Monic divisor: quotient %.3f s (error %lg)\n", T1 - T0, Error);
+
+  const int N = 1000; // Values at N points
+  double *X = new double[N];
+  double *Y = new double[N];
+  for (int I = 0; I < N; I++)
+    X[I] = (double)I / N;
+  T0 = currentTime();
+  A.Values(N, X, Y);
+  T1 = currentTime();
+  Error = 0;
+  for (int I = 0; I < N; I++)
+    Error = fmax(Error, fabs(Y[I] - A.Value(X[I])) / fmax(1, fabs(Y[I])));
+  T2 = currentTime();
+  printf("Values at %d points: %.3f s, one by one %.3f s (error %lg)\n", N,
+         T1 - T0, T2 - T1, Error);
+  delete[] Y;
+  delete[] X;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    measure(atoi(argv[1]));
+    return 0;
+  }
   int N = 20;
 
   double cE[1] = {1.0};
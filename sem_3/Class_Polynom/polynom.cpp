@@ -4,53 +4,402 @@
 // Unautorized Duplication Appreciated!
 // =====================================
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "polynom.h"
 
+//
+// Multiplication: the schoolbook method for short factors, Karatsuba
+// method (O(n^1.58)) for the middle ones, FFT (O(n log n)) for the long
+// ones. The error of FFT is relative to the largest coefficients.
+// Division: the schoolbook method for short quotients or divisors,
+// otherwise the reversed quotient is the product of reversed dividend
+// and the inverse series of reversed divisor found by Newton iteration.
+// The inverse series grows fast when the divisor has roots |x| > 1, so
+// the quotient of Newton method is checked by the high coefficients of
+// the remainder, and the schoolbook method is used if they are not 0.
+//
+const int KARATSUBA_THRESHOLD = 32; // Minimal length of factor
+const int FFT_THRESHOLD = 512;      //
+const int NEWTON_THRESHOLD = 64;    // Minimal length of quotient & divisor
+const double NEWTON_TOLERANCE = 1e-9; // Relative error of Newton quotient
+
+class Complex {
+public:
+  double Re, Im;
+};
+
+// R[0..NA+NB-2] = A * B, the schoolbook method
+static void MulSchool(const double *A, int NA, const double *B, int NB,
+                      double *R) {
+  memset(R, 0, (NA + NB - 1) * sizeof(double));
+  for (int I = 0; I < NA; I++) {
+    double X = A[I];
+    for (int J = 0; J < NB; J++)
+      R[I + J] += X * B[J];
+  }
+}
+
+// Size of scratch of MulKaratsuba for factors of length N
+static int KaratsubaScratch(int N) {
+  int Size = 0;
+  while (N >= KARATSUBA_THRESHOLD) {
+    N -= N / 2;
+    Size += 4 * N;
+  }
+  return Size;
+}
+
+// R[0..2N-2] = A * B, the factors have N coefficients
+static void MulKaratsuba(const double *A, const double *B, int N, double *R,
+                         double *Scratch) {
+  if (N < KARATSUBA_THRESHOLD) {
+    MulSchool(A, N, B, N, R);
+    return;
+  }
+  int H = N / 2; // A = A0 + x^H A1, A0 has H coefficients,
+  int K = N - H; // A1 has K >= H ones
+  MulKaratsuba(A, B, H, R, Scratch);                 // A0 B0
+  R[2 * H - 1] = 0;                                  //
+  MulKaratsuba(A + H, B + H, K, R + 2 * H, Scratch); // A1 B1
+
+  // (A0 + A1)(B0 + B1) - A0 B0 - A1 B1
+  double *SA = Scratch;
+  double *SB = Scratch + K;
+  double *Z = Scratch + 2 * K;
+  for (int I = 0; I < K; I++) {
+    SA[I] = A[H + I];
+    SB[I] = B[H + I];
+  }
+  for (int I = 0; I < H; I++) {
+    SA[I] += A[I];
+    SB[I] += B[I];
+  }
+  MulKaratsuba(SA, SB, K, Z, Scratch + 4 * K);
+  for (int I = 0; I < 2 * H - 1; I++)
+    Z[I] -= R[I];
+  for (int I = 0; I < 2 * K - 1; I++)
+    Z[I] -= R[2 * H + I];
+  for (int I = 0; I < 2 * K - 1; I++)
+    R[H + I] += Z[I];
+}
+
+// Fast Fourier transform of N = 2^k values, Roots[J] = exp(-2 pi i J / N)
+static void FFT(Complex *X, int N, const Complex *Roots, bool Inverse) {
+  for (int I = 1, J = 0; I < N; I++) { // Bit reversal permutation
+    int Bit = N >> 1;
+    for (; J & Bit; Bit >>= 1)
+      J ^= Bit;
+    J ^= Bit;
+    if (I < J) {
+      Complex T = X[I];
+      X[I] = X[J];
+      X[J] = T;
+    }
+  }
+  for (int Len = 2; Len <= N; Len <<= 1) {
+    int Step = N / Len;
+    int Half = Len / 2;
+    for (int I = 0; I < N; I += Len)
+      for (int J = 0; J < Half; J++) {
+        double WRe = Roots[J * Step].Re;
+        double WIm = Inverse ? -Roots[J * Step].Im : Roots[J * Step].Im;
+        Complex &U = X[I + J];
+        Complex &V = X[I + J + Half];
+        double TRe = V.Re * WRe - V.Im * WIm;
+        double TIm = V.Re * WIm + V.Im * WRe;
+        V.Re = U.Re - TRe;
+        V.Im = U.Im - TIm;
+        U.Re += TRe;
+        U.Im += TIm;
+      }
+  }
+}
+
+// R[0..NA+NB-2] = A * B by FFT
+static void MulFFT(const double *A, int NA, const double *B, int NB,
+                   double *R) {
+  int N = 1;
+  while (N < NA + NB - 1)
+    N <<= 1;
+  Complex *Roots = new Complex[N / 2];
+  for (int J = 0; J < N / 2; J++) {
+    Roots[J].Re = cos(2 * M_PI * J / N);
+    Roots[J].Im = -sin(2 * M_PI * J / N);
+  }
+  // One transform of A + iB gives the transforms of both factors.
+  // B is scaled by a power of 2 to the size of A, otherwise the errors
+  // of the larger factor are large for the smaller one.
+  double MaxA = 0, MaxB = 0;
+  for (int I = 0; I < NA; I++)
+    if (fabs(A[I]) > MaxA)
+      MaxA = fabs(A[I]);
+  for (int I = 0; I < NB; I++)
+    if (fabs(B[I]) > MaxB)
+      MaxB = fabs(B[I]);
+  int ExpA = 0, ExpB = 0;
+  if (MaxA > 0 && MaxB > 0) {
+    frexp(MaxA, &ExpA);
+    frexp(MaxB, &ExpB);
+  }
+  Complex *X = new Complex[N];
+  Complex *Y = new Complex[N];
+  for (int I = 0; I < N; I++) {
+    X[I].Re = (I < NA) ? A[I] : 0;
+    X[I].Im = (I < NB) ? ldexp(B[I], ExpA - ExpB) : 0;
+  }
+  FFT(X, N, Roots, false);
+  for (int K = 0; K < N; K++) {
+    // A_K B_K = (X_K^2 - conj(X_{N-K})^2) / 4i
+    const Complex &P = X[K];
+    const Complex &Q = X[(N - K) & (N - 1)];
+    double DRe = (P.Re * P.Re - P.Im * P.Im) - (Q.Re * Q.Re - Q.Im * Q.Im);
+    double DIm = 2 * P.Re * P.Im + 2 * Q.Re * Q.Im;
+    Y[K].Re = DIm / 4;
+    Y[K].Im = -DRe / 4;
+  }
+  FFT(Y, N, Roots, true);
+  for (int I = 0; I < NA + NB - 1; I++)
+    R[I] = ldexp(Y[I].Re / N, ExpB - ExpA);
+  delete[] Y;
+  delete[] X;
+  delete[] Roots;
+}
+
+// R[0..NA+NB-2] = A * B
+static void MulCoeffs(const double *A, int NA, const double *B, int NB,
+                      double *R) {
+  if (NA < NB) { // A is the longer factor
+    const double *T = A;
+    A = B;
+    B = T;
+    int NT = NA;
+    NA = NB;
+    NB = NT;
+  }
+  if (NB < KARATSUBA_THRESHOLD) {
+    MulSchool(A, NA, B, NB, R);
+    return;
+  }
+  if (NB >= FFT_THRESHOLD) {
+    MulFFT(A, NA, B, NB, R);
+    return;
+  }
+  // A is cut into the pieces of length NB
+  double *Piece = new double[NB];
+  double *Prod = new double[2 * NB - 1];
+  double *Scratch = new double[KaratsubaScratch(NB)];
+  memset(R, 0, (NA + NB - 1) * sizeof(double));
+  for (int I = 0; I < NA; I += NB) {
+    int Len = (NA - I < NB) ? NA - I : NB;
+    memcpy(Piece, A + I, Len * sizeof(double));
+    memset(Piece + Len, 0, (NB - Len) * sizeof(double));
+    MulKaratsuba(Piece, B, NB, Prod, Scratch);
+    for (int J = 0; J < Len + NB - 1; J++)
+      R[I + J] += Prod[J];
+  }
+  delete[] Scratch;
+  delete[] Prod;
+  delete[] Piece;
+}
+
+// G[0..N-1] = 1 / F mod x^N, F has N coefficients, F[0] != 0
+static void InverseSeries(const double *F, int N, double *G) {
+  double *E = new double[2 * N];
+  double *D = new double[2 * N];
+  G[0] = 1 / F[0];
+  for (int K = 1; K < N;) {
+    // G = G (1 - (F G - 1)) mod x^K2, F G = 1 + O(x^K)
+    int K2 = (2 * K < N) ? 2 * K : N;
+    MulCoeffs(F, K2, G, K, E);
+    MulCoeffs(G, K, E + K, K2 - K, D);
+    for (int I = K; I < K2; I++)
+      G[I] = -D[I - K];
+    K = K2;
+  }
+  delete[] D;
+  delete[] E;
+}
+
 void TPolynom::Resize(int NewDegree) {
   if (NewDegree > Capacity) // Overflow => enlarge array
   {
     Capacity = NewDegree + RESERVED_SPACE;
     double *NewCoeffs = new double[Capacity + 1];
     memset(NewCoeffs, 0, (Capacity + 1) * sizeof(double));
-    for (int I = 0; I <= Degree; I++)
-      NewCoeffs[I] = Coeffs[I];
+    if (Coeffs != 0) // Not moved
+      for (int I = 0; I <= Degree; I++)
+        NewCoeffs[I] = Coeffs[I];
     delete[] Coeffs;
     Coeffs = NewCoeffs;
+  } else {
+    for (int I = Degree + 1; I <= NewDegree; I++)
+      Coeffs[I] = 0; // The old coefficients after a decrease of degree
   }
   Degree = NewDegree; // set new deg
 }
 
-TPolynom TPolynom::operator/(const TPolynom &P) const {
-  TPolynom A(*this); // Divisible
-  TPolynom R(0);     // Result
-  while (A.Degree >= P.Degree) {
-    TPolynom M(A.Degree - P.Degree); // multiplier
-    M.Coeffs[M.Degree] = A.HC() / P.HC();
-    A -= (M * P);
-    R += M;
-  }
+TPolynom TPolynom::operator*(const TPolynom &P) const {
+  TPolynom R(Degree + P.Degree);
+  MulCoeffs(Coeffs, Degree + 1, P.Coeffs, P.Degree + 1, R.Coeffs);
+  R.RecalcDegree();
   return R;
 }
 
-TPolynom &TPolynom::operator/=(const TPolynom &P) {
-  TPolynom R(0); // Result
-  while (Degree >= P.Degree) {
-    TPolynom M(Degree - P.Degree); // multiplier
-    M.Coeffs[M.Degree] = HC() / P.HC();
-    (*this) -= (M * P);
-    R += M;
+TPolynom &TPolynom::AddMul(const TPolynom &B, const TPolynom &C) {
+  int NB = B.Degree + 1;
+  int NC = C.Degree + 1;
+  Resize(Max(Degree, NB + NC - 2));
+  if (&B == this || &C == this || Max(NB, NC) >= KARATSUBA_THRESHOLD) {
+    double *Prod = new double[NB + NC - 1];
+    MulCoeffs(B.Coeffs, NB, C.Coeffs, NC, Prod);
+    for (int I = 0; I < NB + NC - 1; I++)
+      Coeffs[I] += Prod[I];
+    delete[] Prod;
+  } else {
+    for (int I = 0; I < NB; I++) {
+      double X = B.Coeffs[I];
+      for (int J = 0; J < NC; J++)
+        Coeffs[I + J] += X * C.Coeffs[J];
+    }
   }
-  return ((*this) = R);
+  return RecalcDegree();
 }
 
-TPolynom TPolynom::operator%(const TPolynom &P) const {
-  TPolynom A(*this); // Divisible
-  while (A.Degree >= P.Degree) {
-    TPolynom M(A.Degree - P.Degree); // multiplier
-    M.Coeffs[M.Degree] = A.HC() / P.HC();
-    A -= (M * P);
+TPolynom &TPolynom::AddMul(const TPolynom &B, double C) {
+  Resize(Max(Degree, B.Degree));
+  for (int I = 0; I <= B.Degree; I++)
+    Coeffs[I] += B.Coeffs[I] * C;
+  return RecalcDegree();
+}
+
+void TPolynom::Values(int N, const double *X, double *Y) const {
+  int K = 0;
+#ifdef __SSE2__
+  // Horner scheme by X^4 for 4 points (2 registers); the blocks of 4
+  // coefficients are summed by Estrin scheme, (C3 X + C2) X^2 + C1 X + C0,
+  // off the chain of dependent operations
+  for (; K + 4 <= N; K += 4) {
+    __m128d X1[2], X2[2], X4[2], V[2];
+    for (int J = 0; J < 2; J++) {
+      X1[J] = _mm_loadu_pd(X + K + 2 * J);
+      X2[J] = _mm_mul_pd(X1[J], X1[J]);
+      X4[J] = _mm_mul_pd(X2[J], X2[J]);
+      V[J] = _mm_set1_pd(Coeffs[Degree]);
+    }
+    int I = Degree - 1;
+    for (; (I + 1) % 4 != 0; I--) {
+      __m128d C = _mm_set1_pd(Coeffs[I]);
+      for (int J = 0; J < 2; J++)
+        V[J] = _mm_add_pd(_mm_mul_pd(V[J], X1[J]), C);
+    }
+    for (; I >= 3; I -= 4) {
+      __m128d C3 = _mm_set1_pd(Coeffs[I]);
+      __m128d C2 = _mm_set1_pd(Coeffs[I - 1]);
+      __m128d C1 = _mm_set1_pd(Coeffs[I - 2]);
+      __m128d C0 = _mm_set1_pd(Coeffs[I - 3]);
+      for (int J = 0; J < 2; J++) {
+        __m128d Hi = _mm_add_pd(_mm_mul_pd(C3, X1[J]), C2);
+        __m128d Lo = _mm_add_pd(_mm_mul_pd(C1, X1[J]), C0);
+        __m128d B = _mm_add_pd(_mm_mul_pd(Hi, X2[J]), Lo);
+        V[J] = _mm_add_pd(_mm_mul_pd(V[J], X4[J]), B);
+      }
+    }
+    for (int J = 0; J < 2; J++)
+      _mm_storeu_pd(Y + K + 2 * J, V[J]);
   }
-  return A;
+#endif
+  for (; K < N; K++) // The rest of points (all points without SSE2)
+    Y[K] = Value(X[K]);
+}
+
+void TPolynom::DivMod(const TPolynom &P, TPolynom &Q, TPolynom &R) const {
+  if (!P.HC())
+    throw Exception("TPolynom::DivMod (P): Division by zero");
+  int N = Degree;
+  int M = P.Degree;
+  if (N < M) {
+    Q = TPolynom(0);
+    R = *this;
+    return;
+  }
+  int NQ = N - M + 1; // Length of quotient
+  TPolynom Quot(NQ - 1);
+  TPolynom Rem(N);
+  memcpy(Rem.Coeffs, Coeffs, (N + 1) * sizeof(double));
+  bool Done = false;
+  if (NQ >= NEWTON_THRESHOLD && M >= NEWTON_THRESHOLD) {
+    // rev(Q) = rev(A) / rev(P) mod x^NQ
+    int NP = (M + 1 < NQ) ? M + 1 : NQ;
+    double *RevA = new double[NQ];
+    double *RevP = new double[NQ];
+    double *Inv = new double[NQ];
+    double *Prod = new double[2 * NQ - 1];
+    for (int I = 0; I < NQ; I++) {
+      RevA[I] = Coeffs[N - I];
+      RevP[I] = (I < NP) ? P.Coeffs[M - I] : 0;
+    }
+    InverseSeries(RevP, NQ, Inv);
+    MulCoeffs(RevA, NQ, Inv, NQ, Prod);
+    for (int I = 0; I < NQ; I++)
+      Quot.Coeffs[I] = Prod[NQ - 1 - I];
+    delete[] Prod;
+    delete[] Inv;
+    delete[] RevP;
+    delete[] RevA;
+
+    // R = A - Q P, the coefficients from M must be 0
+    double *QP = new double[N + 1];
+    MulCoeffs(Quot.Coeffs, NQ, P.Coeffs, M + 1, QP);
+    double Scale = 0, Error = 0;
+    for (int I = 0; I <= N; I++)
+      Scale = fmax(Scale, fabs(Coeffs[I]));
+    for (int I = M; I <= N; I++) {
+      double D = fabs(Coeffs[I] - QP[I]);
+      if (!(D <= Error)) // NaN is kept
+        Error = D;
+    }
+    if (Error <= NEWTON_TOLERANCE * Scale) {
+      for (int I = 0; I < M; I++)
+        Rem.Coeffs[I] -= QP[I];
+      memset(Rem.Coeffs + M, 0, (N - M + 1) * sizeof(double));
+      Done = true;
+    }
+    delete[] QP;
+  }
+  if (!Done) {
+    double H = P.Coeffs[M];
+    for (int I = NQ - 1; I >= 0; I--) {
+      double C = Rem.Coeffs[M + I] / H;
+      Quot.Coeffs[I] = C;
+      for (int J = 0; J < M; J++)
+        Rem.Coeffs[I + J] -= C * P.Coeffs[J];
+      Rem.Coeffs[M + I] = 0;
+    }
+  }
+  Rem.Degree = (M > 0) ? M - 1 : 0;
+  Q = Quot.RecalcDegree();
+  R = Rem.RecalcDegree();
+}
+
+TPolynom TPolynom::operator/(const TPolynom &P) const {
+  TPolynom Q, R;
+  DivMod(P, Q, R);
+  return Q;
+}
+
+TPolynom &TPolynom::operator/=(const TPolynom &P) {
+  TPolynom Q, R;
+  DivMod(P, Q, R);
+  return ((*this) = Q);
+}
+
+TPolynom TPolynom::operator%(const TPolynom &P) const {
+  TPolynom Q, R;
+  DivMod(P, Q, R);
+  return R;
 }
 
 void TPolynom::Print() const {
@@ -71,4 +420,3 @@ void TPolynom::Print() const {
       printf("^{%d}", I);
   }
 }
-
@@ -66,6 +66,29 @@ public:
     for (int I = 0; I <= Degree; I++)
       Coeffs[I] = P.Coeffs[I];
   }
+#if __cplusplus >= 201103L
+  // Move Constructor - takes the coefficients, P may be only assigned
+  // or destroyed after it
+  TPolynom(TPolynom &&P)
+      : Coeffs(P.Coeffs), Degree(P.Degree), Capacity(P.Capacity) {
+    P.Coeffs = 0;
+    P.Degree = 0;
+    P.Capacity = -1;
+  }
+  // Move Assignment - exchanges the coefficients
+  TPolynom &operator=(TPolynom &&P) {
+    double *C = Coeffs;
+    Coeffs = P.Coeffs;
+    P.Coeffs = C;
+    int D = Degree;
+    Degree = P.Degree;
+    P.Degree = D;
+    int Cap = Capacity;
+    Capacity = P.Capacity;
+    P.Capacity = Cap;
+    return *this;
+  }
+#endif
   // Destructor
   ~TPolynom() { delete[] Coeffs; }
 
@@ -124,7 +147,8 @@ public:
       if (I <= P.Degree)
         R.Coeffs[I] += P.Coeffs[I];
     }
-    return R.RecalcDegree();
+    R.RecalcDegree();
+    return R;
   }
   // Subtraction
   TPolynom operator-(const TPolynom &P) const {
@@ -136,41 +160,31 @@ public:
       if (I <= P.Degree)
         R.Coeffs[I] -= P.Coeffs[I];
     }
-    return R.RecalcDegree();
+    R.RecalcDegree();
+    return R;
   }
   // Self - multiplication
-  TPolynom &operator*=(const TPolynom &P) {
-    TPolynom R(Degree + P.Degree);
-    for (int I = 0; I <= Degree; I++)
-      for (int J = 0; J <= P.Degree; J++)
-        R.Coeffs[I + J] += Coeffs[I] * P.Coeffs[J];
-    return (*this = R.RecalcDegree());
-  }
+  TPolynom &operator*=(const TPolynom &P) { return (*this = (*this) * P); }
   TPolynom &operator*=(double Value) {
     for (int I = 0; I <= Degree; I++)
       Coeffs[I] *= Value;
     RecalcDegree();
     return *this;
   }
-  TPolynom operator*(const TPolynom P) const {
-    TPolynom R(Degree + P.Degree);
-    for (int I = 0; I <= Degree; I++)
-      for (int J = 0; J <= P.Degree; J++)
-        R.Coeffs[I + J] += Coeffs[I] * P.Coeffs[J];
-    return R.RecalcDegree();
-  }
+  TPolynom operator*(const TPolynom &P) const;
   TPolynom operator*(double Value) const {
     TPolynom R(*this);
     for (int I = 0; I <= Degree; I++)
-      R.Coeffs[I] /= Value;
-    return R.RecalcDegree();
+      R.Coeffs[I] *= Value;
+    R.RecalcDegree();
+    return R;
   }
   // Division
   TPolynom &operator/=(double Value) {
     if (!Value)
       throw Exception("TPolynom::operator /= (Value): Division by zero");
     for (int I = 0; I <= Degree; I++)
-      Coeffs[I] *= Value;
+      Coeffs[I] /= Value;
     return *this;
   }
   TPolynom operator/(double Value) const {
@@ -184,6 +198,22 @@ public:
   TPolynom operator/(const TPolynom &P) const;
   TPolynom operator%(const TPolynom &P) const;
   TPolynom &operator/=(const TPolynom &P);
+  // Quotient and remainder: *this = Q * P + R, deg R < deg P
+  void DivMod(const TPolynom &P, TPolynom &Q, TPolynom &R) const;
+
+  // Fused operations without temporary polynoms: *this += B * C
+  TPolynom &AddMul(const TPolynom &B, const TPolynom &C);
+  TPolynom &AddMul(const TPolynom &B, double C);
+
+  // Value at the point (Horner scheme)
+  double Value(double X) const {
+    double Y = Coeffs[Degree];
+    for (int I = Degree - 1; I >= 0; I--)
+      Y = Y * X + Coeffs[I];
+    return Y;
+  }
+  // Y[I] = value at X[I]: Estrin scheme for 4 points at once (SSE2)
+  void Values(int N, const double *X, double *Y) const;
 
   double HC() const { return Coeffs[Degree]; } // Highest coefficient
   double LC() const { return Coeffs[0]; }      // Lowest coefficient
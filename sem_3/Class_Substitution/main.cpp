@@ -4,10 +4,72 @@
 // Unautorized Duplication Appreciated!
 // =====================================
 
+#include <stdlib.h>
+#include <sys/time.h>
 #include "subst.h"
 #include "stdio.h"
 
-int main() {
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+// Compare the power by cycles with the power by repeated squaring
+// for a random substitution of N elements
+static void benchmark(int N) {
+  int *s = new int[N];
+  for (int i = 0; i < N; i++)
+    s[i] = i;
+  for (int i = N - 1; i > 0; i--) {
+    int j = (int)((((long long)rand() << 31) + rand()) % (i + 1));
+    int Temp = s[i];
+    s[i] = s[j];
+    s[j] = Temp;
+  }
+  TSubst S(s, N);
+  delete[] s;
+
+  const long long K = 1000000007;
+  double T0 = currentTime();
+  TSubst P(N), Q(S);
+  for (long long k = K; k > 0; k >>= 1) {
+    if (k & 1)
+      P *= Q;
+    Q *= Q;
+  }
+  double T1 = currentTime();
+  TSubst R = S.Power(K);
+  double T2 = currentTime();
+  bool Equal = true;
+  for (int i = 0; i < N; i++)
+    Equal = Equal && (P.At(i) == R.At(i));
+  printf("Power %lld: squaring %.3f s, cycles %.3f s (%s)\n", K, T1 - T0,
+         T2 - T1, Equal ? "equal" : "DIFFERENT");
+
+  T0 = currentTime();
+  TSubst I = S.Inverse();
+  T1 = currentTime();
+  P = S * I;
+  T2 = currentTime();
+  Equal = true;
+  for (int i = 0; i < N; i++)
+    Equal = Equal && (P.At(i) == i);
+  printf("Inverse %.3f s, product %.3f s (%s)\n", T1 - T0, T2 - T1,
+         Equal ? "identity" : "NOT IDENTITY");
+  printf("Cycles: %d, odd: %d\n", S.NumberOfCycles(), (int)S.IsOdd());
+  try {
+    printf("Order: %lld\n", S.Order());
+  } catch (TSubst::Exception &e) {
+    printf("Order: %s\n", e.EMsg);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    benchmark(atoi(argv[1]));
+    return 0;
+  }
   // substitution test
   const int max = 10;
   int s[max];
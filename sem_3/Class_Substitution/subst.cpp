@@ -8,47 +8,134 @@
 // SUBSTITUTION Class implementation
 // =================================
 
+#include <string.h>
+#include <limits.h>
+
 #include "subst.h"
 
-TSubst &TSubst::operator*=(const TSubst &S) {
-  // if multiplier is greater, extend self.
-  if (N < S.N) {
-    int *NewArr = new int[S.N];
-    for (int i = 0; i < N; i++)
-      NewArr[i] = Arr[i];
-    for (int i = N; i < S.N; i++)
-      NewArr[i] = i;
-    delete[] Arr;
-    Arr = NewArr;
-    N = S.N;
+const int PREFETCH_DISTANCE = 32;      // Elements between prefetch and read
+const int MIN_PREFETCH_SIZE = 1 << 20; // Smaller tables stay in cache
+
+// R[i] = A[P[i]], i < N. The reads of a large table miss the cache at
+// random, so the element needed PREFETCH_DISTANCE steps later is
+// prefetched to keep several misses in flight.
+static void Gather(const int *A, const int *P, int *R, int N) {
+  int i = 0;
+  if (N >= MIN_PREFETCH_SIZE) {
+    for (; i < N - PREFETCH_DISTANCE; i++) {
+      __builtin_prefetch(A + P[i + PREFETCH_DISTANCE]);
+      R[i] = A[P[i]];
+    }
   }
-  TSubst Temp(*this);
-  for (int i = 0; i < S.N; i++)
-    Arr[i] = Temp.Arr[S.Arr[i]];
+  for (; i < N; i++)
+    R[i] = A[P[i]];
+}
+
+TSubst &TSubst::Compose(const TSubst &A, const TSubst &B) {
+  // A or B may be *this, so the product is made in a new array
+  int n = (A.N > B.N) ? A.N : B.N;
+  int *R = new int[n];
+  if (A.N == B.N) {
+    Gather(A.Arr, B.Arr, R, n);
+  } else {
+    for (int i = 0; i < n; i++) {
+      int X = (i < B.N) ? B.Arr[i] : i;
+      R[i] = (X < A.N) ? A.Arr[X] : X;
+    }
+  }
+  delete[] Arr;
+  Arr = R;
+  N = n;
+  ForgetCycles();
   return *this;
 }
 
-bool TSubst::IsOdd() const {
-  TSubst S(*this);
-
-  int Pos = 0;
-  int Start = 0;
-  int Length = 0;
-  while (true) {
-    Start = Pos;
-    int Value = S.Arr[Start];
-    S.Arr[Start] = -1;
-    while (Value != Start) {
-      int NewValue = S.Arr[Value];
-      S.Arr[Value] = -1;
-      Value = NewValue;
-      Length++;
+void TSubst::FindCycles() const {
+  if (Cycles != 0)
+    return;
+  Cycles = new int[N];
+  CycleStart = new int[N + 1];
+  bool *Visited = new bool[N];
+  memset(Visited, 0, N * sizeof(bool));
+  NumCycles = 0;
+  int k = 0;
+  for (int i = 0; i < N; i++) {
+    if (Visited[i])
+      continue;
+    CycleStart[NumCycles++] = k;
+    int X = i;
+    do {
+      if (Visited[X]) { // Two elements are mapped to X
+        delete[] Visited;
+        ForgetCycles();
+        throw Exception("Not a substitution");
+      }
+      Visited[X] = true;
+      Cycles[k++] = X;
+      X = Arr[X];
+    } while (X != i);
+  }
+  CycleStart[NumCycles] = k;
+  delete[] Visited;
+}
+
+TSubst TSubst::Power(long long K) const {
+  FindCycles();
+  TSubst R(N);
+  for (int C = 0; C < NumCycles; C++) {
+    const int *Cycle = Cycles + CycleStart[C];
+    int Length = CycleStart[C + 1] - CycleStart[C];
+    int Shift = (int)(K % Length);
+    if (Shift < 0)
+      Shift += Length;
+    // Cycle[j] goes to Cycle[(j + Shift) % Length]
+    for (int j = 0; j < Length - Shift; j++)
+      R.Arr[Cycle[j]] = Cycle[j + Shift];
+    for (int j = Length - Shift; j < Length; j++)
+      R.Arr[Cycle[j]] = Cycle[j + Shift - Length];
+  }
+  return R;
+}
+
+TSubst TSubst::Inverse() const {
+  TSubst R(N);
+  for (int i = 0; i < N; i++)
+    R.Arr[Arr[i]] = i;
+  return R;
+}
+
+static long long GCD(long long A, long long B) {
+  while (B != 0) {
+    long long Temp = A % B;
+    A = B;
+    B = Temp;
+  }
+  return A;
+}
+
+long long TSubst::Order() const {
+  FindCycles();
+  // Every length is taken once
+  bool *Seen = new bool[N + 1];
+  memset(Seen, 0, (N + 1) * sizeof(bool));
+  long long Result = 1;
+  for (int C = 0; C < NumCycles; C++) {
+    int Length = CycleStart[C + 1] - CycleStart[C];
+    if (Seen[Length])
+      continue;
+    Seen[Length] = true;
+    long long Factor = Result / GCD(Result, Length);
+    if (Factor > LLONG_MAX / Length) {
+      delete[] Seen;
+      throw Exception("Order is too large");
     }
-    while (Pos < N && S.Arr[Pos] == -1)
-      Pos++;
-    if (Pos == S.N)
-      break;
+    Result = Factor * Length;
   }
-  return (Length & 1);
+  delete[] Seen;
+  return Result;
 }
 
+bool TSubst::IsOdd() const {
+  // A cycle of length L is a product of L - 1 transpositions
+  return ((N - NumberOfCycles()) & 1);
+}
@@ -12,20 +12,57 @@
 class TSubst {
   int *Arr;
   int N;
+  // The cycle decomposition, found when it is needed: the elements of
+  // cycle C are Cycles[CycleStart[C]..CycleStart[C + 1] - 1], each one
+  // is mapped to the next one (the last one to the first)
+  mutable int *Cycles;
+  mutable int *CycleStart;
+  mutable int NumCycles;
 
 public:
-  TSubst(int *arr, int n) : Arr(0), N(n) {
+  class Exception {
+  public:
+    const char *EMsg;
+    Exception() : EMsg("") {}
+    Exception(const char *ErrorMessage) : EMsg(ErrorMessage) {}
+  };
+
+  explicit TSubst(int n) // identity
+      : Arr(0), N(n), Cycles(0), CycleStart(0), NumCycles(0) {
+    Arr = new int[N];
+    for (int i = 0; i < N; i++)
+      Arr[i] = i;
+  }
+  TSubst(int *arr, int n)
+      : Arr(0), N(n), Cycles(0), CycleStart(0), NumCycles(0) {
     Arr = new int[N];
     for (int i = 0; i < N; i++)
       Arr[i] = arr[i] % N;
   }
-  TSubst(const TSubst &S) : Arr(0), N(S.N) {
+  TSubst(const TSubst &S)
+      : Arr(0), N(S.N), Cycles(0), CycleStart(0), NumCycles(0) {
     Arr = new int[N];
     for (int i = 0; i < N; i++)
       Arr[i] = S.Arr[i] % N;
   }
-  ~TSubst() { delete[] Arr; }
+#if __cplusplus >= 201103L
+  TSubst(TSubst &&S)
+      : Arr(S.Arr), N(S.N), Cycles(S.Cycles), CycleStart(S.CycleStart),
+        NumCycles(S.NumCycles) {
+    S.Arr = 0;
+    S.N = 0;
+    S.Cycles = 0;
+    S.CycleStart = 0;
+  }
+#endif
+  ~TSubst() {
+    delete[] Arr;
+    ForgetCycles();
+  }
   TSubst &operator=(const TSubst &S) {
+    if (&S == this)
+      return *this;
+    ForgetCycles();
     if (N < S.N) {
       delete[] Arr;
       Arr = new int[S.N];
@@ -35,14 +72,38 @@ public:
       Arr[i] = S.Arr[i] % N;
     return *this;
   }
-  TSubst &operator*=(const TSubst &S);
-  TSubst operator*(const TSubst &S) {
+  TSubst &operator*=(const TSubst &S) { return Compose(*this, S); }
+  TSubst operator*(const TSubst &S) const {
     TSubst R(*this);
     R *= S;
     return R;
   }
+  // *this = A * B, i.e. (A * B)(X) = A(B(X)); the shorter substitution
+  // is extended by identity
+  TSubst &Compose(const TSubst &A, const TSubst &B);
   int At(int X) const { return Arr[X % N]; }
+  int Size() const { return N; }
   bool IsOdd() const;
+
+  // The cycles (including fixed points) in the order of their smallest
+  // elements, each one starts from its smallest element
+  int NumberOfCycles() const {
+    FindCycles();
+    return NumCycles;
+  }
+  int CycleLength(int C) const {
+    FindCycles();
+    return CycleStart[C + 1] - CycleStart[C];
+  }
+  const int *Cycle(int C) const {
+    FindCycles();
+    return Cycles + CycleStart[C];
+  }
+  // K-th power (K may be negative) by shifting of every cycle, O(N)
+  TSubst Power(long long K) const;
+  TSubst Inverse() const;
+  // The least common multiple of the lengths of cycles
+  long long Order() const;
   void Print() const {
     for (int i = 0; i < N; i++)
       printf("===");
@@ -54,6 +115,16 @@ public:
       printf("%3d", Arr[i]);
     printf("\n");
   }
+
+private:
+  void FindCycles() const;
+  void ForgetCycles() const {
+    delete[] Cycles;
+    delete[] CycleStart;
+    Cycles = 0;
+    CycleStart = 0;
+    NumCycles = 0;
+  }
 };
 
 #endif
@@ -155,3 +155,25 @@ double TMatrix::Det() {
   return det;
 }
 
+
+TMatrix &TMatrix::AddProduct(const TMatrix &A, const TMatrix &B,
+                             double Alpha) {
+  if (A.W != B.H || A.H != H || B.W != W)
+    throw Exception("Cannot multiply matrices");
+  if (&A == this || &B == this) {
+    TMatrix R(W, H);
+    R.AddProduct(A, B, Alpha);
+    return (*this += R);
+  }
+  // The rows of B are added to the rows of *this (i-k-j order, so all
+  // loops go along the rows)
+  for (int j = 0; j < H; j++)
+    for (int k = 0; k < A.W; k++) {
+      double Lambda = Alpha * A.Arr[j * A.W + k];
+      const double *Row = B.Arr + k * B.W;
+      double *Dest = Arr + j * W;
+      for (int i = 0; i < W; i++)
+        Dest[i] += Lambda * Row[i];
+    }
+  return *this;
+}
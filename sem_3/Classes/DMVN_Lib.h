@@ -66,7 +66,9 @@ public:
     return TVector(X * Value, Y * Value, Z * Value);
   }
   // Scalar product
-  double operator|(const TVector &V) const { return X * V.X, Y * V.Y, Z * V.Z; }
+  double operator|(const TVector &V) const {
+    return X * V.X + Y * V.Y + Z * V.Z;
+  }
   // Cross product
   TVector operator&(const TVector &V) const {
     return TVector(Y * V.Z - Z * V.Y, Z * V.X - X * V.Z, X * V.Y - Y * V.X);
@@ -340,7 +342,19 @@ public:
 #define MATR(i, j) Arr[j * W + i]
 const double EPSILON = 0.00000000001;
 
-class TMatrix {
+class TMatrix;
+
+// The arithmetic operators make expressions (TMatrixSum, TMatrixScaled,
+// TMatrixProduct) which are computed on assignment: a sum is one loop
+// without temporaries, a product is added to the result by AddProduct.
+template <class E> class TMatrixExpr {
+public:
+  const E &Self() const { return static_cast<const E &>(*this); }
+};
+
+template <bool Elementwise> class TMatrixEval;
+
+class TMatrix : public TMatrixExpr<TMatrix> {
   double *Arr;
   int W; // width
   int H; // height
@@ -374,6 +388,24 @@ public:
       for (int j = 0; j < H; j++)
         MATR(i, j) = M.Arr[j * W + i];
   }
+  template <class E>
+  TMatrix(const TMatrixExpr<E> &X)
+      : Arr(0), W(X.Self().Width()), H(X.Self().Height()) {
+    Arr = new double[W * H];
+    TMatrixEval<E::ELEMENTWISE>::Assign(X.Self(), *this);
+  }
+#if __cplusplus >= 201103L
+  TMatrix(TMatrix &&M) : Arr(M.Arr), W(M.W), H(M.H) {
+    M.Arr = 0;
+    M.W = 0;
+    M.H = 0;
+  }
+  TMatrix &operator=(TMatrix &&M) {
+    Swap(M);
+    return *this;
+  }
+#endif
+  ~TMatrix() { delete[] Arr; }
   TMatrix &operator=(const TMatrix &M) {
     if (M.W != W || M.H != H) {
       W = M.W;
@@ -386,7 +418,27 @@ public:
         MATR(i, j) = M.MATR(i, j);
     return *this;
   }
+  template <class E> TMatrix &operator=(const TMatrixExpr<E> &X) {
+    const E &Y = X.Self();
+    if (!E::ELEMENTWISE && Y.Uses(this)) {
+      // The product reads the matrix while it is computed
+      TMatrix R(Y);
+      Swap(R);
+      return *this;
+    }
+    Reshape(Y.Width(), Y.Height());
+    TMatrixEval<E::ELEMENTWISE>::Assign(Y, *this);
+    return *this;
+  }
+  template <class E> TMatrix &operator+=(const TMatrixExpr<E> &X) {
+    return AddExpr(X.Self(), 1);
+  }
+  template <class E> TMatrix &operator-=(const TMatrixExpr<E> &X) {
+    return AddExpr(X.Self(), -1);
+  }
   double *operator[](int j) const { return Arr + W * j; }
+  int Width() const { return W; }
+  int Height() const { return H; }
   TMatrix &operator*=(double Value) {
     for (int j = 0; j < H; j++)
       for (int i = 0; i < W; i++)
@@ -401,25 +453,26 @@ public:
         MATR(i, j) /= Value;
     return *this;
   }
-  TMatrix operator*(const TMatrix &M) {
-    if (W != M.H)
-      throw Exception("Cannot multiply matrices"); // width of M1 = height of M2
-    TMatrix R(M.W, H);
-    for (int j = 0; j < R.H; j++)
-      for (int i = 0; i < R.W; i++)
-        for (int k = 0; k < W; k++)
-          R.MATR(i, j) += MATR(k, j) * M.MATR(i, k);
-    return R;
-  }
   TMatrix &operator*=(const TMatrix &M) {
     if (W != M.H)
       throw Exception("Cannot multiply matrices"); // width of M1 = height of M2
     TMatrix R(M.W, H);
-    for (int j = 0; j < R.H; j++)
-      for (int i = 0; i < R.W; i++)
-        for (int k = 0; k < W; k++)
-          R.MATR(i, j) += MATR(k, j) * M.MATR(i, k);
-    return (*this = R);
+    R.AddProduct(*this, M);
+    Swap(R);
+    return *this;
+  }
+  // *this += Alpha * A * B (*this must have the size of product)
+  TMatrix &AddProduct(const TMatrix &A, const TMatrix &B, double Alpha = 1);
+  void Swap(TMatrix &M) {
+    double *TempArr = Arr;
+    Arr = M.Arr;
+    M.Arr = TempArr;
+    int Temp = W;
+    W = M.W;
+    M.W = Temp;
+    Temp = H;
+    H = M.H;
+    M.H = Temp;
   }
   void SwapRows(int M, int N) {
     if (M == N)
@@ -454,6 +507,188 @@ public:
     }
     printf("\n");
   }
+
+  // The matrix as a node of expression
+  enum { ELEMENTWISE = 1 };
+  double At(int k) const { return Arr[k]; }
+  bool Uses(const TMatrix *M) const { return M == this; }
+
+private:
+  // Change the size, the elements are undefined
+  void Reshape(int Width, int Height) {
+    if (W * H != Width * Height) {
+      delete[] Arr;
+      Arr = 0;
+      Arr = new double[Width * Height];
+    }
+    W = Width;
+    H = Height;
+  }
+  template <class E> TMatrix &AddExpr(const E &X, double Alpha) {
+    if (X.Width() != W || X.Height() != H)
+      throw Exception("Cannot add matrices");
+    if (!E::ELEMENTWISE && X.Uses(this)) {
+      TMatrix R(X);
+      AddExpr(R, Alpha);
+    } else {
+      TMatrixEval<E::ELEMENTWISE>::AddTo(X, *this, Alpha);
+    }
+    return *this;
+  }
 };
 
+// Evaluation of an expression: Dest = X or Dest += Alpha * X
+// (Dest has the size of X). The elementwise expressions are computed
+// by a loop, the others add their terms one by one.
+template <> class TMatrixEval<true> {
+public:
+  template <class E> static void Assign(const E &X, TMatrix &Dest) {
+    double *D = Dest[0];
+    int N = X.Width() * X.Height();
+    for (int k = 0; k < N; k++)
+      D[k] = X.At(k);
+  }
+  template <class E>
+  static void AddTo(const E &X, TMatrix &Dest, double Alpha) {
+    double *D = Dest[0];
+    int N = X.Width() * X.Height();
+    for (int k = 0; k < N; k++)
+      D[k] += Alpha * X.At(k);
+  }
+};
+
+template <> class TMatrixEval<false> {
+public:
+  template <class E> static void Assign(const E &X, TMatrix &Dest) {
+    memset(Dest[0], 0, X.Width() * X.Height() * sizeof(double));
+    X.AddTerms(Dest, 1);
+  }
+  template <class E>
+  static void AddTo(const E &X, TMatrix &Dest, double Alpha) {
+    X.AddTerms(Dest, Alpha);
+  }
+};
+
+// A node keeps a matrix by reference and a node by value (the nodes are
+// temporaries which live until the end of full expression)
+template <class E> class TMatrixOperand {
+public:
+  typedef const E Type;
+};
+
+template <> class TMatrixOperand<TMatrix> {
+public:
+  typedef const TMatrix &Type;
+};
+
+// The matrix computed from an operand of product
+template <class E> class TMatrixValue {
+  const TMatrix M;
+
+public:
+  TMatrixValue(const E &X) : M(X) {}
+  const TMatrix &Value() const { return M; }
+};
+
+template <> class TMatrixValue<TMatrix> {
+  const TMatrix &M;
+
+public:
+  TMatrixValue(const TMatrix &X) : M(X) {}
+  const TMatrix &Value() const { return M; }
+};
+
+// A + Sign * B
+template <class L, class R>
+class TMatrixSum : public TMatrixExpr<TMatrixSum<L, R> > {
+  typename TMatrixOperand<L>::Type A;
+  typename TMatrixOperand<R>::Type B;
+  double Sign;
+
+public:
+  enum { ELEMENTWISE = L::ELEMENTWISE && R::ELEMENTWISE };
+
+  TMatrixSum(const L &X, const R &Y, double S) : A(X), B(Y), Sign(S) {
+    if (A.Width() != B.Width() || A.Height() != B.Height())
+      throw TMatrix::Exception("Cannot add matrices");
+  }
+  int Width() const { return A.Width(); }
+  int Height() const { return A.Height(); }
+  double At(int k) const { return A.At(k) + Sign * B.At(k); }
+  bool Uses(const TMatrix *M) const { return A.Uses(M) || B.Uses(M); }
+  void AddTerms(TMatrix &Dest, double Alpha) const {
+    TMatrixEval<L::ELEMENTWISE>::AddTo(A, Dest, Alpha);
+    TMatrixEval<R::ELEMENTWISE>::AddTo(B, Dest, Alpha * Sign);
+  }
+};
+
+// Alpha * A
+template <class E> class TMatrixScaled : public TMatrixExpr<TMatrixScaled<E> > {
+  typename TMatrixOperand<E>::Type A;
+  double Alpha;
+
+public:
+  enum { ELEMENTWISE = E::ELEMENTWISE };
+
+  TMatrixScaled(const E &X, double Value) : A(X), Alpha(Value) {}
+  int Width() const { return A.Width(); }
+  int Height() const { return A.Height(); }
+  double At(int k) const { return Alpha * A.At(k); }
+  bool Uses(const TMatrix *M) const { return A.Uses(M); }
+  void AddTerms(TMatrix &Dest, double Beta) const {
+    TMatrixEval<E::ELEMENTWISE>::AddTo(A, Dest, Beta * Alpha);
+  }
+};
+
+// A * B; the operands which are not matrices are computed first
+template <class L, class R>
+class TMatrixProduct : public TMatrixExpr<TMatrixProduct<L, R> > {
+  typename TMatrixOperand<L>::Type A;
+  typename TMatrixOperand<R>::Type B;
+
+public:
+  enum { ELEMENTWISE = 0 };
+
+  TMatrixProduct(const L &X, const R &Y) : A(X), B(Y) {
+    if (A.Width() != B.Height())
+      throw TMatrix::Exception("Cannot multiply matrices");
+  }
+  int Width() const { return B.Width(); }
+  int Height() const { return A.Height(); }
+  bool Uses(const TMatrix *M) const { return A.Uses(M) || B.Uses(M); }
+  void AddTerms(TMatrix &Dest, double Alpha) const {
+    TMatrixValue<L> X(A);
+    TMatrixValue<R> Y(B);
+    Dest.AddProduct(X.Value(), Y.Value(), Alpha);
+  }
+};
+
+template <class L, class R>
+inline TMatrixSum<L, R> operator+(const TMatrixExpr<L> &A,
+                                  const TMatrixExpr<R> &B) {
+  return TMatrixSum<L, R>(A.Self(), B.Self(), 1);
+}
+
+template <class L, class R>
+inline TMatrixSum<L, R> operator-(const TMatrixExpr<L> &A,
+                                  const TMatrixExpr<R> &B) {
+  return TMatrixSum<L, R>(A.Self(), B.Self(), -1);
+}
+
+template <class E>
+inline TMatrixScaled<E> operator*(double Alpha, const TMatrixExpr<E> &A) {
+  return TMatrixScaled<E>(A.Self(), Alpha);
+}
+
+template <class E>
+inline TMatrixScaled<E> operator*(const TMatrixExpr<E> &A, double Alpha) {
+  return TMatrixScaled<E>(A.Self(), Alpha);
+}
+
+template <class L, class R>
+inline TMatrixProduct<L, R> operator*(const TMatrixExpr<L> &A,
+                                      const TMatrixExpr<R> &B) {
+  return TMatrixProduct<L, R>(A.Self(), B.Self());
+}
+
 #endif
@@ -0,0 +1,189 @@
+// class WordReader, implementation
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "WordReader.h"
+
+static const long long BLOCK_SIZE = 1 << 20; // 1 Mb for non-mapped input
+
+static double currentTime() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+
+static inline bool isLetter(unsigned char c) {
+  return (unsigned char)((c | 0x20) - 'a') < 26;
+}
+
+#ifdef __SSE2__
+// Return the 16-bit mask of letters in 16 bytes starting from p
+static inline int letterMask(const char *p) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  // Convert to lower case and shift 'a'..'z' to -128..-103,
+  // then one signed comparison gives the letters
+  v = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  v = _mm_sub_epi8(v, _mm_set1_epi8('a' + 128));
+  v = _mm_cmplt_epi8(v, _mm_set1_epi8(-128 + 26));
+  return _mm_movemask_epi8(v);
+}
+#endif
+
+WordReader::WordReader()
+    : fd(-1), mapped(false), buffer(0), capacity(0), bufLen(0), pos(0),
+      endOfFile(true), numBytes(0), startTime(0.) {}
+
+bool WordReader::open(const char *fileName /* = 0 */) {
+  close();
+  startTime = currentTime();
+  if (fileName == 0) {
+    fd = 0; // Standard input
+  } else {
+    fd = ::open(fileName, O_RDONLY);
+    if (fd < 0)
+      return false;
+  }
+  endOfFile = false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    if (st.st_size == 0) {
+      endOfFile = true; // Empty file, nothing to read
+      return true;
+    }
+    void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      mapped = true;
+      buffer = (char *)p;
+      bufLen = st.st_size;
+      capacity = bufLen;
+      numBytes = bufLen;
+      endOfFile = true;
+      return true;
+    }
+  }
+
+  // Cannot map: read by blocks
+  capacity = BLOCK_SIZE;
+  buffer = new char[capacity];
+  return true;
+}
+
+void WordReader::close() {
+  if (mapped)
+    munmap(buffer, capacity);
+  else
+    delete[] buffer;
+  if (fd > 0)
+    ::close(fd);
+  fd = (-1);
+  mapped = false;
+  buffer = 0;
+  capacity = 0;
+  bufLen = 0;
+  pos = 0;
+  endOfFile = true;
+}
+
+// Read the next block after the bufLen bytes kept in buffer
+bool WordReader::fillBuffer() {
+  assert(!mapped);
+  if (endOfFile)
+    return false;
+  if (bufLen >= capacity) {
+    // A very long word: extend the buffer
+    char *newBuffer = new char[2 * capacity];
+    memmove(newBuffer, buffer, bufLen);
+    delete[] buffer;
+    buffer = newBuffer;
+    capacity *= 2;
+  }
+  ssize_t n;
+  do {
+    n = read(fd, buffer + bufLen, capacity - bufLen);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    endOfFile = true;
+    return false;
+  }
+  bufLen += n;
+  numBytes += n;
+  return true;
+}
+
+long long WordReader::skipNonLetters(long long i) const {
+#ifdef __SSE2__
+  while (i + 16 <= bufLen) {
+    int m = letterMask(buffer + i);
+    if (m != 0)
+      return i + __builtin_ctz(m);
+    i += 16;
+  }
+#endif
+  while (i < bufLen && !isLetter(buffer[i]))
+    ++i;
+  return i;
+}
+
+long long WordReader::skipLetters(long long i) const {
+#ifdef __SSE2__
+  while (i + 16 <= bufLen) {
+    int m = (~letterMask(buffer + i)) & 0xffff;
+    if (m != 0)
+      return i + __builtin_ctz(m);
+    i += 16;
+  }
+#endif
+  while (i < bufLen && isLetter(buffer[i]))
+    ++i;
+  return i;
+}
+
+bool WordReader::nextWord(const char *&word, int &len) {
+  while (true) {
+    long long beg = skipNonLetters(pos);
+    if (beg >= bufLen) {
+      // Buffer is exhausted, all its contents may be dropped
+      pos = 0;
+      bufLen = 0;
+      if (mapped || !fillBuffer())
+        return false;
+      continue;
+    }
+    long long end = skipLetters(beg);
+    if (end >= bufLen && !mapped && !endOfFile) {
+      // The word may be continued in the next block:
+      // move its beginning to the start of buffer and read more
+      bufLen -= beg;
+      memmove(buffer, buffer + beg, bufLen);
+      pos = 0;
+      fillBuffer();
+      continue;
+    }
+    word = buffer + beg;
+    len = (int)(end - beg);
+    pos = end;
+    return true;
+  }
+}
+
+double WordReader::elapsedTime() const { return currentTime() - startTime; }
+
+void WordReader::printStatistics(FILE *f /* = stderr */) const {
+  double t = elapsedTime();
+  double gb = (double)numBytes / 1e9;
+  fprintf(f, "Scanned %lld bytes in %.3f sec", numBytes, t);
+  if (t > 0.)
+    fprintf(f, " (%.3f GB/s)", gb / t);
+  fprintf(f, "\n");
+}
@@ -40,9 +40,14 @@
 #include <ctype.h>
 
 #include "HashSet.h"
+#include "WordReader.h"
 
 static void printHelp();
 
+// A word either owns its characters (capacity > 0),
+// or is a view of external memory (capacity == 0), for instance,
+// of the buffer of WordReader. A view is not null-terminated;
+// a copy of any word owns a null-terminated string.
 class Word : public HashSetKey {
   char *str;
   int len;
@@ -52,66 +57,73 @@ public:
   Word();
   Word(const char *s, int l);
   Word(const Word &w);
-  virtual ~Word() { delete[] str; }
+  virtual ~Word() { clear(); }
   virtual Word *clone() const { return new Word(*this); }
 
+  Word &operator=(const Word &w);
+
   int length() const { return len; }
   int size() const { return len; }
-  void initialize();
 
-  // Add a character to the end of word
-  Word &operator+=(int c);
+  // Make the word a view of l characters starting from s
+  void setView(const char *s, int l);
 
-  // Convertor to C-string
+  // Convertor to C-string (only for words that own their characters)
   operator const char *() { return str; }
   const char *getString() const { return str; }
 
   virtual bool operator==(const HashSetKey &s) const {
-    return (strcmp(str, ((Word &)s).str) == 0);
+    const Word &w = (const Word &)s;
+    return (len == w.len && memcmp(str, w.str, len) == 0);
   }
 
   virtual int hashValue() const;
+
+private:
+  void assign(const Word &w);
+  void clear();
 };
 
 // Implementation of class Word
 Word::Word() : str(0), len(0), capacity(0) {}
 
 Word::Word(const char *s, int l)
-    : str(new char(l + 1)), len(l), capacity(len + 1) {
+    : str(new char[l + 1]), len(l), capacity(len + 1) {
   memmove(str, s, len);
   str[len] = 0;
 }
 
-Word::Word(const Word &w) : str(0), len(w.len), capacity(w.capacity) {
-  if (w.len > 0) {
-    str = new char[w.capacity];
-    memmove(str, w.str, capacity);
+Word::Word(const Word &w) : str(0), len(0), capacity(0) { assign(w); }
+
+Word &Word::operator=(const Word &w) {
+  if (this != &w) {
+    clear();
+    assign(w);
   }
+  return *this;
 }
 
-void Word::initialize() {
-  len = 0;
-  if (capacity > 0)
-    str[0] = 0;
+// Copy the characters of w (the word must be empty)
+void Word::assign(const Word &w) {
+  len = w.len;
+  capacity = len + 1;
+  str = new char[capacity];
+  memmove(str, w.str, len);
+  str[len] = 0;
 }
 
-// Add a character to the end of word
-Word &Word::operator+=(int c) {
-  if (capacity <= len + 1) {
-    // Allocate additional space
-    int extent = capacity / 8;
-    if (extent < 16)
-      extent = 16;
-    char *new_str = new char[capacity + extent];
-    memmove(new_str, str, len);
+void Word::clear() {
+  if (capacity > 0)
     delete[] str;
-    capacity += extent;
-    str = new_str;
-  }
-  str[len] = (char)c;
-  ++len;
-  str[len] = 0;
-  return *this;
+  str = 0;
+  len = 0;
+  capacity = 0;
+}
+
+void Word::setView(const char *s, int l) {
+  clear();
+  str = (char *)s;
+  len = l;
 }
 
 int Word::hashValue() const {
@@ -144,44 +156,37 @@ public:
 
 int main(int argc, char *argv[]) {
   HashSet set(5009); // 5009 is a prime number (the hashtable size)
-  FILE *input;
+  WordReader input;
+  const char *fileName = 0; // Standard input
   if (argc > 1) {
     if (*argv[1] == '-') {
       printHelp();
       return 0;
     }
-    input = fopen(argv[1], "r");
-    if (input == 0) {
-      perror("Cannot open an input file");
-      return 1;
-    }
-  } else
-    input = stdin;
+    fileName = argv[1];
+  }
+  if (!input.open(fileName)) {
+    perror("Cannot open an input file");
+    return 1;
+  }
 
-  bool wasLetter = false;
-  bool endOfFileDetected = false;
+  // The current word is a view of the input buffer,
+  // it is copied only when the set adds a new key
   Word CurrentWord;
-  while (!endOfFileDetected) {
-    int c = fgetc(input);
-    if (isalpha(c)) {
-      CurrentWord += c;
-      wasLetter = true;
+  const char *s;
+  int l;
+  while (input.nextWord(s, l)) {
+    CurrentWord.setView(s, l);
+    Integer *val = (Integer *)set.value(&CurrentWord);
+    if (val != 0) {
+      ++(val->number);
     } else {
-      if (wasLetter) {
-        if (set.contains(&CurrentWord)) {
-          Integer *val = (Integer *)set.value(&CurrentWord);
-          ++(val->number);
-        } else {
-          Integer unit(1);
-          set.add(&CurrentWord, &unit);
-        }
-        CurrentWord.initialize();
-      }
-      wasLetter = false;
-      endOfFileDetected = (c == EOF);
+      Integer unit(1);
+      set.add(&CurrentWord, &unit);
     }
   }
   printf("File reading completed.\n");
+  input.printStatistics();
 
   //     
   // =================================================
@@ -0,0 +1,347 @@
+// =====================================
+// Char|Int pointer|array analyser
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "Batch.h"
+
+__thread Analysis *currentAnalysis = 0;
+
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+void Analysis::reserve(int n) {
+  if (outLen + n <= outCapacity)
+    return;
+  int newCapacity = (outCapacity > 0) ? 2 * outCapacity : 256;
+  while (newCapacity < outLen + n)
+    newCapacity *= 2;
+  char *newOut = new char[newCapacity];
+  if (outLen > 0)
+    memmove(newOut, out, outLen);
+  delete[] out;
+  out = newOut;
+  outCapacity = newCapacity;
+}
+
+void Analysis::append(const char *s, int n) {
+  reserve(n);
+  memmove(out + outLen, s, n);
+  outLen += n;
+}
+
+void Analysis::appendString(const string &s) {
+  reserve(s.length() + 1);
+  s.copyTo(out + outLen);
+  outLen += s.length();
+}
+
+void Analysis::parse(const char *text, int len) {
+  double t0 = currentTime();
+  currentAnalysis = this;
+  parseText(text, len);
+  currentAnalysis = 0;
+  time = currentTime() - t0;
+}
+
+void Analysis::declaration(const string &v, const string &t) {
+  char buf[32];
+  sprintf(buf, "\t%d\t", line);
+  append("decl\t");
+  append(fileName);
+  append(buf);
+  appendString(v);
+  appendString(t);
+  if (out[outLen - 1] == ' ') // "... char "
+    --outLen;
+  append("\n");
+  ++numDeclarations;
+}
+
+void Analysis::error(const char *msg) {
+  char buf[32];
+  sprintf(buf, "\t%d\t", line);
+  append("error\t");
+  append(fileName);
+  append(buf);
+  append(msg);
+  append("\n");
+  ++numErrors;
+}
+
+void Analysis::summary() {
+  char buf[128];
+  sprintf(buf, "\t%d\t%d\t%d\t%.3f\n", line - 1, numDeclarations, numErrors,
+          time * 1000.);
+  append("file\t");
+  append(fileName);
+  append(buf);
+}
+
+void Analysis::flush(FILE *f) {
+  fwrite(out, 1, outLen, f);
+  delete[] out;
+  out = 0;
+  outLen = 0;
+  outCapacity = 0;
+}
+
+// Read the file ("-" is the standard input), add the new line
+// at the end if it is missing. Returns 0 if the file cannot be read.
+static char *readFile(const char *name, int &len) {
+  FILE *f = (strcmp(name, "-") == 0) ? stdin : fopen(name, "rb");
+  if (f == 0)
+    return 0;
+  int capacity = 4096;
+  char *text = new char[capacity];
+  len = 0;
+  while (true) {
+    if (len + 1 >= capacity) {
+      char *newText = new char[2 * capacity];
+      memmove(newText, text, len);
+      delete[] text;
+      text = newText;
+      capacity *= 2;
+    }
+    int n = fread(text + len, 1, capacity - 1 - len, f);
+    if (n <= 0)
+      break;
+    len += n;
+  }
+  bool failed = (ferror(f) != 0);
+  if (f != stdin)
+    fclose(f);
+  if (failed) {
+    delete[] text;
+    return 0;
+  }
+  if (len == 0 || text[len - 1] != '\n')
+    text[len++] = '\n';
+  return text;
+}
+
+static int compareNames(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// The names of files to analyse
+class FileList {
+  char **names;
+  int len;
+  int capacity;
+
+public:
+  FileList() : names(0), len(0), capacity(0) {}
+  ~FileList() {
+    for (int i = 0; i < len; ++i)
+      delete[] names[i];
+    delete[] names;
+  }
+
+  int size() const { return len; }
+  const char *operator[](int i) const { return names[i]; }
+
+  // Add the file, or the files of directory recursively (sorted by name).
+  // The links to directories inside are skipped, they may make a loop.
+  void addPath(const char *path, bool followLinks = true) {
+    struct stat st;
+    if (strcmp(path, "-") == 0 || stat(path, &st) != 0 ||
+        !S_ISDIR(st.st_mode)) {
+      add(path); // An error of reading is reported later
+      return;
+    }
+    if (!followLinks && lstat(path, &st) == 0 && S_ISLNK(st.st_mode))
+      return;
+    DIR *dir = opendir(path);
+    if (dir == 0) {
+      add(path);
+      return;
+    }
+    int start = len;
+    int pathLen = strlen(path);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != 0) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        continue;
+      char *name = new char[pathLen + strlen(entry->d_name) + 2];
+      strcpy(name, path);
+      if (pathLen > 0 && path[pathLen - 1] != '/')
+        strcat(name, "/");
+      strcat(name, entry->d_name);
+      add(name);
+      delete[] name;
+    }
+    closedir(dir);
+
+    // The entries are replaced by their files
+    int end = len;
+    qsort(names + start, end - start, sizeof(char *), &compareNames);
+    char **entries = new char *[end - start];
+    memmove(entries, names + start, (end - start) * sizeof(char *));
+    len = start;
+    for (int i = 0; i < end - start; ++i) {
+      addPath(entries[i], false);
+      delete[] entries[i];
+    }
+    delete[] entries;
+  }
+
+private:
+  FileList(const FileList &);            // Copying is prohibited
+  FileList &operator=(const FileList &); //
+
+  void add(const char *name) {
+    if (len >= capacity) {
+      int newCapacity = (capacity > 0) ? 2 * capacity : 64;
+      char **newNames = new char *[newCapacity];
+      if (len > 0)
+        memmove(newNames, names, len * sizeof(char *));
+      delete[] names;
+      names = newNames;
+      capacity = newCapacity;
+    }
+    names[len] = new char[strlen(name) + 1];
+    strcpy(names[len], name);
+    ++len;
+  }
+};
+
+// The files are taken by threads in turn; the analysis of a file
+// is marked as done, and the main thread writes them in order
+class BatchPool {
+public:
+  const FileList *files;
+  Analysis *results;
+  bool *done;
+  int next; // The next file to analyse
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  // Analyse the next file, return false if there are no files
+  bool work() {
+    int i = __sync_fetch_and_add(&next, 1);
+    if (i >= files->size())
+      return false;
+    Analysis &a = results[i];
+    a.fileName = (*files)[i];
+    int len;
+    char *text = readFile(a.fileName, len);
+    if (text != 0) {
+      a.parse(text, len);
+      delete[] text;
+    } else {
+      a.line = 0;
+      a.error("cannot read file");
+      a.line = 1;
+    }
+    a.summary();
+    pthread_mutex_lock(&mutex);
+    done[i] = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  bool isDone(int i) {
+    pthread_mutex_lock(&mutex);
+    bool res = done[i];
+    pthread_mutex_unlock(&mutex);
+    return res;
+  }
+
+  void wait(int i) {
+    pthread_mutex_lock(&mutex);
+    while (!done[i])
+      pthread_cond_wait(&cond, &mutex);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  static void *start(void *arg) {
+    BatchPool *pool = (BatchPool *)arg;
+    StringArena arena; // The ropes of thread
+    StringArena::setCurrent(&arena);
+    while (pool->work()) {
+    }
+    StringArena::setCurrent(0);
+    return 0;
+  }
+};
+
+int runBatch(char **names, int numNames, int numThreads) {
+  double t0 = currentTime();
+  FileList files;
+  for (int i = 0; i < numNames; ++i)
+    files.addPath(names[i]);
+  if (numNames == 0)
+    files.addPath("-");
+
+  int n = files.size();
+  if (numThreads <= 0)
+    numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (numThreads > n)
+    numThreads = n;
+  if (numThreads < 1)
+    numThreads = 1;
+
+  BatchPool pool;
+  pool.files = &files;
+  pool.results = new Analysis[n];
+  pool.done = new bool[n];
+  for (int i = 0; i < n; ++i)
+    pool.done[i] = false;
+  pool.next = 0;
+  pthread_mutex_init(&pool.mutex, 0);
+  pthread_cond_init(&pool.cond, 0);
+
+  // The main thread is a worker too; it writes the finished analyses
+  // between the files
+  pthread_t *threads = new pthread_t[numThreads];
+  bool *started = new bool[numThreads];
+  for (int i = 1; i < numThreads; ++i)
+    started[i] = (pthread_create(&threads[i], 0, &BatchPool::start, &pool) ==
+                  0);
+
+  StringArena arena;
+  StringArena::setCurrent(&arena);
+  int numDeclarations = 0;
+  int numErrors = 0;
+  int written = 0;
+  while (written < n) {
+    if (!pool.work())
+      pool.wait(written);
+    while (written < n && pool.isDone(written)) {
+      Analysis &a = pool.results[written];
+      a.flush(stdout);
+      numDeclarations += a.numDeclarations;
+      numErrors += a.numErrors;
+      ++written;
+    }
+  }
+  StringArena::setCurrent(0);
+
+  for (int i = 1; i < numThreads; ++i) {
+    if (started[i])
+      pthread_join(threads[i], 0);
+  }
+  delete[] started;
+  delete[] threads;
+  pthread_cond_destroy(&pool.cond);
+  pthread_mutex_destroy(&pool.mutex);
+  delete[] pool.done;
+  delete[] pool.results;
+
+  printf("total\t%d\t%d\t%d\t%.3f\n", n, numDeclarations, numErrors,
+         (currentTime() - t0) * 1000.);
+  return numErrors;
+}
@@ -0,0 +1,74 @@
+// =====================================
+// Char|Int pointer|array analyser
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+//
+// Batch mode: the declarations of files (or of the standard input) are
+// analysed without prompts, one declaration per line, and the results
+// are printed as records separated by tabs:
+//
+//   decl   <file> <line> <description>
+//   error  <file> <line> <message>
+//   file   <file> <lines> <declarations> <errors> <milliseconds>
+//   total  <files> <declarations> <errors> <milliseconds>
+//
+// The files are parsed by a pool of threads; the state of parser and
+// scanner is local to a thread, and the records of a file are collected
+// in its Analysis, so the output is in the order of the files.
+//
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "str.h"
+
+class Analysis {
+  char *out; // The records of file
+  int outLen;
+  int outCapacity;
+
+public:
+  const char *fileName;
+  int line; // The current line
+  int numDeclarations;
+  int numErrors;
+  double time; // Seconds
+
+  Analysis()
+      : out(0), outLen(0), outCapacity(0), fileName(0), line(1),
+        numDeclarations(0), numErrors(0), time(0.) {}
+  ~Analysis() { delete[] out; }
+
+  // Parse the text (it ends with a new line)
+  void parse(const char *text, int len);
+
+  void declaration(const string &v, const string &t);
+  void error(const char *msg);
+  void summary();
+
+  // Write the records and free them
+  void flush(FILE *f);
+
+private:
+  Analysis(const Analysis &);            // Copying is prohibited
+  Analysis &operator=(const Analysis &); //
+
+  void append(const char *s, int n);
+  void append(const char *s) { append(s, strlen(s)); }
+  void appendString(const string &s);
+  void reserve(int n);
+};
+
+// The analysis of calling thread, 0 in the interactive mode
+extern __thread Analysis *currentAnalysis;
+
+// Parse the text by yyparse (calc.tab.cpp)
+void parseText(const char *text, int len);
+
+// Analyse the files and directories (the standard input if there are no
+// names) by numThreads threads (0: a thread per processor).
+// Returns the number of errors.
+int runBatch(char **names, int numNames, int numThreads);
+
+#endif
@@ -86,6 +86,7 @@ enum yytokentype {
 #include "parser.h"
 
 #include "str.h"
+#include "Batch.h"
 
 /* Any C++ code may be added here... */
 
@@ -613,14 +614,17 @@ int yyparse();
 #endif
 #endif /* ! YYPARSE_PARAM */
 
+/* The state of parser is local to a thread, so several threads
+   parse at once (see Batch.h) */
+
 /* The lookahead symbol.  */
-int yychar;
+__thread int yychar;
 
 /* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
+__thread YYSTYPE yylval;
 
 /* Number of syntax errors so far.  */
-int yynerrs;
+__thread int yynerrs;
 
 /*----------.
 | yyparse.  |
@@ -869,20 +873,36 @@ yyreduce:
   case 3:
 #line 33 "calc.ypp"
   {
-    printf("= %s%s\n", yyvsp[-1].s, yyvsp[-2].s);
+    if (currentAnalysis != 0) {
+      currentAnalysis->declaration(yyvsp[-1], yyvsp[-2]);
+      ++currentAnalysis->line;
+    } else {
+      printf("= ");
+      yyvsp[-1].write(stdout);
+      yyvsp[-2].write(stdout);
+      printf("\n");
+    }
+    StringArena::current()->clear();
     ;
   } break;
 
   case 4:
 #line 34 "calc.ypp"
   {
-    return 0;
+    if (currentAnalysis == 0)
+      YYACCEPT; /* The stacks are freed */
+    ++currentAnalysis->line; /* Empty lines are skipped in batch mode */
     ;
   } break;
 
   case 5:
 #line 35 "calc.ypp"
   {
+    if (currentAnalysis != 0) {
+      ++currentAnalysis->line;
+      yyerrok; /* The errors of every line are reported */
+    }
+    StringArena::current()->clear();
     ;
   } break;
 
@@ -1131,15 +1151,52 @@ yyreturn:
 #line 52 "calc.ypp"
 
 /*================ 3. The Program Section ================================*/
-int main() {
-  printf("Enter an expression to evaluate (empty line for quit):\n");
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_bytes(const char *bytes, int len);
+void yy_delete_buffer(YY_BUFFER_STATE b);
+
+void parseText(const char *text, int len) {
+  YY_BUFFER_STATE buffer = yy_scan_bytes(text, len);
   yyparse();
-  return 0;
+  yy_delete_buffer(buffer);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-b [-j threads] [file|directory ...]]\n", name);
+  fprintf(stderr, "  -b  analyse the declarations of files in batch mode\n");
+  fprintf(stderr, "      (the standard input if there are no files)\n");
+  fprintf(stderr, "  -j  number of threads (a thread per processor by "
+                  "default)\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc == 1) {
+    printf("Enter an expression to evaluate (empty line for quit):\n");
+    yyparse();
+    return 0;
+  }
+  if (strcmp(argv[1], "-b") != 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  int numThreads = 0;
+  int i = 2;
+  if (i < argc && strcmp(argv[i], "-j") == 0) {
+    if (i + 1 >= argc || (numThreads = atoi(argv[i + 1])) <= 0) {
+      usage(argv[0]);
+      return 1;
+    }
+    i += 2;
+  }
+  return (runBatch(argv + i, argc - i, numThreads) == 0) ? 0 : 1;
 }
 
 /* Parse error diagnostics */
 int yyerror(const char *s) {
-  printf("%s\n", s);
+  if (currentAnalysis != 0)
+    currentAnalysis->error(s);
+  else
+    printf("%s\n", s);
   return 0;
 }
 
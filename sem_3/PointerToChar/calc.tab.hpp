@@ -58,5 +58,5 @@ typedef int YYSTYPE;
 #define YYSTYPE_IS_TRIVIAL 1
 #endif
 
-extern YYSTYPE yylval;
+extern __thread YYSTYPE yylval;
 
@@ -99,8 +99,8 @@
 
 typedef struct yy_buffer_state *YY_BUFFER_STATE;
 
-extern int yyleng;
-extern FILE *yyin, *yyout;
+extern __thread int yyleng;
+extern __thread FILE *yyin, *yyout;
 
 #define EOB_ACT_CONTINUE_SCAN 0
 #define EOB_ACT_END_OF_FILE 1
@@ -195,7 +195,7 @@ struct yy_buffer_state {
 #define YY_BUFFER_EOF_PENDING 2
 };
 
-static YY_BUFFER_STATE yy_current_buffer = 0;
+static __thread YY_BUFFER_STATE yy_current_buffer = 0;
 
 /* We provide macros for accessing buffer states in case in the
  * future we want to put the buffer states in a more general
@@ -204,21 +204,21 @@ static YY_BUFFER_STATE yy_current_buffer = 0;
 #define YY_CURRENT_BUFFER yy_current_buffer
 
 /* yy_hold_char holds the character lost when yytext is formed. */
-static char yy_hold_char;
+static __thread char yy_hold_char;
 
-static int yy_n_chars; /* number of characters read into yy_ch_buf */
+static __thread int yy_n_chars; /* number of characters read into yy_ch_buf */
 
-int yyleng;
+__thread int yyleng;
 
 /* Points to current character in buffer. */
-static char *yy_c_buf_p = (char *)0;
-static int yy_init = 1;  /* whether we need to initialize */
-static int yy_start = 0; /* start state number */
+static __thread char *yy_c_buf_p = (char *)0;
+static __thread int yy_init = 1;  /* whether we need to initialize */
+static __thread int yy_start = 0; /* start state number */
 
 /* Flag which is used to allow yywrap()'s to do buffer switches
  * instead of setting up a fresh yyin.  A bit of a hack ...
  */
-static int yy_did_buffer_switch_on_eof;
+static __thread int yy_did_buffer_switch_on_eof;
 
 void yyrestart YY_PROTO((FILE * input_file));
 
@@ -257,9 +257,9 @@ static void yy_flex_free YY_PROTO((void *));
 #define YY_AT_BOL() (yy_current_buffer->yy_at_bol)
 
 typedef unsigned char YY_CHAR;
-FILE *yyin = (FILE *)0, *yyout = (FILE *)0;
+__thread FILE *yyin = (FILE *)0, *yyout = (FILE *)0;
 typedef int yy_state_type;
-extern char *yytext;
+extern __thread char *yytext;
 #define yytext_ptr yytext
 
 static yy_state_type yy_get_previous_state YY_PROTO((void));
@@ -321,8 +321,8 @@ static yyconst short int yy_chk[48] = {
     1,  1,  5,  15, 20, 5,  15, 19, 18, 14, 13, 11, 7,  3,  23, 23,
     23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23};
 
-static yy_state_type yy_last_accepting_state;
-static char *yy_last_accepting_cpos;
+static __thread yy_state_type yy_last_accepting_state;
+static __thread char *yy_last_accepting_cpos;
 
 /* The intent behind this definition is that it'll catch
  * any uses of REJECT which flex missed.
@@ -331,7 +331,7 @@ static char *yy_last_accepting_cpos;
 #define yymore() yymore_used_but_not_detected
 #define YY_MORE_ADJ 0
 #define YY_RESTORE_YY_MORE_OFFSET
-char *yytext;
+__thread char *yytext;
 #line 1 "scan.l"
 #define INITIAL 0
 /*        The Scanner for Formula Calculator               */
@@ -383,9 +383,9 @@ static int input YY_PROTO((void));
 #endif
 
 #if YY_STACK_USED
-static int yy_start_stack_ptr = 0;
-static int yy_start_stack_depth = 0;
-static int *yy_start_stack = 0;
+static __thread int yy_start_stack_ptr = 0;
+static __thread int yy_start_stack_depth = 0;
+static __thread int *yy_start_stack = 0;
 #ifndef YY_NO_PUSH_STATE
 static void yy_push_state YY_PROTO((int new_state));
 #endif
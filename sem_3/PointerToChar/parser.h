@@ -16,6 +16,12 @@
 
 #define YYSTYPE string
 
+/* string may be copied by memcpy, so the stacks of parser grow */
+/* (in memory allocated by malloc) up to the large depth        */
+#define YYSTYPE_IS_TRIVIAL 1
+#define YYSTACK_USE_ALLOCA 0
+#define YYMAXDEPTH 10000000
+
 #include "calc.tab.hpp" /* File generated automatically by bison: */
                         /* contains the definitions of terminals  */
 
@@ -0,0 +1,152 @@
+// =====================================
+// Char|Int pointer|array analyser
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+#include "str.h"
+
+static StringArena commonArena;
+static __thread StringArena *currentArena = 0;
+
+StringArena *StringArena::current() {
+  return (currentArena != 0) ? currentArena : &commonArena;
+}
+
+void StringArena::setCurrent(StringArena *arena) { currentArena = arena; }
+
+int StringArena::addNode() {
+  if (numNodes >= nodesCapacity) {
+    int newCapacity = (nodesCapacity > 0) ? 2 * nodesCapacity : 256;
+    Node *newNodes = new Node[newCapacity];
+    if (numNodes > 0)
+      memmove(newNodes, nodes, numNodes * sizeof(Node));
+    delete[] nodes;
+    nodes = newNodes;
+    nodesCapacity = newCapacity;
+  }
+  return numNodes++;
+}
+
+int StringArena::leaf(const char *s, int len) {
+  if (numChars + len > charsCapacity) {
+    int newCapacity = (charsCapacity > 0) ? 2 * charsCapacity : 4096;
+    while (newCapacity < numChars + len)
+      newCapacity *= 2;
+    char *newChars = new char[newCapacity];
+    if (numChars > 0)
+      memmove(newChars, chars, numChars);
+    delete[] chars;
+    chars = newChars;
+    charsCapacity = newCapacity;
+  }
+  memmove(chars + numChars, s, len);
+  int i = addNode();
+  Node &n = nodes[i];
+  n.left = (-1);
+  n.right = (-1);
+  n.len = len;
+  n.text = numChars;
+  numChars += len;
+  return i;
+}
+
+int StringArena::concat(int left, int right, int len) {
+  int i = addNode();
+  Node &n = nodes[i];
+  n.left = left;
+  n.right = right;
+  n.len = len;
+  n.text = 0;
+  return i;
+}
+
+void StringArena::copy(int node, char *dst) const {
+  // A rope made by += is as deep as long, so the nodes are visited
+  // by a loop with a stack of right parts
+  int localStack[64];
+  int *stack = localStack;
+  int stackCapacity = 64;
+  int sp = 0;
+  while (true) {
+    const Node &n = nodes[node];
+    if (n.left >= 0) {
+      if (sp >= stackCapacity) {
+        int *newStack = new int[2 * stackCapacity];
+        memmove(newStack, stack, sp * sizeof(int));
+        if (stack != localStack)
+          delete[] stack;
+        stack = newStack;
+        stackCapacity *= 2;
+      }
+      stack[sp++] = n.right;
+      node = n.left;
+      continue;
+    }
+    memmove(dst, chars + n.text, n.len);
+    dst += n.len;
+    if (sp == 0)
+      break;
+    node = stack[--sp];
+  }
+  if (stack != localStack)
+    delete[] stack;
+}
+
+string &string::operator=(const char *ss) {
+  int n = strlen(ss);
+  len = n;
+  if (n <= SMALL) {
+    memmove(small, ss, n + 1);
+    node = (-1);
+  } else {
+    node = StringArena::current()->leaf(ss, n);
+  }
+  return *this;
+}
+
+string &string::operator+=(const string &ss) {
+  if (len == 0) {
+    *this = ss;
+  } else if (len + ss.len <= SMALL) {
+    // Both strings are small
+    memmove(small + len, ss.small, ss.len + 1);
+    len += ss.len;
+  } else if (ss.len > 0) {
+    int left = rope();
+    node = StringArena::current()->concat(left, ss.rope(), len + ss.len);
+    len += ss.len;
+  }
+  return *this;
+}
+
+string &string::operator+=(const char *ss) {
+  string s;
+  s = ss;
+  return operator+=(s);
+}
+
+int string::rope() const {
+  if (node >= 0)
+    return node;
+  return StringArena::current()->leaf(small, len);
+}
+
+void string::copyTo(char *dst) const {
+  if (node >= 0)
+    StringArena::current()->copy(node, dst);
+  else
+    memmove(dst, small, len);
+  dst[len] = 0;
+}
+
+void string::write(FILE *f) const {
+  if (node < 0) {
+    fwrite(small, 1, len, f);
+    return;
+  }
+  char *s = new char[len + 1];
+  copyTo(s);
+  fwrite(s, 1, len, f);
+  delete[] s;
+}
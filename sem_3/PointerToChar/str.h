@@ -1,32 +1,101 @@
-// =====================================
-// Char|Int pointer|array analyser
-// (C) rdmr, 2k6
-// Unautorized Duplication Appreciated!
-// =====================================
-
-#ifndef __STR_H_INCLUDED__
-#define __STR_H_INCLUDED__
-
-#include <string.h>
-
-class string {
-public:
-  char s[1000];
-  string() { s[0] = 0; }
-  string(char *ss) { strcpy(s, ss); }
-  string(string &ss) { strcpy(s, ss.s); }
-  string &operator=(const char *ss) {
-    strcpy(s, ss);
-    return *this;
-  }
-  string &operator=(const string &ss) {
-    strcpy(s, ss.s);
-    return *this;
-  }
-  string &operator+=(const string &ss) {
-    strcat(s, ss.s);
-    return *this;
-  }
-};
-
-#endif
+// =====================================
+// Char|Int pointer|array analyser
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+//
+// A string is a small value: a short string (up to SMALL characters)
+// is kept in the value itself, a longer one is a rope in StringArena.
+// Concatenation makes a new node of the rope, so it takes O(1) time,
+// and copying a string copies only the small value. The characters are
+// collected in linear time when the string is written.
+//
+// The string has no constructors, so it may be a value in the stack of
+// bison parser (the stack is copied by memcpy when it grows).
+// The ropes live until their arena is cleared (after a line is parsed);
+// every thread has its own current arena.
+//
+#ifndef __STR_H_INCLUDED__
+#define __STR_H_INCLUDED__
+
+#include <stdio.h>
+#include <string.h>
+
+class StringArena {
+  class Node {
+  public:
+    int left; // Concatenation of nodes left and right,
+    int right;
+    int len;  // or (left < 0) the characters chars[text..text+len-1]
+    int text;
+  };
+
+  Node *nodes;
+  int numNodes;
+  int nodesCapacity;
+  char *chars;
+  int numChars;
+  int charsCapacity;
+
+public:
+  StringArena()
+      : nodes(0), numNodes(0), nodesCapacity(0), chars(0), numChars(0),
+        charsCapacity(0) {}
+  ~StringArena() {
+    delete[] nodes;
+    delete[] chars;
+  }
+
+  // Forget all ropes
+  void clear() {
+    numNodes = 0;
+    numChars = 0;
+  }
+
+  // Add a node, return its index
+  int leaf(const char *s, int len);
+  int concat(int left, int right, int len);
+
+  // Copy the characters of rope to dst
+  void copy(int node, char *dst) const;
+
+  // The arena of the calling thread (a common one by default)
+  static StringArena *current();
+  static void setCurrent(StringArena *arena);
+
+private:
+  StringArena(const StringArena &);            // Copying is prohibited
+  StringArena &operator=(const StringArena &); //
+
+  int addNode();
+};
+
+class string {
+public:
+  enum { SMALL = 15 };
+
+  int len;
+  int node; // The rope in arena, -1 if the characters are in small
+  char small[SMALL + 1];
+
+  void clear() {
+    len = 0;
+    node = (-1);
+    small[0] = 0;
+  }
+  int length() const { return len; }
+
+  string &operator=(const char *ss);
+  string &operator+=(const string &ss);
+  string &operator+=(const char *ss);
+
+  // Copy the characters and the terminating zero to dst
+  void copyTo(char *dst) const;
+  void write(FILE *f) const;
+
+private:
+  int rope() const; // The node of rope with the characters
+};
+
+#endif
@@ -0,0 +1,445 @@
+// classes TextBuilder, RpnProgram, RpnExpression, implementation
+#include <stdio.h>
+#include <string.h>
+
+#include "Rpn.h"
+
+void TextBuilder::reserve(int n) {
+  if (n <= capacity)
+    return;
+  int newCapacity = (capacity > 0) ? 2 * capacity : 256;
+  while (newCapacity < n)
+    newCapacity *= 2;
+  char *newText = new char[newCapacity];
+  if (len > 0)
+    memmove(newText, text, len);
+  delete[] text;
+  text = newText;
+  capacity = newCapacity;
+}
+
+const char *TextBuilder::getString() {
+  reserve(len + 1);
+  text[len] = 0;
+  return text;
+}
+
+void TextBuilder::append(const char *s, int n) {
+  reserve(len + n);
+  memmove(text + len, s, n);
+  len += n;
+}
+
+void TextBuilder::append(const char *s) { append(s, strlen(s)); }
+
+void TextBuilder::append(char c) {
+  reserve(len + 1);
+  text[len++] = c;
+}
+
+void TextBuilder::appendNumber(double v) {
+  char buffer[32];
+  sprintf(buffer, "%.15g", v);
+  append(buffer);
+}
+
+void RpnProgram::add(const RpnInstruction &ins) {
+  if (len >= capacity) {
+    int newCapacity = (capacity > 0) ? 2 * capacity : 64;
+    RpnInstruction *newCode = new RpnInstruction[newCapacity];
+    if (len > 0)
+      memmove(newCode, code, len * sizeof(RpnInstruction));
+    delete[] code;
+    code = newCode;
+    capacity = newCapacity;
+  }
+  code[len++] = ins;
+}
+
+void RpnProgram::print(const RpnExpression &expr, TextBuilder &out) const {
+  static const char operations[] = "+-*/";
+  // opens[i]: the number of negations whose operand starts at the
+  // instruction i; the starts of operands on the stack are followed
+  int *opens = new int[len + 1];
+  int *starts = new int[len + 1];
+  int sp = 0;
+  for (int i = 0; i < len; ++i) {
+    opens[i] = 0;
+    switch (code[i].type) {
+    case RpnInstruction::PUSH_CONST:
+    case RpnInstruction::PUSH_VAR:
+    case RpnInstruction::LOAD:
+      starts[sp++] = i;
+      break;
+    case RpnInstruction::OP_NEG:
+      ++opens[starts[sp - 1]];
+      break;
+    case RpnInstruction::STORE:
+      break;
+    default: // Binary operation: the operand starts at the left one
+      --sp;
+      break;
+    }
+  }
+
+  for (int i = 0; i < len; ++i) {
+    const RpnInstruction &ins = code[i];
+    if (ins.type == RpnInstruction::OP_NEG) {
+      out.append(')');
+      continue;
+    }
+    if (i > 0)
+      out.append(' ');
+    for (int k = 0; k < opens[i]; ++k)
+      out.append("(-");
+    switch (ins.type) {
+    case RpnInstruction::PUSH_CONST:
+      if (ins.name >= 0)
+        out.append(expr.getName(ins.name));
+      else
+        out.appendNumber(ins.value);
+      break;
+    case RpnInstruction::PUSH_VAR:
+      out.append(expr.getName(ins.name));
+      break;
+    case RpnInstruction::STORE:
+      out.append("=$");
+      out.appendNumber(ins.arg);
+      break;
+    case RpnInstruction::LOAD:
+      out.append('$');
+      out.appendNumber(ins.arg);
+      break;
+    default:
+      out.append(operations[ins.type - RpnInstruction::OP_ADD]);
+      break;
+    }
+  }
+  delete[] starts;
+  delete[] opens;
+}
+
+bool RpnProgram::evaluate(double &value) const {
+  double *stack = new double[len + 1];
+  double *temporaries = new double[numTemporaries + 1];
+  int sp = 0;
+  bool res = true;
+  for (int i = 0; i < len && res; ++i) {
+    const RpnInstruction &ins = code[i];
+    switch (ins.type) {
+    case RpnInstruction::PUSH_CONST:
+      stack[sp++] = ins.value;
+      break;
+    case RpnInstruction::PUSH_VAR:
+      res = false;
+      break;
+    case RpnInstruction::OP_ADD:
+      --sp;
+      stack[sp - 1] += stack[sp];
+      break;
+    case RpnInstruction::OP_SUB:
+      --sp;
+      stack[sp - 1] -= stack[sp];
+      break;
+    case RpnInstruction::OP_MUL:
+      --sp;
+      stack[sp - 1] *= stack[sp];
+      break;
+    case RpnInstruction::OP_DIV:
+      --sp;
+      stack[sp - 1] /= stack[sp];
+      break;
+    case RpnInstruction::OP_NEG:
+      stack[sp - 1] = (-stack[sp - 1]);
+      break;
+    case RpnInstruction::STORE:
+      temporaries[ins.arg] = stack[sp - 1];
+      break;
+    case RpnInstruction::LOAD:
+      stack[sp++] = temporaries[ins.arg];
+      break;
+    }
+  }
+  if (res && sp == 1)
+    value = stack[0];
+  delete[] stack;
+  delete[] temporaries;
+  return (res && sp == 1);
+}
+
+RpnExpression::RpnExpression()
+    : nodes(0), numNodes(0), capacity(0), names(), table(0), tableSize(0),
+      graphStart(0) {}
+
+RpnExpression::~RpnExpression() {
+  delete[] nodes;
+  delete[] table;
+}
+
+void RpnExpression::clear() {
+  numNodes = 0;
+  names.clear();
+  for (int i = 0; i < tableSize; ++i)
+    table[i] = (-1);
+  graphStart = 0;
+}
+
+int RpnExpression::addNode(int type, int left, int right, double value,
+                           int name) {
+  if (numNodes >= capacity) {
+    int newCapacity = (capacity > 0) ? 2 * capacity : 64;
+    Node *newNodes = new Node[newCapacity];
+    if (numNodes > 0)
+      memmove(newNodes, nodes, numNodes * sizeof(Node));
+    delete[] nodes;
+    nodes = newNodes;
+    capacity = newCapacity;
+  }
+  Node &n = nodes[numNodes];
+  n.type = type;
+  n.left = left;
+  n.right = right;
+  n.value = value;
+  n.name = name;
+  return numNodes++;
+}
+
+int RpnExpression::addName(const char *s) {
+  int offset = names.length();
+  names.append(s, strlen(s) + 1);
+  return offset;
+}
+
+int RpnExpression::constant(double value, const char *text) {
+  return addNode(CONSTANT, -1, -1, value, addName(text));
+}
+
+int RpnExpression::variable(const char *name) {
+  return addNode(VARIABLE, -1, -1, 0., addName(name));
+}
+
+int RpnExpression::binary(int type, int left, int right) {
+  return addNode(type, left, right, 0., -1);
+}
+
+int RpnExpression::negate(int operand) {
+  return addNode(NEGATION, operand, -1, 0., -1);
+}
+
+void RpnExpression::compile(int root, RpnProgram &program) const {
+  program.clear();
+  emit(root, program, false);
+}
+
+void RpnExpression::optimize(int root, RpnProgram &program) {
+  program.clear();
+  graphStart = numNodes;
+  // The nodes of tree have less indices than their parents, so
+  // the graph node of every tree node is found in one pass
+  int *graph = new int[root + 1];
+  for (int i = 0; i <= root; ++i) {
+    Node n = nodes[i]; // The array may be reallocated by graphNode
+    int left = (n.left >= 0) ? graph[n.left] : (-1);
+    int right = (n.right >= 0) ? graph[n.right] : (-1);
+    graph[i] = graphNode(n.type, left, right, n.value, n.name);
+  }
+  emit(graph[root], program, true);
+  delete[] graph;
+}
+
+int RpnExpression::graphNode(int type, int left, int right, double value,
+                             int name) {
+  const Node *l = (left >= 0) ? nodes + left : 0;
+  const Node *r = (right >= 0) ? nodes + right : 0;
+  bool constants = (l != 0 && l->type == CONSTANT &&
+                    (r == 0 || r->type == CONSTANT));
+  switch (type) {
+  case NEGATION:
+    if (constants)
+      return graphNode(CONSTANT, -1, -1, (-l->value), -1);
+    if (l->type == NEGATION)
+      return l->left; // -(-x) = x
+    break;
+  case SUM:
+    if (constants)
+      return graphNode(CONSTANT, -1, -1, l->value + r->value, -1);
+    if (isConstant(left, 0.))
+      return right;
+    if (isConstant(right, 0.))
+      return left;
+    if (r->type == NEGATION) // x + (-y) = x - y
+      return graphNode(DIFFERENCE, left, r->left, 0., -1);
+    if (left > right) { // The order of commutative operands is fixed
+      int t = left;
+      left = right;
+      right = t;
+    }
+    break;
+  case DIFFERENCE:
+    if (constants)
+      return graphNode(CONSTANT, -1, -1, l->value - r->value, -1);
+    if (isConstant(right, 0.))
+      return left;
+    if (left == right)
+      return graphNode(CONSTANT, -1, -1, 0., -1);
+    if (isConstant(left, 0.))
+      return graphNode(NEGATION, right, -1, 0., -1);
+    if (r->type == NEGATION) // x - (-y) = x + y
+      return graphNode(SUM, left, r->left, 0., -1);
+    break;
+  case PRODUCT:
+    if (constants)
+      return graphNode(CONSTANT, -1, -1, l->value * r->value, -1);
+    if (isConstant(left, 1.))
+      return right;
+    if (isConstant(right, 1.))
+      return left;
+    if (isConstant(left, 0.) || isConstant(right, 0.))
+      return graphNode(CONSTANT, -1, -1, 0., -1);
+    if (left > right) {
+      int t = left;
+      left = right;
+      right = t;
+    }
+    break;
+  case QUOTIENT:
+    if (constants && r->value != 0.)
+      return graphNode(CONSTANT, -1, -1, l->value / r->value, -1);
+    if (isConstant(right, 1.))
+      return left;
+    break;
+  }
+  return findNode(type, left, right, value, name);
+}
+
+bool RpnExpression::sameName(int name1, int name2) const {
+  return (strcmp(names.getString(name1), names.getString(name2)) == 0);
+}
+
+// The constants are equal if their values are equal (0. and -0. are
+// different: 1 / -0. is -infinity), the variables are equal if their
+// names are equal
+unsigned RpnExpression::hashNode(int type, int left, int right, double value,
+                                 int name) const {
+  unsigned h = (unsigned)type * 31U + (unsigned)left * 1000003U +
+               (unsigned)right * 7919U;
+  if (type == CONSTANT) {
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    h += (unsigned)(bits ^ (bits >> 32)) * 2654435761U;
+  } else if (type == VARIABLE) {
+    unsigned hn = 2166136261U; // FNV-1a
+    for (const char *p = names.getString(name); *p != 0; ++p)
+      hn = (hn ^ (unsigned char)*p) * 16777619U;
+    h += hn;
+  }
+  return h;
+}
+
+int RpnExpression::findNode(int type, int left, int right, double value,
+                            int name) {
+  if (2 * (numNodes - graphStart + 1) > tableSize)
+    growTable();
+  int mask = tableSize - 1;
+  int k = (int)(hashNode(type, left, right, value, name) & (unsigned)mask);
+  while (table[k] >= 0) {
+    const Node &n = nodes[table[k]];
+    if (n.type == type && n.left == left && n.right == right &&
+        (type != CONSTANT || memcmp(&n.value, &value, sizeof(value)) == 0) &&
+        (type != VARIABLE || sameName(n.name, name)))
+      return table[k];
+    k = (k + 1) & mask;
+  }
+  int i = addNode(type, left, right, value, name);
+  table[k] = i;
+  return i;
+}
+
+void RpnExpression::growTable() {
+  int newSize = (tableSize > 0) ? 2 * tableSize : 256;
+  delete[] table;
+  table = new int[newSize];
+  tableSize = newSize;
+  for (int i = 0; i < tableSize; ++i)
+    table[i] = (-1);
+  // All graph nodes are different, so they are inserted without comparing
+  int mask = tableSize - 1;
+  for (int i = graphStart; i < numNodes; ++i) {
+    const Node &n = nodes[i];
+    int k = (int)(hashNode(n.type, n.left, n.right, n.value, n.name) &
+                  (unsigned)mask);
+    while (table[k] >= 0)
+      k = (k + 1) & mask;
+    table[k] = i;
+  }
+}
+
+void RpnExpression::emit(int root, RpnProgram &program,
+                         bool useTemporaries) const {
+  // The number of reachable parents of every node: the operands of
+  // a node have less indices, so the nodes are scanned backwards
+  int *uses = new int[root + 1];
+  int *temporary = new int[root + 1];
+  for (int i = 0; i <= root; ++i) {
+    uses[i] = 0;
+    temporary[i] = 0;
+  }
+  uses[root] = 1;
+  for (int i = root; i >= 0; --i) {
+    if (uses[i] == 0)
+      continue;
+    if (nodes[i].left >= 0)
+      ++uses[nodes[i].left];
+    if (nodes[i].right >= 0)
+      ++uses[nodes[i].right];
+  }
+
+  // Postorder traversal: an element of stack is 2 * node + 1, if
+  // the operands of node are already in the program
+  int *stack = new int[2 * (root + 1) + 1];
+  int sp = 0;
+  stack[sp++] = 2 * root;
+  RpnInstruction ins;
+  ins.arg = 0;
+  ins.value = 0.;
+  ins.name = (-1);
+  while (sp > 0) {
+    int e = stack[--sp];
+    int i = e / 2;
+    const Node &n = nodes[i];
+    if (temporary[i] != 0) {
+      ins.type = RpnInstruction::LOAD;
+      ins.arg = temporary[i];
+      program.add(ins);
+      ins.arg = 0;
+    } else if (n.type == CONSTANT || n.type == VARIABLE) {
+      ins.type = (n.type == CONSTANT) ? RpnInstruction::PUSH_CONST
+                                      : RpnInstruction::PUSH_VAR;
+      ins.value = n.value;
+      ins.name = n.name;
+      program.add(ins);
+      ins.value = 0.;
+      ins.name = (-1);
+    } else if (e % 2 == 0) {
+      stack[sp++] = e + 1;
+      if (n.right >= 0)
+        stack[sp++] = 2 * n.right;
+      stack[sp++] = 2 * n.left;
+    } else {
+      // The node types SUM..NEGATION have the same order as
+      // the operations
+      ins.type = RpnInstruction::OP_ADD + (n.type - SUM);
+      program.add(ins);
+      if (useTemporaries && uses[i] > 1) {
+        ins.type = RpnInstruction::STORE;
+        ins.arg = program.newTemporary();
+        temporary[i] = ins.arg;
+        program.add(ins);
+        ins.arg = 0;
+      }
+    }
+  }
+  delete[] stack;
+  delete[] temporary;
+  delete[] uses;
+}
@@ -87,8 +87,8 @@ enum yytokentype {
 /* the type of values in the semantic stack of parser      */
 #include "parser.h"
 
-#include "str.h"
 /* Any C++ code may be added here... */
+static void expressionParsed(int root);
 
 /* Enabling traces.  */
 #ifndef YYDEBUG
@@ -870,7 +870,7 @@ yyreduce:
   case 3:
 #line 40 "calc.ypp"
   { /* print the result */
-    printf("= %s\n", yyvsp[-1].s);
+    expressionParsed(yyvsp[-1]);
     ;
   } break;
 
@@ -884,46 +884,35 @@ yyreduce:
   case 5:
 #line 44 "calc.ypp"
   {
+    expression.clear();
     ;
   } break;
 
   case 6:
 #line 47 "calc.ypp"
   {
-    yyval = yyvsp[-2];
-    yyval += " ";
-    yyval += yyvsp[0];
-    yyval += " +";
+    yyval = expression.binary(RpnExpression::SUM, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 7:
 #line 48 "calc.ypp"
   {
-    yyval = yyvsp[-2];
-    yyval += " ";
-    yyval += yyvsp[0];
-    yyval += " -";
+    yyval = expression.binary(RpnExpression::DIFFERENCE, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 8:
 #line 49 "calc.ypp"
   {
-    yyval = yyvsp[-2];
-    yyval += " ";
-    yyval += yyvsp[0];
-    yyval += " *";
+    yyval = expression.binary(RpnExpression::PRODUCT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 9:
 #line 50 "calc.ypp"
   {
-    yyval = yyvsp[-2];
-    yyval += " ";
-    yyval += yyvsp[0];
-    yyval += " /";
+    yyval = expression.binary(RpnExpression::QUOTIENT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
@@ -937,9 +926,7 @@ yyreduce:
   case 11:
 #line 52 "calc.ypp"
   {
-    yyval = "(-";
-    yyval += yyvsp[0];
-    yyval += ")";
+    yyval = expression.negate(yyvsp[0]);
     ;
   } break;
 
@@ -1143,6 +1130,25 @@ yyreturn:
 #line 57 "calc.ypp"
 
 /*================ 3. The Program Section ================================*/
+RpnExpression expression;
+
+/* Print the program of expression and the optimized program */
+static void expressionParsed(int root) {
+  static RpnProgram program;
+  static TextBuilder text;
+  static TextBuilder optimizedText;
+  expression.compile(root, program);
+  text.clear();
+  program.print(expression, text);
+  expression.optimize(root, program);
+  optimizedText.clear();
+  program.print(expression, optimizedText);
+  printf("= %s\n", text.getString());
+  if (strcmp(text.getString(), optimizedText.getString()) != 0)
+    printf("Optimized: %s\n", optimizedText.getString());
+  expression.clear();
+}
+
 int main() {
   printf("Enter an expression to evaluate (empty line for quit):\n");
   yyparse();
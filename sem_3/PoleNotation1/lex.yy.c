@@ -335,8 +335,7 @@ char *yytext;
 /*============= 1. The definitions section ================*/
 #line 4 "scan.l"
 
-#include "str.h"
-
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -345,6 +344,13 @@ char *yytext;
                     /* generated by bison (PLUS, MINUS, etc.)             */
                     /* and the definition of YYSTYPE -- the type of the   */
                     /* values associated with terminals and nonterminals. */
+
+/* Node of a variable or a constant */
+static int lexemeNode(const char *text) {
+  if (isdigit((unsigned char)text[0]) || text[0] == '.')
+    return expression.constant(atof(text), text);
+  return expression.variable(text);
+}
 #line 390 "lex.yy.c"
 
 /* Macros after this point can all be overridden by user definitions in
@@ -629,7 +635,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 29 "scan.l"
       {
-        yylval = yytext;
+        yylval = lexemeNode(yytext);
         return VAR;
       }
       YY_BREAK
@@ -642,7 +648,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 39 "scan.l"
       {
-        yylval = yytext;
+        yylval = lexemeNode(yytext);
         return VAR;
       }
       YY_BREAK
@@ -10,11 +10,13 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-/* The type of values associated with terminals and nonterminals */
+#include "Rpn.h"
 
-#include "str.h"
+/* The type of values associated with terminals and nonterminals: */
+/* the index of the node of expression tree                       */
+#define YYSTYPE int
 
-#define YYSTYPE string
+extern RpnExpression expression; /* The tree of the expression being parsed */
 
 #include "calc.tab.hpp" /* File generated automatically by bison: */
                         /* contains the definitions of terminals  */
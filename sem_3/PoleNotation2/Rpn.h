@@ -0,0 +1,179 @@
+//
+// Expressions in reverse Polish notation.
+//
+// The parser builds the tree of an expression in an arena (RpnExpression):
+// a node is a small record in one growable array, the names of variables
+// are kept in one text buffer. The tree is converted to a program of
+// typed instructions (RpnProgram), which is printed to a text builder;
+// all the steps take linear time.
+//
+// The optimized program is built from the directed acyclic graph of the
+// expression: equal subexpressions are one node (the nodes are found in
+// a hash table), constants are folded and the algebraic identities
+// (x + 0, x * 1, x * 0, x - x, -(-x), ...) are simplified.
+// The value of a subexpression used several times is stored in
+// a temporary variable ("=$1") and is loaded later ("$1").
+//
+#ifndef RPN_H
+#define RPN_H
+
+// Text built by appending (amortized O(1) time per character)
+class TextBuilder {
+  char *text;
+  int len;
+  int capacity;
+
+public:
+  TextBuilder() : text(0), len(0), capacity(0) {}
+  ~TextBuilder() { delete[] text; }
+
+  void clear() { len = 0; }
+  int length() const { return len; }
+  const char *getString(); // Zero-terminated
+  const char *getString(int offset) const { return text + offset; }
+
+  void append(const char *s, int n);
+  void append(const char *s);
+  void append(char c);
+  void appendNumber(double v);
+
+private:
+  TextBuilder(const TextBuilder &);            // Copying is prohibited
+  TextBuilder &operator=(const TextBuilder &); //
+
+  void reserve(int n);
+};
+
+class RpnInstruction {
+public:
+  enum Type {
+    PUSH_CONST,
+    PUSH_VAR, // arg: the name of variable
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+    STORE, // Store the top of stack to the temporary arg (no pop)
+    LOAD   // Push the temporary arg
+  };
+
+  int type;
+  int arg;
+  double value; // PUSH_CONST
+  int name;     // PUSH_CONST, PUSH_VAR: offset of the text, -1 if none
+};
+
+class RpnExpression;
+
+class RpnProgram {
+  RpnInstruction *code;
+  int len;
+  int capacity;
+  int numTemporaries;
+
+public:
+  RpnProgram() : code(0), len(0), capacity(0), numTemporaries(0) {}
+  ~RpnProgram() { delete[] code; }
+
+  void clear() {
+    len = 0;
+    numTemporaries = 0;
+  }
+  int size() const { return len; }
+  const RpnInstruction &operator[](int i) const { return code[i]; }
+
+  void add(const RpnInstruction &ins);
+  int newTemporary() { return ++numTemporaries; }
+
+  // Append the program to the text (names of variables are in expr).
+  // A negation is printed as before: "(-" operand ")", e.g. (-a b +)
+  void print(const RpnExpression &expr, TextBuilder &out) const;
+
+  // The value of program (variables are 0).
+  // Returns false if the program has variables.
+  bool evaluate(double &value) const;
+
+private:
+  RpnProgram(const RpnProgram &);            // Copying is prohibited
+  RpnProgram &operator=(const RpnProgram &); //
+};
+
+class RpnExpression {
+public:
+  enum NodeType {
+    CONSTANT,
+    VARIABLE,
+    SUM,
+    DIFFERENCE,
+    PRODUCT,
+    QUOTIENT,
+    NEGATION
+  };
+
+private:
+  class Node {
+  public:
+    int type;
+    int left; // Operands (indices of nodes; an operand has a less index)
+    int right;
+    double value; // CONSTANT
+    int name;     // CONSTANT, VARIABLE: the text in names, -1 if none
+  };
+
+  Node *nodes;
+  int numNodes;
+  int capacity;
+  TextBuilder names; // Zero-terminated names of variables and constants
+
+  // The hash table of nodes of the optimized graph
+  // (they are the nodes from graphStart)
+  int *table; // Indices of nodes, -1 for empty entries
+  int tableSize;
+  int graphStart;
+
+public:
+  RpnExpression();
+  ~RpnExpression();
+
+  // Forget all nodes (after an expression is processed)
+  void clear();
+
+  // Add a node of tree, return its index
+  int constant(double value, const char *text);
+  int variable(const char *name);
+  int binary(int type, int left, int right);
+  int negate(int operand);
+
+  const char *getName(int offset) const { return names.getString(offset); }
+
+  // The program of the tree with the root
+  void compile(int root, RpnProgram &program) const;
+
+  // The optimized program of the tree with the root
+  void optimize(int root, RpnProgram &program);
+
+private:
+  RpnExpression(const RpnExpression &);            // Copying is prohibited
+  RpnExpression &operator=(const RpnExpression &); //
+
+  int addNode(int type, int left, int right, double value, int name);
+  int addName(const char *s);
+
+  // A node of the optimized graph (simplified and found in the table)
+  int graphNode(int type, int left, int right, double value, int name);
+  int findNode(int type, int left, int right, double value, int name);
+  unsigned hashNode(int type, int left, int right, double value,
+                    int name) const;
+  bool sameName(int name1, int name2) const;
+  void growTable();
+  bool isConstant(int i, double value) const {
+    return (nodes[i].type == CONSTANT && nodes[i].value == value);
+  }
+
+  // The program of nodes reachable from root; the nodes used more
+  // than once are stored in temporaries (if useTemporaries)
+  void emit(int root, RpnProgram &program, bool useTemporaries) const;
+};
+
+#endif /* RPN_H */
@@ -90,6 +90,7 @@ enum yytokentype {
 #include "parser.h"
 
 /* Any C++ code may be added here... */
+static void expressionParsed(int root);
 
 /* Enabling traces.  */
 #ifndef YYDEBUG
@@ -888,7 +889,7 @@ yyreduce:
   case 3:
 #line 33 "calc.y"
   { /* print the result */
-    printf("\nResult: %lf\n", yyvsp[-1]);
+    expressionParsed(yyvsp[-1]);
     ;
   } break;
 
@@ -902,45 +903,42 @@ yyreduce:
   case 5:
 #line 37 "calc.y"
   {
+    expression.clear();
     ;
   } break;
 
   case 6:
 #line 40 "calc.y"
   {
-    yyval = yyvsp[-2] + yyvsp[0];
-    printf(" +");
+    yyval = expression.binary(RpnExpression::SUM, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 7:
 #line 41 "calc.y"
   {
-    yyval = yyvsp[-2] - yyvsp[0];
-    printf(" -");
+    yyval = expression.binary(RpnExpression::DIFFERENCE, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 8:
 #line 42 "calc.y"
   {
-    yyval = yyvsp[-2] * yyvsp[0];
-    printf(" *");
+    yyval = expression.binary(RpnExpression::PRODUCT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 9:
 #line 43 "calc.y"
   {
-    yyval = yyvsp[-2] / yyvsp[0];
-    printf(" /");
+    yyval = expression.binary(RpnExpression::QUOTIENT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 10:
 #line 44 "calc.y"
   {
-    yyval = (-yyvsp[0]);
+    yyval = expression.negate(yyvsp[0]);
     ;
   } break;
 
@@ -962,7 +960,6 @@ yyreduce:
 #line 47 "calc.y"
   {
     yyval = yyvsp[0];
-    printf(" %.3lf", yyvsp[0]);
     ;
   } break;
 
@@ -970,7 +967,6 @@ yyreduce:
 #line 48 "calc.y"
   {
     yyval = yyvsp[0];
-    printf(" %.3lf", yyvsp[0]);
     ;
   } break;
   }
@@ -1160,6 +1156,29 @@ yyreturn:
 #line 51 "calc.y"
 
 /*================ 3. The Program Section ================================*/
+RpnExpression expression;
+
+/* Print the program of expression, the optimized program and the value */
+static void expressionParsed(int root) {
+  static RpnProgram program;
+  static TextBuilder text;
+  expression.compile(root, program);
+  text.clear();
+  program.print(expression, text);
+  printf("RPN: %s\n", text.getString());
+  // The identities x * 0 = 0 and x - x = 0 are false for infinite x:
+  // the result is the value of the program as written
+  double value;
+  bool known = program.evaluate(value);
+  expression.optimize(root, program);
+  text.clear();
+  program.print(expression, text);
+  printf("Optimized: %s\n", text.getString());
+  if (known)
+    printf("Result: %lf\n", value);
+  expression.clear();
+}
+
 int main() {
   printf("Enter an expression to evaluate (empty line for quit):\n");
   yyparse();
@@ -632,7 +632,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 29 "scan.l"
       {
-        yylval = (double)atoi(yytext);
+        yylval = expression.constant((double)atoi(yytext), yytext);
         return INT_CONST;
       }
       YY_BREAK
@@ -645,7 +645,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 40 "scan.l"
       {
-        yylval = atof(yytext);
+        yylval = expression.constant(atof(yytext), yytext);
         return DOUBLE_CONST;
       }
       YY_BREAK
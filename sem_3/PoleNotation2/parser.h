@@ -4,8 +4,13 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-/* The type of values associated with terminals and nonterminals */
-#define YYSTYPE double
+#include "Rpn.h"
+
+/* The type of values associated with terminals and nonterminals: */
+/* the index of the node of expression tree                       */
+#define YYSTYPE int
+
+extern RpnExpression expression; /* The tree of the expression being parsed */
 
 #include "calc.tab.h" /* File generated automatically by bison: */
                       /* contains the definitions of terminals  */
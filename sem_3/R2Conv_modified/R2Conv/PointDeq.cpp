@@ -1 +1,18 @@
+// class R2PointDeq, implementation
+#include <assert.h>
 #include "PointDeq.h"
+
+void R2PointDeq::grow() {
+  int newMaxElem = 2 * m_MaxElem;
+  assert(newMaxElem > 0); // No overflow
+  R2Point *elements = new R2Point[newMaxElem];
+
+  // Unroll the ring: the front element is placed at index 0
+  for (int i = 0; i < m_NumElem; ++i)
+    elements[i] = m_Elements[elemIndex(i)];
+  delete[] m_Elements;
+  m_Elements = elements;
+  m_MaxElem = newMaxElem;
+  m_Mask = newMaxElem - 1;
+  m_Begin = 0;
+}
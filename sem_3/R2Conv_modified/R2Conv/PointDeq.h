@@ -16,60 +16,64 @@ public:
   DeqException(const char *cause) : reason(cause) {}
 };
 
-const int DEQ_MAXELEM = 1024;
+// Initial capacity of a deq; the deq grows when it is full
+const int DEQ_MINELEM = 16;
 
+//
+// The elements are kept in a ring buffer of 2^k elements, so the index
+// of i-th element is (m_Begin + i) & m_Mask. When the buffer is full,
+// its size is doubled and the ring is unrolled into the new buffer
+// (the elements are placed from its beginning).
+//
 class R2PointDeq {
 private:
-  const int m_MaxElem;
+  int m_MaxElem; // Capacity, a power of 2
+  int m_Mask;    // m_MaxElem - 1
   int m_Begin;
-  int m_End;
   int m_NumElem;
   R2Point *m_Elements;
 
 public:
   R2PointDeq()
-      : m_MaxElem(DEQ_MAXELEM), m_Begin(0), m_End(DEQ_MAXELEM - 1),
+      : m_MaxElem(DEQ_MINELEM), m_Mask(DEQ_MINELEM - 1), m_Begin(0),
         m_NumElem(0), m_Elements(0) {
     m_Elements = new R2Point[m_MaxElem];
   }
 
+  // maxElem is the initial capacity
   R2PointDeq(int maxElem)
-      : m_MaxElem(maxElem), m_Begin(0), m_End(maxElem - 1), m_NumElem(0),
+      : m_MaxElem(DEQ_MINELEM), m_Mask(0), m_Begin(0), m_NumElem(0),
         m_Elements(0) {
+    while (m_MaxElem < maxElem)
+      m_MaxElem *= 2;
+    m_Mask = m_MaxElem - 1;
     m_Elements = new R2Point[m_MaxElem];
   }
 
   ~R2PointDeq() { delete[] m_Elements; }
 
 private:
-  int nextIndex(int i) const {
-    if (i < m_MaxElem - 1)
-      return i + 1;
-    else
-      return 0;
-  }
+  R2PointDeq(const R2PointDeq &);            // Copying is prohibited
+  R2PointDeq &operator=(const R2PointDeq &); //
 
-  int prevIndex(int i) const {
-    if (i > 0)
-      return i - 1;
-    else
-      return m_MaxElem - 1;
-  }
+  int elemIndex(int i) const { return (m_Begin + i) & m_Mask; }
+
+  // Double the capacity
+  void grow();
 
 public:
-  void pushFront(const R2Point &p) throw(DeqException) {
+  void pushFront(const R2Point &p) {
     if (m_NumElem >= m_MaxElem)
-      throw DeqException("Deq overflow");
-    m_Begin = prevIndex(m_Begin);
+      grow();
+    m_Begin = (m_Begin - 1) & m_Mask;
     m_Elements[m_Begin] = p;
     m_NumElem++;
   }
 
-  void pushBack(const R2Point &p) throw(DeqException) {
+  void pushBack(const R2Point &p) {
     if (m_NumElem >= m_MaxElem)
-      throw DeqException("Deq overflow");
-    m_End = nextIndex(m_End);
-    m_Elements[m_End] = p;
+      grow();
+    m_Elements[elemIndex(m_NumElem)] = p;
     m_NumElem++;
   }
 
@@ -77,7 +81,7 @@ public:
     if (m_NumElem <= 0)
       throw DeqException("Deq empty");
     int i = m_Begin;
-    m_Begin = nextIndex(m_Begin);
+    m_Begin = (m_Begin + 1) & m_Mask;
     m_NumElem--;
     return m_Elements[i];
   }
@@ -85,10 +89,8 @@ public:
   R2Point popBack() throw(DeqException) {
     if (m_NumElem <= 0)
       throw DeqException("Deq empty");
-    int i = m_End;
-    m_End = prevIndex(m_End);
     m_NumElem--;
-    return m_Elements[i];
+    return m_Elements[elemIndex(m_NumElem)];
   }
 
   R2Point &front() throw(DeqException) {
@@ -100,31 +102,31 @@ public:
   R2Point &back() throw(DeqException) {
     if (m_NumElem <= 0)
       throw DeqException("Deq empty");
-    return m_Elements[m_End];
+    return m_Elements[elemIndex(m_NumElem - 1)];
   }
 
+  // i-th element from the front, 0 <= i < size()
+  R2Point &operator[](int i) { return m_Elements[elemIndex(i)]; }
+  const R2Point &operator[](int i) const { return m_Elements[elemIndex(i)]; }
+
   void clear() {
     m_Begin = 0;
-    m_End = m_MaxElem - 1;
     m_NumElem = 0;
   }
 
   int size() const { return m_NumElem; }
-  int maxSize() const { return m_MaxElem; }
+  int maxSize() const { return m_MaxElem; } // Current capacity
 
   class iterator {
     R2PointDeq *deq;
-    int current;
-    int pos;
+    int pos; // The number of element from the front
 
   public:
-    iterator() : deq(0), current(0), pos(0) {}
-    iterator(R2PointDeq *d, int firstElem, int firstPos)
-        : deq(d), current(firstElem), pos(firstPos) {}
-    iterator(const iterator &i) : deq(i.deq), current(i.current), pos(i.pos) {}
+    iterator() : deq(0), pos(0) {}
+    iterator(R2PointDeq *d, int firstPos) : deq(d), pos(firstPos) {}
+    iterator(const iterator &i) : deq(i.deq), pos(i.pos) {}
     iterator &operator++() { // Prefix increment operator
       pos++;
-      current = deq->nextIndex(current);
       return *this;
     }
 
@@ -137,17 +139,17 @@ public:
     R2Point &operator*() throw(DeqException) {
       if (pos >= deq->size())
         throw DeqException("Index out of bounds");
-      return deq->m_Elements[current];
+      return (*deq)[pos];
     }
 
     R2Point *operator->() throw(DeqException) {
       if (pos >= deq->size())
         throw DeqException("Index out of bounds");
-      return &(deq->m_Elements[current]);
+      return &((*deq)[pos]);
     }
 
     bool operator==(const iterator &i) const {
-      return (deq == i.deq && current == i.current);
+      return (deq == i.deq && pos == i.pos);
     }
     bool operator!=(const iterator &i) const { return !operator==(i); }
   };
@@ -156,8 +158,8 @@ public:
   public:
     const_iterator() : iterator() {}
 
-    const_iterator(const R2PointDeq *d, int firstElem, int firstPos)
-        : iterator((R2PointDeq *)d, firstElem, firstPos) {}
+    const_iterator(const R2PointDeq *d, int firstPos)
+        : iterator((R2PointDeq *)d, firstPos) {}
     const_iterator(const iterator &i) : iterator(i) {}
     const R2Point &operator*() const throw(DeqException) {
       return ((iterator *)this)->operator*();
@@ -167,14 +169,11 @@ public:
     }
   };
 
-  iterator begin() { return iterator(this, m_Begin, 0); }
-  const_iterator begin() const { return const_iterator(this, m_Begin, 0); }
+  iterator begin() { return iterator(this, 0); }
+  const_iterator begin() const { return const_iterator(this, 0); }
 
-  iterator end() { return iterator(this, nextIndex(m_End), size()); }
-
-  const_iterator end() const {
-    return const_iterator(this, nextIndex(m_End), size());
-  }
+  iterator end() { return iterator(this, size()); }
+  const_iterator end() const { return const_iterator(this, size()); }
 };
 
 #endif
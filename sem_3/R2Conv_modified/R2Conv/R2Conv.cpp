@@ -4,22 +4,51 @@
 //
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <algorithm>
 #include "R2Conv.h"
 
-bool R2Polygon::IsInside(const R2Point &t) {
-  int Num = size();
-  if (Num < 3)
+// The minimal number of points processed by a thread
+// in buildFrom and classify
+static const int MIN_THREAD_POINTS = 1 << 16;
+
+// Number of threads for n points (numThreads = 0: number of processors)
+static int threadCount(int n, int numThreads) {
+  if (numThreads <= 0)
+    numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (numThreads > n / MIN_THREAD_POINTS)
+    numThreads = n / MIN_THREAD_POINTS;
+  if (numThreads < 1)
+    numThreads = 1;
+  return numThreads;
+}
+
+bool R2Polygon::IsInside(const R2Point &t) const {
+  int n = size();
+  if (n < 3)
     return false;
-  for (int i = 0; i < Num; i++) {
-    if (lit(m_Deq.back(), m_Deq.front(), t))
-      return false;
-    Rotate();
+  // The vertices go clockwise, so the rays from the first vertex
+  // to the next ones turn clockwise. The point must be inside
+  // the angle between the first and the last edges.
+  const R2Point &v0 = m_Deq[0];
+  if (lit(v0, m_Deq[1], t) || lit(m_Deq[n - 1], v0, t))
+    return false;
+  // Find the triangle (v0, v[lo], v[lo + 1]) of fan that contains the point
+  int lo = 1;
+  int hi = n - 1;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (R2Point::signed_area(v0, m_Deq[mid], t) < 0.)
+      lo = mid;
+    else
+      hi = mid;
   }
-  return true;
+  return !lit(m_Deq[lo], m_Deq[hi], t);
 }
 
 R2Polygon::R2Polygon(const R2Point &a, const R2Point &b, const R2Point &c)
-    : m_Deq(), m_Area(0.), m_Perimeter(0.) {
+    : m_Deq(), m_Area(0.), m_Perimeter(0.), m_Moment(0., 0.) {
   assert(!R2Point::on_line(a, b, c));
   m_Deq.pushFront(b);
   if (lit(a, c, b)) {
@@ -32,7 +61,22 @@ R2Polygon::R2Polygon(const R2Point &a, const R2Point &b, const R2Point &c)
 
   assert(!lit(m_Deq.back(), m_Deq.front(), b));
   m_Perimeter = a.distance(b) + b.distance(c) + c.distance(a);
-  m_Area = R2Point::area(a, b, c);
+  addTriangle(a, b, c);
+  m_MassCenter = GetMassCenter();
+}
+
+R2Polygon::R2Polygon(const R2Point *vertices, int n)
+    : m_Deq(n), m_Area(0.), m_Perimeter(0.), m_Moment(0., 0.) {
+  assert(n >= 3);
+  for (int i = 0; i < n; ++i) {
+    const R2Point &a = vertices[i];
+    const R2Point &b = vertices[(i + 1 < n) ? i + 1 : 0];
+    m_Deq.pushBack(a);
+    m_Perimeter += a.distance(b);
+    if (i >= 2) // The triangles of fan from the first vertex
+      addTriangle(vertices[0], vertices[i - 1], a);
+  }
+  m_MassCenter = GetMassCenter();
 }
 
 void R2Polygon::addPoint(const R2Point &t) {
@@ -47,7 +91,7 @@ void R2Polygon::addPoint(const R2Point &t) {
   }
   if (!lit(m_Deq.back(), m_Deq.front(), t))
     return;
-  // Delete the current edge (i.e. modify m_Area and m_Perimeter)
+  // Delete the current edge (i.e. modify m_Area, m_Perimeter and m_Moment)
   remove(m_Deq.back(), m_Deq.front(), t);
   // Delete lit edges from the beginning of deq
   x = m_Deq.popFront();
@@ -72,7 +116,14 @@ void R2Polygon::addPoint(const R2Point &t) {
 void R2Polygon::remove(const R2Point &a, const R2Point &b, const R2Point &t) {
   assert(lit(a, b, t)); // Edge [a, b> is lit from the point t.
   m_Perimeter -= a.distance(b);
-  m_Area += fabs(R2Point::area(a, b, t));
+  addTriangle(a, b, t);
+}
+
+void R2Polygon::addTriangle(const R2Point &a, const R2Point &b,
+                            const R2Point &c) {
+  double s = R2Point::area(a, b, c);
+  m_Area += s;
+  m_Moment += R2Vector(a.x + b.x + c.x, a.y + b.y + c.y) * (s / 3.);
 }
 
 // Loop for every vertex of polygon
@@ -94,13 +145,6 @@ bool R2Polygon::forEach(bool (*action)(R2Point &)) {
   return false;
 }
 
-R2Vector R2Polygon::GetMassCenter() const {
-  R2Vector mc(0, 0);
-  for (R2Polygon::iterator i = begin(); i != end(); i++)
-    mc += R2Vector(i->x, i->y);
-  mc *= (1 / double(size()));
-  return mc;
-}
 // end of polygon
 //========================================================
 
@@ -162,7 +206,205 @@ bool R2Convex::forEach(bool (*action)(R2Point &)) {
     return m_Polygon->forEach(action);
 }
 
-bool R2Convex::IsInside(const R2Point &t) { return m_Polygon->IsInside(t); }
+bool R2Convex::IsInside(const R2Point &t) const {
+  if (m_NumAng < 3)
+    return false;
+  return m_Polygon->IsInside(t);
+}
+
+// A part of points tested by a thread of classify
+class ClassifyJob {
+public:
+  const R2Polygon *polygon;
+  const R2Point *points;
+  int n;
+  bool *inside;
+  int numInside;
+
+  ClassifyJob() : polygon(0), points(0), n(0), inside(0), numInside(0) {}
+
+  void run() {
+    numInside = 0;
+    for (int i = 0; i < n; ++i) {
+      inside[i] = polygon->IsInside(points[i]);
+      if (inside[i])
+        ++numInside;
+    }
+  }
+
+  static void *start(void *job) {
+    ((ClassifyJob *)job)->run();
+    return 0;
+  }
+};
+
+int R2Convex::classify(const R2Point *points, int n, bool *inside,
+                       int numThreads /* = 0 */) const {
+  if (n <= 0)
+    return 0;
+  if (m_NumAng < 3) {
+    for (int i = 0; i < n; ++i)
+      inside[i] = false;
+    return 0;
+  }
+  numThreads = threadCount(n, numThreads);
+  ClassifyJob *jobs = new ClassifyJob[numThreads];
+  pthread_t *threads = new pthread_t[numThreads];
+  bool *started = new bool[numThreads];
+  for (int i = 0; i < numThreads; ++i) {
+    int beg = (int)((long long)n * i / numThreads);
+    int end = (int)((long long)n * (i + 1) / numThreads);
+    jobs[i].polygon = m_Polygon;
+    jobs[i].points = points + beg;
+    jobs[i].n = end - beg;
+    jobs[i].inside = inside + beg;
+    started[i] = (i > 0 && pthread_create(&threads[i], 0, &ClassifyJob::start,
+                                          &jobs[i]) == 0);
+  }
+  jobs[0].run();
+  int numInside = jobs[0].numInside;
+  for (int i = 1; i < numThreads; ++i) {
+    if (started[i])
+      pthread_join(threads[i], 0);
+    else
+      jobs[i].run();
+    numInside += jobs[i].numInside;
+  }
+  delete[] started;
+  delete[] threads;
+  delete[] jobs;
+  return numInside;
+}
+
+static bool lessXY(const R2Point &p, const R2Point &q) {
+  return (p.x < q.x || (p.x == q.x && p.y < q.y));
+}
+
+// Convex hull of n points sorted by x, then by y (Andrew's monotone
+// chain). The vertices are written to hull (of size n + 1) in
+// counterclockwise order; collinear and coincident points are skipped
+// as R2Polygon::lit does. Returns the number of vertices.
+static int monotoneChain(const R2Point *points, int n, R2Point *hull) {
+  if (n <= 1) {
+    if (n == 1)
+      hull[0] = points[0];
+    return n;
+  }
+  int k = 0;
+  // Lower hull
+  for (int i = 0; i < n; ++i) {
+    while (k >= 2 && R2Point::signed_area(hull[k - 2], hull[k - 1],
+                                          points[i]) <= R2GRAPH_EPSILON)
+      --k;
+    hull[k++] = points[i];
+  }
+  // Upper hull
+  int lower = k + 1;
+  for (int i = n - 2; i >= 0; --i) {
+    while (k >= lower && R2Point::signed_area(hull[k - 2], hull[k - 1],
+                                              points[i]) <= R2GRAPH_EPSILON)
+      --k;
+    hull[k++] = points[i];
+  }
+  --k; // The first point is repeated at the end
+  if (k == 2 && hull[0] == hull[1])
+    k = 1; // All points coincide
+  return k;
+}
+
+// A part of points processed by a thread of buildFrom
+class HullJob {
+public:
+  const R2Point *points;
+  int n;
+  R2Point *hull; // Vertices of the hull of the part
+  int hullSize;
+
+  HullJob() : points(0), n(0), hull(0), hullSize(0) {}
+  ~HullJob() { delete[] hull; }
+
+  void run() {
+    R2Point *sorted = new R2Point[n];
+    for (int i = 0; i < n; ++i)
+      sorted[i] = points[i];
+    std::sort(sorted, sorted + n, lessXY);
+    hull = new R2Point[n + 1];
+    hullSize = monotoneChain(sorted, n, hull);
+    delete[] sorted;
+  }
+
+  static void *start(void *job) {
+    ((HullJob *)job)->run();
+    return 0;
+  }
+};
+
+void R2Convex::buildFrom(const R2Point *points, int n,
+                         int numThreads /* = 0 */) {
+  initialize();
+  if (n <= 0)
+    return;
+  numThreads = threadCount(n, numThreads);
+
+  // Hulls of the parts
+  HullJob *jobs = new HullJob[numThreads];
+  pthread_t *threads = new pthread_t[numThreads];
+  bool *started = new bool[numThreads];
+  for (int i = 0; i < numThreads; ++i) {
+    int beg = (int)((long long)n * i / numThreads);
+    int end = (int)((long long)n * (i + 1) / numThreads);
+    jobs[i].points = points + beg;
+    jobs[i].n = end - beg;
+    started[i] = (i > 0 && pthread_create(&threads[i], 0, &HullJob::start,
+                                          &jobs[i]) == 0);
+  }
+  jobs[0].run(); // The first part is processed by this thread
+  for (int i = 1; i < numThreads; ++i) {
+    if (started[i])
+      pthread_join(threads[i], 0);
+    else
+      jobs[i].run();
+  }
+
+  // The hull of vertices of all hulls
+  HullJob merge;
+  R2Point *vertices = jobs[0].hull;
+  int numVertices = jobs[0].hullSize;
+  if (numThreads > 1) {
+    int total = 0;
+    for (int i = 0; i < numThreads; ++i)
+      total += jobs[i].hullSize;
+    R2Point *all = new R2Point[total];
+    int k = 0;
+    for (int i = 0; i < numThreads; ++i) {
+      for (int j = 0; j < jobs[i].hullSize; ++j)
+        all[k++] = jobs[i].hull[j];
+    }
+    merge.points = all;
+    merge.n = total;
+    merge.run();
+    delete[] all;
+    vertices = merge.hull;
+    numVertices = merge.hullSize;
+  }
+
+  if (numVertices == 1) {
+    addPoint(vertices[0]);
+  } else if (numVertices == 2) {
+    addPoint(vertices[0]);
+    addPoint(vertices[1]);
+  } else {
+    // R2Polygon keeps the vertices in clockwise order
+    std::reverse(vertices, vertices + numVertices);
+    m_Polygon = new R2Polygon(vertices, numVertices);
+    m_NumAng = 3;
+    m_MassCenter = m_Polygon->masscenter();
+  }
+
+  delete[] started;
+  delete[] threads;
+  delete[] jobs;
+}
 
 // End of implementation of the class R2Convex
 //======================================================
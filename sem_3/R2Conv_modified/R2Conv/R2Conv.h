@@ -23,14 +23,19 @@ class R2Polygon {
   R2PointDeq m_Deq;
   double m_Area;
   double m_Perimeter;
+  R2Vector m_Moment; // Sum of (area * center) of triangles of polygon
   R2Vector m_MassCenter;
 
 public:
   // Polygon begins with triangle
   R2Polygon(const R2Point &a, const R2Point &b, const R2Point &c);
+
+  // Polygon with n >= 3 vertices of a convex polygon in clockwise order
+  R2Polygon(const R2Point *vertices, int n);
   ~R2Polygon() {}
   double area() const { return m_Area; }
   double perimeter() const { return m_Perimeter; }
+  // Center of mass of the polygon area
   R2Vector masscenter() const { return m_MassCenter; }
   void addPoint(const R2Point &t);
   void Rotate() { m_Deq.pushBack(m_Deq.popFront()); }
@@ -62,10 +67,18 @@ public:
   //      if this function returns true, than the loop will be
   //      broken.
   bool forEach(bool (*action)(R2Point &));
-  bool IsInside(const R2Point &t);
+
+  // The point is inside or on the border of polygon.
+  // O(log n): binary search of the angle at the first vertex
+  // that contains the point; the deq is not changed, so several
+  // threads can test points at once.
+  bool IsInside(const R2Point &t) const;
 
 private:
-  R2Vector GetMassCenter() const;
+  // The moments are updated by triangles added to polygon, so
+  // addPoint takes O(1) time for each removed vertex
+  void addTriangle(const R2Point &a, const R2Point &b, const R2Point &c);
+  R2Vector GetMassCenter() const { return m_Moment * (1. / m_Area); }
   bool lit(const R2Point &a, const R2Point &b, const R2Point &t) const {
     double area = R2Point::signed_area(a, b, t);
     return (area > R2GRAPH_EPSILON ||
@@ -103,6 +116,13 @@ public:
   R2Vector masscenter() const { return m_MassCenter; }
   // ADD POINT TO CONVEX HULL
   void addPoint(const R2Point &t);
+
+  // Build the convex hull of n points (the previous points are forgotten).
+  // The points are divided between numThreads threads (0 means the
+  // number of processors), each thread sorts its part and builds its hull
+  // by the monotone chain algorithm; then the hull of their vertices
+  // is built in the same way.
+  void buildFrom(const R2Point *points, int n, int numThreads = 0);
   int size() const {
     if (m_NumAng < 3)
       return m_NumAng;
@@ -210,7 +230,13 @@ public:
   //      if this function returns true, than the loop will be
   //      broken.
   bool forEach(bool (*action)(R2Point &));
-  bool IsInside(const R2Point &t);
+  bool IsInside(const R2Point &t) const;
+
+  // Test n points: inside[i] = IsInside(points[i]). The points are
+  // divided between numThreads threads (0 means the number of
+  // processors). Returns the number of points inside.
+  int classify(const R2Point *points, int n, bool *inside,
+               int numThreads = 0) const;
 };
 
 #endif
@@ -1,10 +1,54 @@
 #include <iostream.h>
+#include <stdlib.h>
+#include <sys/time.h>
 #include "R2Conv.h"
 
-int main() {
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+// Compare the point-by-point construction with buildFrom
+// for n random points in a disk
+static void compareConstruction(int n) {
+  R2Point *points = new R2Point[n];
+  for (int i = 0; i < n; i++) {
+    do {
+      points[i].x = 2. * rand() / RAND_MAX - 1.;
+      points[i].y = 2. * rand() / RAND_MAX - 1.;
+    } while (points[i].x * points[i].x + points[i].y * points[i].y > 1.);
+    points[i] = points[i] * 1e6;
+  }
+
+  double t0 = currentTime();
+  R2Convex conv;
+  for (int i = 0; i < n; i++)
+    conv.addPoint(points[i]);
+  double t1 = currentTime();
+  R2Convex built;
+  built.buildFrom(points, n);
+  double t2 = currentTime();
+
+  cout << "addPoint:  " << t1 - t0 << " sec, " << conv.size()
+       << " vertices, Perimeter = " << conv.perimeter()
+       << ", Area = " << conv.area() << endl
+       << "buildFrom: " << t2 - t1 << " sec, " << built.size()
+       << " vertices, Perimeter = " << built.perimeter()
+       << ", Area = " << built.area() << endl;
+  delete[] points;
+}
+
+int main(int argc, char *argv[]) {
   R2Point p;
   int i, n;
 
+  if (argc > 1) {
+    // convtst <number of random points>
+    compareConstruction(atoi(argv[1]));
+    return 0;
+  }
+
   cout << "Input number of points>";
   cin >> n;
 
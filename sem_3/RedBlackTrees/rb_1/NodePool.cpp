@@ -0,0 +1,105 @@
+// Pool of objects of a fixed size
+// class NodePool, implementation
+#include <assert.h>
+#include <stdlib.h>
+#include <new>
+#include "NodePool.h"
+
+NodePool::NodePool(size_t size, int perBlock /* = 1024 */)
+    : objectSize(size), objectsPerBlock(perBlock), usedBlocks(0), usedTail(0),
+      current(0), numUsed(0), spareBlocks(0), freeList(0) {
+  assert(perBlock > 0);
+  // An object must be able to hold a pointer of free list
+  if (objectSize < sizeof(FreeObject))
+    objectSize = sizeof(FreeObject);
+  // Round up the size to keep the objects aligned
+  const size_t ALIGN = sizeof(double);
+  objectSize = (objectSize + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+void *NodePool::allocate() {
+  if (freeList != 0) {
+    FreeObject *f = freeList;
+    freeList = f->next;
+    return f;
+  }
+  if (current == 0 || numUsed >= objectsPerBlock) {
+    if (current != 0)
+      pushUsed(current);
+    if (spareBlocks != 0) {
+      current = spareBlocks;
+      spareBlocks = spareBlocks->next;
+    } else {
+      current = (Block *)malloc(sizeof(Block) + objectsPerBlock * objectSize);
+      if (current == 0)
+        throw std::bad_alloc();
+    }
+    current->next = 0;
+    numUsed = 0;
+  }
+  return objectAddress(current, numUsed++);
+}
+
+void NodePool::release(void *p) {
+  if (p == 0)
+    return;
+  FreeObject *f = (FreeObject *)p;
+  f->next = freeList;
+  freeList = f;
+}
+
+void NodePool::pushUsed(Block *b) {
+  b->next = 0;
+  if (usedTail == 0)
+    usedBlocks = b;
+  else
+    usedTail->next = b;
+  usedTail = b;
+}
+
+void NodePool::clear() {
+  if (current != 0) {
+    pushUsed(current);
+    current = 0;
+  }
+  if (usedTail != 0) {
+    // Put the used blocks in front of spare ones
+    usedTail->next = spareBlocks;
+    spareBlocks = usedBlocks;
+    usedBlocks = 0;
+    usedTail = 0;
+  }
+  numUsed = 0;
+  freeList = 0;
+}
+
+void NodePool::freeMemory() {
+  clear();
+  while (spareBlocks != 0) {
+    Block *b = spareBlocks;
+    spareBlocks = b->next;
+    free(b);
+  }
+}
+
+void NodePool::adopt(NodePool &p) {
+  assert(p.objectSize == objectSize && p.objectsPerBlock == objectsPerBlock);
+  if (&p == this)
+    return;
+  if (p.current != 0) {
+    p.pushUsed(p.current);
+    p.current = 0;
+    p.numUsed = 0;
+  }
+  if (p.usedTail != 0) {
+    // The blocks of p are used (the free objects in them are lost
+    // until the next clear())
+    p.usedTail->next = usedBlocks;
+    if (usedTail == 0)
+      usedTail = p.usedTail;
+    usedBlocks = p.usedBlocks;
+    p.usedBlocks = 0;
+    p.usedTail = 0;
+  }
+  p.freeList = 0;
+}
@@ -1,3 +1,7 @@
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <new>
 #include "TreeSet.h"
 
 bool TreeSet::contains(const TreeSetKey *k) const {
@@ -19,11 +23,35 @@ void TreeSet::add(const TreeSetKey *k, const TreeSetValue *v /* = 0 */) {
     }
   } else {
     // Add the pair to the set
-    Pair *p = new Pair(k->clone(), v->clone());
-    insert(node, p);
+    RBTreeNode *x = newNode();
+    TreeSetValue *val = (v != 0) ? v->clone() : 0;
+    x->value = new (inlineValue(x)) Pair(k->clone(), val);
+    insertNode(node, x);
   }
 }
 
+void TreeSet::eraseNode(RBTreeNode *node) {
+  Pair *p = (Pair *)node->value;
+  if (p == 0)
+    return;
+  delete p->key;
+  delete p->value;
+  RBTree::eraseNode(node); // Destroy the pair itself
+}
+
+void TreeSet::remove(const TreeSetKey *k) {
+  Pair key(k, 0);
+  RBTreeNode *node;
+  if (find(&key, root(), &node))
+    removeNode(node);
+}
+
+int TreeSet::removeRange(const TreeSetKey *lo, const TreeSetKey *hi) {
+  Pair l(lo, 0);
+  Pair h(hi, 0);
+  return eraseRange(&l, &h);
+}
+
 TreeSetValue *TreeSet::value(const TreeSetKey *k) const {
   Pair key(k, 0);
   RBTreeNode *node;
@@ -36,3 +64,240 @@ TreeSetValue *TreeSet::value(const TreeSetKey *k) const {
     return 0;
   }
 }
+
+//
+// Bulk loading
+//
+static int numProcessors() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+}
+
+// Run the jobs in parallel threads, jobs[0] runs in the calling thread
+template <class Job> static void runJobs(Job *jobs, int numJobs) {
+  pthread_t *ids = new pthread_t[numJobs];
+  bool *started = new bool[numJobs];
+  for (int i = 1; i < numJobs; ++i)
+    started[i] = (pthread_create(&ids[i], 0, Job::run, &jobs[i]) == 0);
+  Job::run(&jobs[0]);
+  for (int i = 1; i < numJobs; ++i) {
+    if (started[i])
+      pthread_join(ids[i], 0);
+    else
+      Job::run(&jobs[i]); // Cannot create a thread: do it here
+  }
+  delete[] started;
+  delete[] ids;
+}
+
+// Merge the sorted runs a[0..na-1] and b[0..nb-1] of key indices into out.
+// For equal keys the index from a goes first, so merging is stable.
+static void mergeRuns(const TreeSetKey *const *keys, const int *a, int na,
+                      const int *b, int nb, int *out) {
+  int i = 0, j = 0;
+  while (i < na && j < nb) {
+    if (keys[b[j]]->compareTo(*keys[a[i]]) < 0)
+      *out++ = b[j++];
+    else
+      *out++ = a[i++];
+  }
+  while (i < na)
+    *out++ = a[i++];
+  while (j < nb)
+    *out++ = b[j++];
+}
+
+// Stable merge sort of order[0..n-1] by keys, tmp is a buffer of size n
+static void mergeSort(const TreeSetKey *const *keys, int *order, int *tmp,
+                      int n) {
+  const int SMALL = 16;
+  if (n <= SMALL) { // Insertion sort
+    for (int i = 1; i < n; ++i) {
+      int x = order[i];
+      int j = i;
+      for (; j > 0 && keys[x]->compareTo(*keys[order[j - 1]]) < 0; --j)
+        order[j] = order[j - 1];
+      order[j] = x;
+    }
+    return;
+  }
+  int half = n / 2;
+  mergeSort(keys, order, tmp, half);
+  mergeSort(keys, order + half, tmp + half, n - half);
+  mergeRuns(keys, order, half, order + half, n - half, tmp);
+  memcpy(order, tmp, n * sizeof(int));
+}
+
+class SortJob {
+public:
+  const TreeSetKey *const *keys;
+  int *order;
+  int *tmp;
+  int n;
+
+  static void *run(void *arg) {
+    SortJob *j = (SortJob *)arg;
+    mergeSort(j->keys, j->order, j->tmp, j->n);
+    return 0;
+  }
+};
+
+class MergeJob {
+public:
+  const TreeSetKey *const *keys;
+  const int *a; // The run b follows the run a
+  int na;
+  int nb;
+  int *out;
+
+  static void *run(void *arg) {
+    MergeJob *j = (MergeJob *)arg;
+    mergeRuns(j->keys, j->a, j->na, j->a + j->na, j->nb, j->out);
+    return 0;
+  }
+};
+
+// Sort order[0..n-1] by keys using numThreads threads:
+// the parts are sorted in parallel, then merged by pairs in parallel
+static void parallelSort(const TreeSetKey *const *keys, int *order, int n,
+                         int numThreads) {
+  int *tmp = new int[n];
+  SortJob *sortJobs = new SortJob[numThreads];
+  int *bounds = new int[numThreads + 1]; // Runs are bounds[i]..bounds[i+1]
+  for (int t = 0; t <= numThreads; ++t)
+    bounds[t] = (int)((long long)n * t / numThreads);
+  for (int t = 0; t < numThreads; ++t) {
+    sortJobs[t].keys = keys;
+    sortJobs[t].order = order + bounds[t];
+    sortJobs[t].tmp = tmp + bounds[t];
+    sortJobs[t].n = bounds[t + 1] - bounds[t];
+  }
+  runJobs(sortJobs, numThreads);
+
+  MergeJob *mergeJobs = new MergeJob[(numThreads + 1) / 2];
+  int numRuns = numThreads;
+  int *src = order;
+  int *dst = tmp;
+  while (numRuns > 1) {
+    int numJobs = 0;
+    for (int r = 0; r < numRuns; r += 2) {
+      MergeJob &j = mergeJobs[numJobs++];
+      int mid = bounds[r + 1];
+      int end = (r + 2 <= numRuns) ? bounds[r + 2] : mid; // Odd run is copied
+      j.keys = keys;
+      j.a = src + bounds[r];
+      j.na = mid - bounds[r];
+      j.nb = end - mid;
+      j.out = dst + bounds[r];
+      bounds[r / 2] = bounds[r];
+    }
+    bounds[numJobs] = n;
+    runJobs(mergeJobs, numJobs);
+    numRuns = numJobs;
+    int *t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != order)
+    memcpy(order, src, n * sizeof(int));
+
+  delete[] mergeJobs;
+  delete[] bounds;
+  delete[] sortJobs;
+  delete[] tmp;
+}
+
+// Create the pairs of nodes[0..n-1] (the keys and values are cloned)
+class PairJob {
+public:
+  RBTreeNode **nodes;
+  const TreeSetKey *const *keys;
+  const TreeSetValue *const *values;
+  const int *order;
+  int n;
+
+  static void *run(void *arg) {
+    PairJob *j = (PairJob *)arg;
+    for (int i = 0; i < j->n; ++i) {
+      int k = j->order[i];
+      const TreeSetValue *v = (j->values != 0) ? j->values[k] : 0;
+      j->nodes[i]->value = new (RBTree::inlineValue(j->nodes[i]))
+          TreeSet::Pair(j->keys[k]->clone(), (v != 0) ? v->clone() : 0);
+    }
+    return 0;
+  }
+};
+
+void TreeSet::assign(const TreeSetKey *const *keys,
+                     const TreeSetValue *const *values, int n,
+                     int numThreads /* = 0 */) {
+  clear();
+  if (n <= 0)
+    return;
+  const int MIN_PER_THREAD = 4096; // Smaller parts are not worth a thread
+  if (numThreads <= 0)
+    numThreads = numProcessors();
+  if (numThreads > n / MIN_PER_THREAD)
+    numThreads = n / MIN_PER_THREAD;
+  if (numThreads < 1)
+    numThreads = 1;
+
+  int *order = new int[n];
+  bool sorted = true;
+  for (int i = 0; i < n; ++i) {
+    order[i] = i;
+    if (i > 0 && sorted && keys[i - 1]->compareTo(*keys[i]) >= 0)
+      sorted = false;
+  }
+  if (!sorted) {
+    parallelSort(keys, order, n, numThreads);
+    // Remove the duplicates, the last of equal keys is kept
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+      if (i + 1 < n && keys[order[i]]->compareTo(*keys[order[i + 1]]) == 0)
+        continue;
+      order[m++] = order[i];
+    }
+    n = m;
+  }
+
+  // The nodes are allocated here (the pool is not thread-safe),
+  // the keys and values are cloned in parallel
+  RBTreeNode **nodes = new RBTreeNode *[n];
+  for (int i = 0; i < n; ++i)
+    nodes[i] = newNode();
+  PairJob *jobs = new PairJob[numThreads];
+  for (int t = 0; t < numThreads; ++t) {
+    int beg = (int)((long long)n * t / numThreads);
+    int end = (int)((long long)n * (t + 1) / numThreads);
+    jobs[t].nodes = nodes + beg;
+    jobs[t].keys = keys;
+    jobs[t].values = values;
+    jobs[t].order = order + beg;
+    jobs[t].n = end - beg;
+  }
+  runJobs(jobs, numThreads);
+  buildFromNodes(nodes, n);
+
+  delete[] jobs;
+  delete[] nodes;
+  delete[] order;
+}
+
+void TreeSet::addAll(const TreeSet &s, int numThreads /* = 0 */) {
+  int n = s.size();
+  if (n == 0)
+    return;
+  const TreeSetKey **keys = new const TreeSetKey *[n];
+  const TreeSetValue **values = new const TreeSetValue *[n];
+  int i = 0;
+  for (const_iterator p = s.begin(); p != s.end(); ++p, ++i) {
+    keys[i] = p->key;
+    values[i] = p->value;
+  }
+  TreeSet copy; // The keys of s are sorted, so it is built without sorting
+  copy.assign(keys, values, n, numThreads);
+  merge(copy);
+  delete[] values;
+  delete[] keys;
+}
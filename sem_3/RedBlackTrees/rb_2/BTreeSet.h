@@ -0,0 +1,203 @@
+//
+// Set (Map) based on B+-tree
+//
+// This is an alternative to TreeSet for read-mostly sets:
+// it has the same interface (the keys and values are TreeSetKey and
+// TreeSetValue, the iterators give the pairs in increasing order of keys),
+// but a lookup reads a few nodes of several cache lines each instead of
+// chasing pointers through RBTree nodes.
+//
+// The nodes store the order hints of keys (see TreeSetKey::orderHint)
+// inline, so most comparisons are done on integers without
+// calling the virtual method compareTo.
+//
+// All pairs are in leaves; the leaves are linked in a list,
+// so range scans go through contiguous arrays.
+//
+#ifndef BTREESET_H
+#define BTREESET_H
+
+#include "TreeSet.h"
+#include "NodePool.h"
+
+class BTreeSet {
+public:
+  class Pair {
+  public:
+    const TreeSetKey *key;
+    TreeSetValue *value;
+
+    Pair() : key(0), value(0) {}
+    Pair(const TreeSetKey *k, TreeSetValue *v) : key(k), value(v) {}
+  };
+
+  typedef unsigned long long Hint;
+
+  enum {
+    CACHE_LINE_SIZE = 64,
+    NODE_SIZE = 8 * CACHE_LINE_SIZE, // Size of a node in bytes (roughly)
+    // A leaf entry: hint + pair; an inner entry: hint + key + son
+    LEAF_KEYS = (NODE_SIZE - 3 * sizeof(void *)) /
+                (sizeof(Hint) + sizeof(Pair)),
+    INNER_KEYS =
+        (NODE_SIZE - 2 * sizeof(void *)) / (sizeof(Hint) + 2 * sizeof(void *)),
+    MIN_LEAF_KEYS = LEAF_KEYS / 2,
+    MIN_INNER_KEYS = INNER_KEYS / 2
+  };
+
+private:
+  class Node {
+  public:
+    int numKeys;
+    bool leaf;
+  };
+
+  class LeafNode : public Node {
+  public:
+    LeafNode *prev; // The leaves are linked in the list
+    LeafNode *next;
+    Hint hints[LEAF_KEYS];
+    Pair pairs[LEAF_KEYS];
+  };
+
+  // The key i separates the sons i and i+1: it is the minimal key
+  // in the subtree of the son i+1. The keys in inner nodes are
+  // the copies of keys (they are deleted with inner nodes).
+  class InnerNode : public Node {
+  public:
+    Hint hints[INNER_KEYS];
+    const TreeSetKey *keys[INNER_KEYS];
+    Node *sons[INNER_KEYS + 1];
+  };
+
+  Node *rootNode;
+  LeafNode *firstLeaf;
+  LeafNode *lastLeaf;
+  int numElements;
+  NodePool leafPool;
+  NodePool innerPool;
+
+public:
+  BTreeSet();
+  ~BTreeSet() { clear(); }
+
+  void clear();
+
+  // Add a pair (key, value) to the set
+  void add(const TreeSetKey *k, const TreeSetValue *v = 0);
+
+  // Remove a key from the set
+  void remove(const TreeSetKey *key);
+
+  // Return a value of a key
+  TreeSetValue *value(const TreeSetKey *k) const;
+
+  TreeSetValue *operator[](const TreeSetKey *k) const { return value(k); }
+
+  bool contains(const TreeSetKey *k) const;
+
+  int size() const { return numElements; }
+
+  class const_iterator {
+  protected:
+    const BTreeSet *set;
+    const LeafNode *leaf; // 0 for the end of set
+    int index;
+
+  public:
+    const_iterator() : set(0), leaf(0), index(0) {}
+
+    const_iterator(const BTreeSet *s, const LeafNode *l, int i)
+        : set(s), leaf(l), index(i) {}
+
+    bool operator==(const const_iterator &i) const {
+      return (set == i.set && leaf == i.leaf && index == i.index);
+    }
+
+    bool operator!=(const const_iterator &i) const { return !operator==(i); }
+
+    const_iterator &operator++();
+    const_iterator &operator--();
+
+    const_iterator operator++(int) { // Post-increment (don't use it!)
+      const_iterator tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    const_iterator operator--(int) { // Post-decrement (don't use it!)
+      const_iterator tmp = *this;
+      --(*this);
+      return tmp;
+    }
+
+    const Pair &operator*() const { // Dereference
+      return leaf->pairs[index];
+    }
+    const Pair *operator->() const { return &(operator*()); }
+  };
+
+  class iterator : public const_iterator {
+  public:
+    iterator() : const_iterator() {}
+
+    iterator(BTreeSet *s, LeafNode *l, int i) : const_iterator(s, l, i) {}
+
+    Pair &operator*() const { // Dereference
+      return (Pair &)(((const_iterator *)this)->operator*());
+    }
+    Pair *operator->() const { return &(operator*()); }
+  };
+
+  const_iterator begin() const { return const_iterator(this, firstLeaf, 0); }
+  const_iterator end() const { return const_iterator(this, 0, 0); }
+
+  iterator begin() { return iterator(this, firstLeaf, 0); }
+  iterator end() { return iterator(this, 0, 0); }
+
+  // The first pair with the key not less than k
+  const_iterator lowerBound(const TreeSetKey *k) const;
+  iterator lowerBound(const TreeSetKey *k) {
+    const_iterator i = ((const BTreeSet *)this)->lowerBound(k);
+    return *((iterator *)&i);
+  }
+
+private:
+  BTreeSet(const BTreeSet &);            // Copying is prohibited
+  BTreeSet &operator=(const BTreeSet &); //
+
+  // Compare the key k having the hint h with the key kk having the hint hh
+  static int compare(const TreeSetKey *k, Hint h, const TreeSetKey *kk,
+                     Hint hh) {
+    if (h != hh)
+      return (h < hh) ? (-1) : 1;
+    return k->compareTo(*kk);
+  }
+
+  // The first index i in a leaf such that the key i >= k
+  static int leafLowerBound(const LeafNode *leaf, const TreeSetKey *k, Hint h);
+
+  // The index of son of inner node that may contain k
+  static int sonIndex(const InnerNode *node, const TreeSetKey *k, Hint h);
+
+  const LeafNode *findLeaf(const TreeSetKey *k, Hint h) const;
+
+  LeafNode *newLeaf();
+  InnerNode *newInner();
+
+  // Insert a new key into the subtree. If the node is split, return
+  // the new right node, its minimal key and the hint.
+  Node *insert(Node *node, const TreeSetKey *k, Hint h, TreeSetValue *v,
+               const TreeSetKey *&splitKey, Hint &splitHint);
+
+  // Remove a key from the subtree.
+  // Return true if the key was found.
+  bool remove(Node *node, const TreeSetKey *k, Hint h);
+
+  // Restore the son i of inner node that has too few keys
+  void fixSon(InnerNode *node, int i);
+
+  void removeSubtree(Node *node);
+};
+
+#endif /* BTREESET_H */
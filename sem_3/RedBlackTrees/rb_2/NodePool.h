@@ -0,0 +1,65 @@
+//
+// Pool (slab) allocator of objects of a fixed size.
+// It is used for the nodes of RBTree and the pairs of TreeSet:
+// instead of a separate "new" for every object, the objects are
+// carved one after another from big blocks, so the nodes of a tree
+// are placed compactly in memory.
+//
+// A released object is put into the list of free objects and is reused
+// by the next allocation. The method clear() releases all objects at once
+// in O(1): the blocks are not freed, they are reused by next allocations.
+//
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <stddef.h>
+
+class NodePool {
+  class Block { // Header of a block, the objects follow it
+  public:
+    Block *next;
+    double align; // Objects are aligned as double
+  };
+
+  class FreeObject { // A released object is a member of free list
+  public:
+    FreeObject *next;
+  };
+
+  size_t objectSize;
+  int objectsPerBlock;
+  Block *usedBlocks;    // Blocks that are used completely
+  Block *usedTail;      //     and the last of them
+  Block *current;       // The block from which objects are allocated
+  int numUsed;          // Number of objects allocated from current block
+  Block *spareBlocks;   // Blocks that are not used yet
+  FreeObject *freeList; // Released objects
+
+public:
+  NodePool(size_t size, int perBlock = 1024);
+  ~NodePool() { freeMemory(); }
+
+  void *allocate();
+  void release(void *p);
+
+  // Release all objects in O(1), the memory is kept for reuse
+  void clear();
+
+  // Return all the memory to the system
+  void freeMemory();
+
+  // Take all objects of another pool of the same object size,
+  // they will be released by this pool. The pool p becomes empty.
+  void adopt(NodePool &p);
+
+private:
+  NodePool(const NodePool &);            // Copying is prohibited
+  NodePool &operator=(const NodePool &); //
+
+  char *objectAddress(Block *b, int i) const {
+    return (char *)b + sizeof(Block) + (size_t)i * objectSize;
+  }
+  void pushUsed(Block *b);
+};
+
+#endif /* NODE_POOL_H */
@@ -1,6 +1,7 @@
 // Red-Black Tree
 // class RBTree, implementation
 #include <assert.h>
+#include <new>
 #include "RBTree.h"
 
 // Find a key in a subtree
@@ -52,13 +53,18 @@ bool RBTree::find(const RBTreeNodeValue *key,
 // The color of a new node is red.
 // Should be called after the "find" method, that returned "false".
 void RBTree::insert(RBTreeNode *parentNode, RBTreeNodeValue *key) {
-  assert(parentNode != 0);
+  RBTreeNode *x = newNode();
+  x->value = (void *)key;
+  insertNode(parentNode, x);
+}
+
+void RBTree::insertNode(RBTreeNode *parentNode, RBTreeNode *x) {
+  assert(parentNode != 0 && x != 0);
   int n = (-1);
   if (parentNode->value != 0)
-    n = key->compareTo(*((const RBTreeNodeValue *)parentNode->value));
+    n = ((const RBTreeNodeValue *)x->value)
+            ->compareTo(*((const RBTreeNodeValue *)parentNode->value));
   assert(n != 0);
-  RBTreeNode *x = new RBTreeNode();
-  x->value = (void *)key;
   x->parent = parentNode;
   if (parentNode == &header)
     x->red = false; // The root of tree is black
@@ -74,6 +80,10 @@ void RBTree::insert(RBTreeNode *parentNode, RBTreeNodeValue *key) {
     parentNode->right = x;
   }
   ++numNodes;
+  if (orderStatistics) {
+    x->size = 1;
+    addToSizes(parentNode, 1);
+  }
 
   if (x != root())
     rebalanceAfterInsert(x);
@@ -102,6 +112,10 @@ void RBTree::rotateLeft(RBTreeNode *x) {
     y->left->parent = x;
   y->left = x;
   x->parent = y;
+  if (orderStatistics) {
+    y->size = x->size;
+    x->size = subtreeSize(x->left) + subtreeSize(x->right) + 1;
+  }
 }
 
 // Rotate a node x to the right   //
@@ -127,9 +141,13 @@ void RBTree::rotateRight(RBTreeNode *x) {
     y->right->parent = x;
   y->right = x;
   x->parent = y;
+  if (orderStatistics) {
+    y->size = x->size;
+    x->size = subtreeSize(x->left) + subtreeSize(x->right) + 1;
+  }
 }
 
-void RBTree::rebalanceAfterInsert(RBTreeNode *x) {
+bool RBTree::rebalanceAfterInsert(RBTreeNode *x) {
   assert(x->red);
   while (x != root() && x->parent->red) {
     if (x->parent == x->parent->parent->left) {
@@ -177,41 +195,564 @@ void RBTree::rebalanceAfterInsert(RBTreeNode *x) {
   } // end while
 
   // Always color the root in black
+  bool grown = false;
   if (x == root()) {
+    grown = x->red; // A red root painted in black
     x->red = false;
   }
+  return grown;
+}
+
+// Exclude the node z from the tree (z is not deleted).
+// If z has two sons, then it is replaced by its successor y
+// (the nodes are relinked, the values are not moved, because a value
+// may be placed in the same pool object as its node).
+void RBTree::unlinkNode(RBTreeNode *z) {
+  assert(z != 0 && z != &header);
+  RBTreeNode *x;       // The node that takes the place of removed one
+  RBTreeNode *xParent; // its parent
+  bool removedRed;     // The color of the node removed from its place
+  RBTreeNode *p = z->parent;
+  if (z->left == 0 || z->right == 0) {
+    x = (z->left != 0) ? z->left : z->right;
+    xParent = p;
+    if (p->left == z)
+      p->left = x;
+    else
+      p->right = x;
+    if (x != 0)
+      x->parent = p;
+    removedRed = z->red;
+  } else {
+    RBTreeNode *y = minimalNode(z->right); // The successor of z
+    removedRed = y->red;
+    x = y->right;
+    if (y->parent == z) {
+      xParent = y;
+    } else {
+      xParent = y->parent;
+      xParent->left = x;
+      if (x != 0)
+        x->parent = xParent;
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    y->left = z->left;
+    y->left->parent = y;
+    if (p->left == z)
+      p->left = y;
+    else
+      p->right = y;
+    y->parent = p;
+    y->red = z->red;
+    y->size = z->size;
+  }
+  z->left = 0;
+  z->right = 0;
+  z->parent = 0;
+  if (orderStatistics)
+    addToSizes(xParent, -1);
+
+  if (!removedRed)
+    rebalanceAfterRemove(x, xParent);
+}
+
+void RBTree::removeNode(RBTreeNode *z) {
+  unlinkNode(z);
+  eraseNode(z);
+  deleteNode(z);
+  --numNodes;
+  assert(numNodes >= 0);
+}
+
+// The path through x has one black node less than other paths
+void RBTree::rebalanceAfterRemove(RBTreeNode *x, RBTreeNode *xParent) {
+  while (x != root() && (x == 0 || !x->red)) {
+    if (x == xParent->left) {
+      RBTreeNode *w = xParent->right; // The sibling of x, it is not 0
+      assert(w != 0);
+      if (w->red) {
+        // Make the sibling black
+        w->red = false;
+        xParent->red = true;
+        rotateLeft(xParent);
+        w = xParent->right;
+      }
+      if ((w->left == 0 || !w->left->red) &&
+          (w->right == 0 || !w->right->red)) {
+        // Both sons of w are black: paint w in red and go up
+        w->red = true;
+        x = xParent;
+        xParent = x->parent;
+      } else {
+        if (w->right == 0 || !w->right->red) {
+          // Make the right son of w red
+          w->left->red = false;
+          w->red = true;
+          rotateRight(w);
+          w = xParent->right;
+        }
+        w->red = xParent->red;
+        xParent->red = false;
+        w->right->red = false;
+        rotateLeft(xParent);
+        x = root();
+      }
+    } else {
+      // Mirror case: x is a right son
+      RBTreeNode *w = xParent->left;
+      assert(w != 0);
+      if (w->red) {
+        w->red = false;
+        xParent->red = true;
+        rotateRight(xParent);
+        w = xParent->left;
+      }
+      if ((w->left == 0 || !w->left->red) &&
+          (w->right == 0 || !w->right->red)) {
+        w->red = true;
+        x = xParent;
+        xParent = x->parent;
+      } else {
+        if (w->left == 0 || !w->left->red) {
+          w->right->red = false;
+          w->red = true;
+          rotateLeft(w);
+          w = xParent->left;
+        }
+        w->red = xParent->red;
+        xParent->red = false;
+        w->left->red = false;
+        rotateRight(xParent);
+        x = root();
+      }
+    }
+  }
+  if (x != 0)
+    x->red = false;
+}
+
+int RBTree::blackHeight(const RBTreeNode *subTreeRoot) {
+  int bh = 0;
+  for (const RBTreeNode *x = subTreeRoot; x != 0; x = x->left) {
+    if (!x->red)
+      ++bh;
+  }
+  return bh;
+}
+
+void RBTree::attach(RBTreeNode *t) {
+  assert(header.left == 0);
+  header.left = t;
+  if (t != 0)
+    t->parent = &header;
+}
+
+RBTreeNode *RBTree::detach() {
+  RBTreeNode *t = header.left;
+  header.left = 0;
+  if (t != 0)
+    t->parent = 0;
+  return t;
+}
+
+// Make a son of a split node a detached tree
+static RBTreeNode *detachSon(RBTreeNode *x, int &bh) {
+  if (x != 0) {
+    x->parent = 0;
+    if (x->red) {
+      x->red = false;
+      ++bh;
+    }
+  }
+  return x;
+}
+
+RBTreeNode *RBTree::join(RBTreeNode *l, int bhL, RBTreeNode *k, RBTreeNode *r,
+                         int bhR, int &bh) {
+  assert(k != 0 && header.left == 0);
+  if (bhL == bhR) {
+    k->left = l;
+    k->right = r;
+    k->parent = 0;
+    k->red = false;
+    if (l != 0)
+      l->parent = k;
+    if (r != 0)
+      r->parent = k;
+    if (orderStatistics)
+      k->size = subtreeSize(l) + subtreeSize(r) + 1;
+    bh = bhL + 1;
+    return k;
+  }
+
+  // Insert k as a red node into the higher tree, at the place
+  // of a black node c on its spine with the black height of other tree;
+  // then c and other tree become the sons of k.
+  bool lHigher = (bhL > bhR);
+  int h = lHigher ? bhL : bhR;
+  int hLow = lHigher ? bhR : bhL;
+  attach(lHigher ? l : r);
+  RBTreeNode *c = root();
+  RBTreeNode *p = &header;
+  while (h > hLow || (c != 0 && c->red)) {
+    if (!c->red)
+      --h;
+    p = c;
+    c = lHigher ? c->right : c->left;
+  }
+  assert(p != &header);
+  if (lHigher) {
+    p->right = k;
+    k->left = c;
+    k->right = r;
+  } else {
+    p->left = k;
+    k->left = l;
+    k->right = c;
+  }
+  k->parent = p;
+  k->red = true;
+  if (k->left != 0)
+    k->left->parent = k;
+  if (k->right != 0)
+    k->right->parent = k;
+  if (orderStatistics) {
+    k->size = subtreeSize(k->left) + subtreeSize(k->right) + 1;
+    addToSizes(p, subtreeSize(lHigher ? r : l) + 1);
+  }
+
+  bh = lHigher ? bhL : bhR;
+  if (rebalanceAfterInsert(k))
+    ++bh;
+  return detach();
+}
+
+RBTreeNode *RBTree::join(RBTreeNode *l, int bhL, RBTreeNode *r, int bhR,
+                         int &bh) {
+  if (l == 0) {
+    bh = bhR;
+    return r;
+  }
+  if (r == 0) {
+    bh = bhL;
+    return l;
+  }
+  // Take the minimal node of r out, it joins the trees
+  attach(r);
+  RBTreeNode *k = minimalNode();
+  unlinkNode(k);
+  r = detach();
+  if (r != 0 && r->red)
+    r->red = false;
+  return join(l, bhL, k, r, blackHeight(r), bh);
+}
+
+void RBTree::split(RBTreeNode *t, int bh, const RBTreeNodeValue *key,
+                   RBTreeNode *&l, int &bhL, RBTreeNode *&r, int &bhR) {
+  if (t == 0) {
+    l = 0;
+    r = 0;
+    bhL = 0;
+    bhR = 0;
+    return;
+  }
+  int bhA = t->red ? bh : bh - 1;
+  int bhB = bhA;
+  RBTreeNode *a = detachSon(t->left, bhA);
+  RBTreeNode *b = detachSon(t->right, bhB);
+  t->left = 0;
+  t->right = 0;
+  if (key->compareTo(*((const RBTreeNodeValue *)t->value)) <= 0) {
+    // t and its right subtree go to r
+    RBTreeNode *m;
+    int bhM;
+    split(a, bhA, key, l, bhL, m, bhM);
+    r = join(m, bhM, t, b, bhB, bhR);
+  } else {
+    // t and its left subtree go to l
+    RBTreeNode *m;
+    int bhM;
+    split(b, bhB, key, m, bhM, r, bhR);
+    l = join(a, bhA, t, m, bhM, bhL);
+  }
+}
+
+int RBTree::eraseRange(const RBTreeNodeValue *lo, const RBTreeNodeValue *hi) {
+  if (root() == 0 || lo->compareTo(*hi) >= 0)
+    return 0;
+  RBTreeNode *t = detach();
+  t->red = false;
+  RBTreeNode *a, *b, *c, *d;
+  int bhA, bhB, bhC, bhD;
+  split(t, blackHeight(t), lo, a, bhA, b, bhB); // a < lo <= b
+  split(b, bhB, hi, c, bhC, d, bhD);            // lo <= c < hi <= d
+
+  // Remove the middle part
+  attach(c);
+  int numRemoved = removeSubtree(c);
+  assert(header.left == 0);
+
+  int bh;
+  attach(join(a, bhA, d, bhD, bh));
+  return numRemoved;
+}
+
+RBTreeNode *RBTree::unite(RBTreeNode *a, int bhA, RBTreeNode *b, int bhB,
+                          int &bh, int &numReplaced) {
+  if (a == 0) {
+    bh = bhB;
+    return b;
+  }
+  if (b == 0) {
+    bh = bhA;
+    return a;
+  }
+  // Split a by the root k of b, then unite the parts with the sons of k
+  RBTreeNode *k = b;
+  int bhBL = k->red ? bhB : bhB - 1;
+  int bhBR = bhBL;
+  RBTreeNode *bl = detachSon(k->left, bhBL);
+  RBTreeNode *br = detachSon(k->right, bhBR);
+  k->left = 0;
+  k->right = 0;
+  const RBTreeNodeValue *key = (const RBTreeNodeValue *)k->value;
+  RBTreeNode *l, *r;
+  int bhL, bhR;
+  split(a, bhA, key, l, bhL, r, bhR); // l < k <= r
+  if (r != 0) {
+    RBTreeNode *m = r;
+    while (m->left != 0)
+      m = m->left;
+    if (key->compareTo(*((const RBTreeNodeValue *)m->value)) == 0) {
+      // The same value in a: k replaces it
+      attach(r);
+      unlinkNode(m);
+      r = detach();
+      if (r != 0)
+        r->red = false;
+      bhR = blackHeight(r);
+      eraseNode(m);
+      deleteNode(m);
+      ++numReplaced;
+    }
+  }
+  int bhLeft, bhRight;
+  RBTreeNode *left = unite(l, bhL, bl, bhBL, bhLeft, numReplaced);
+  RBTreeNode *right = unite(r, bhR, br, bhBR, bhRight, numReplaced);
+  return join(left, bhLeft, k, right, bhRight, bh);
+}
+
+int RBTree::merge(RBTree &t) {
+  assert(t.valueSpace == valueSpace);
+  if (&t == this || t.root() == 0)
+    return 0;
+  RBTreeNode *b = t.detach();
+  int m = t.numNodes;
+  t.numNodes = 0;
+#ifndef RBTREE_NO_POOL
+  nodePool.adopt(t.nodePool); // The nodes of t are ours now
+#endif
+  if (orderStatistics && !t.orderStatistics)
+    countSizes(b);
+  b->red = false;
+
+  RBTreeNode *a = detach();
+  if (a != 0)
+    a->red = false;
+  int numReplaced = 0;
+  int bh;
+  attach(unite(a, blackHeight(a), b, blackHeight(b), bh, numReplaced));
+  numNodes += m - numReplaced;
+  return numReplaced;
+}
+
+RBTreeNode *RBTree::buildSubtree(RBTreeNode **nodes, int n, int depth,
+                                 int redDepth) {
+  if (n <= 0)
+    return 0;
+  int middle = n / 2;
+  RBTreeNode *x = nodes[middle];
+  x->left = buildSubtree(nodes, middle, depth + 1, redDepth);
+  x->right = buildSubtree(nodes + middle + 1, n - middle - 1, depth + 1,
+                          redDepth);
+  if (x->left != 0)
+    x->left->parent = x;
+  if (x->right != 0)
+    x->right->parent = x;
+  // The halves differ in size at most by 1, so all leaves are
+  // at depths redDepth and redDepth + 1: the nodes of depth redDepth
+  // may be red
+  x->red = (depth == redDepth && depth > 0);
+  x->size = n;
+  return x;
+}
+
+void RBTree::buildFromNodes(RBTreeNode **nodes, int n) {
+  assert(root() == 0 && numNodes == 0);
+  int redDepth = 0; // The lowest level, floor(log2(n))
+  while ((2 << redDepth) <= n)
+    ++redDepth;
+  attach(buildSubtree(nodes, n, 0, redDepth));
+  numNodes = n;
 }
 
 void RBTree::eraseNode(RBTreeNode *node) {
-  delete (RBTreeNodeValue *)node->value;
+  RBTreeNodeValue *v = (RBTreeNodeValue *)node->value;
+  // Without valueSpace the address after the node may be another block
+  if (valueSpace != 0 && v == inlineValue(node))
+    v->~RBTreeNodeValue();
+  else
+    delete v;
+  node->value = 0;
+}
+
+RBTreeNode *RBTree::newNode() {
+#ifdef RBTREE_NO_POOL
+  void *p = ::operator new(sizeof(RBTreeNode) + valueSpace);
+#else
+  void *p = nodePool.allocate();
+#endif
+  return new (p) RBTreeNode();
 }
 
-void RBTree::clear() { removeSubtree(root()); }
+void RBTree::deleteNode(RBTreeNode *node) {
+  // RBTreeNode has a trivial destructor
+#ifdef RBTREE_NO_POOL
+  ::operator delete(node);
+#else
+  nodePool.release(node);
+#endif
+}
+
+void RBTree::eraseValues(RBTreeNode *subTreeRoot) {
+  // Recursion on the left son, the loop on the right one
+  while (subTreeRoot != 0) {
+    eraseValues(subTreeRoot->left);
+    eraseNode(subTreeRoot);
+    subTreeRoot = subTreeRoot->right;
+  }
+}
+
+void RBTree::clear() {
+#ifdef RBTREE_NO_POOL
+  removeSubtree(root());
+#else
+  eraseValues(root());
+  header.left = 0;
+  numNodes = 0;
+  nodePool.clear(); // All nodes are released at once
+#endif
+}
 
 int RBTree::removeSubtree(RBTreeNode *subTreeRoot) {
-  int numRemoved = 0;
   if (subTreeRoot == 0)
     return 0;
-  if (subTreeRoot->left != 0)
-    numRemoved += removeSubtree(subTreeRoot->left); // recursive call
-  if (subTreeRoot->right != 0)
-    numRemoved += removeSubtree(subTreeRoot->right); // recursive call
-
-  if (subTreeRoot->parent->left == subTreeRoot)
-    subTreeRoot->parent->left = 0;
+  RBTreeNode *p = subTreeRoot->parent;
+  if (p->left == subTreeRoot)
+    p->left = 0;
   else
-    subTreeRoot->parent->right = 0;
+    p->right = 0;
+  if (orderStatistics)
+    addToSizes(p, -subTreeRoot->size);
 
-  eraseNode(subTreeRoot);
-  delete subTreeRoot;
-  ++numRemoved;
-  --numNodes;
+  int numRemoved = freeSubtree(subTreeRoot);
+  numNodes -= numRemoved;
 
   assert(numNodes >= 0);
 
   return numRemoved;
 }
 
+int RBTree::freeSubtree(RBTreeNode *subTreeRoot) {
+  if (subTreeRoot == 0)
+    return 0;
+  int numRemoved = freeSubtree(subTreeRoot->left); // recursive call
+  numRemoved += freeSubtree(subTreeRoot->right);   // recursive call
+  eraseNode(subTreeRoot);
+  deleteNode(subTreeRoot);
+  return numRemoved + 1;
+}
+
+void RBTree::addToSizes(RBTreeNode *x, int delta) {
+  while (x != &header) {
+    x->size += delta;
+    x = x->parent;
+  }
+}
+
+int RBTree::countSizes(RBTreeNode *subTreeRoot) {
+  if (subTreeRoot == 0)
+    return 0;
+  subTreeRoot->size = countSizes(subTreeRoot->left) +
+                      countSizes(subTreeRoot->right) + 1;
+  return subTreeRoot->size;
+}
+
+void RBTree::enableOrderStatistics() {
+  countSizes(root());
+  orderStatistics = true;
+}
+
+const RBTreeNode *RBTree::select(int k) const {
+  assert(orderStatistics);
+  const RBTreeNode *x = root();
+  while (x != 0) {
+    int leftSize = subtreeSize(x->left);
+    if (k < leftSize) {
+      x = x->left;
+    } else if (k == leftSize) {
+      return x;
+    } else {
+      k -= leftSize + 1;
+      x = x->right;
+    }
+  }
+  return &header; // k is out of range
+}
+
+int RBTree::rank(const RBTreeNodeValue *key) const {
+  assert(orderStatistics);
+  int r = 0;
+  const RBTreeNode *x = root();
+  while (x != 0) {
+    if (key->compareTo(*((const RBTreeNodeValue *)x->value)) <= 0) {
+      x = x->left;
+    } else {
+      r += subtreeSize(x->left) + 1;
+      x = x->right;
+    }
+  }
+  return r;
+}
+
+int RBTree::rank(const RBTreeNode *node) const {
+  assert(orderStatistics);
+  if (node == &header)
+    return numNodes;
+  int r = subtreeSize(node->left);
+  while (node->parent != &header) {
+    if (node == node->parent->right)
+      r += subtreeSize(node->parent->left) + 1;
+    node = node->parent;
+  }
+  return r;
+}
+
+const RBTreeNode *RBTree::lowerBound(const RBTreeNodeValue *key) const {
+  const RBTreeNode *x = root();
+  const RBTreeNode *y = &header; // The last node not less than key
+  while (x != 0) {
+    if (key->compareTo(*((const RBTreeNodeValue *)x->value)) <= 0) {
+      y = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+  return y;
+}
+
 const RBTreeNode *RBTree::minimalNode(const RBTreeNode *subTreeRoot /* = 0 */
                                       ) const {
   const RBTreeNode *x = subTreeRoot;
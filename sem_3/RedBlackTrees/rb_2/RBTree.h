@@ -4,6 +4,8 @@
 #ifndef RBTREE_H
 #define RBTREE_H
 
+#include "NodePool.h"
+
 // A node in Red-Black tree
 class RBTreeNode {
 public:
@@ -11,9 +13,12 @@ public:
   RBTreeNode *right;  // pointer to the right son
   RBTreeNode *parent; // pointer to the parent
   bool red;           // the node is red (true) or black (false)
+  int size;           // the number of nodes in the subtree; it is
+                      //     maintained only if the tree counts sizes
   void *value;        // The value of tree node: normally, it is
                       //     a pair (key, value of key)
-  RBTreeNode() : left(0), right(0), parent(0), red(false), value(0) {}
+  RBTreeNode()
+      : left(0), right(0), parent(0), red(false), size(1), value(0) {}
 };
 
 typedef RBTreeNode *RBTreeNodePtr; // Pointer to the RBTreeNode
@@ -59,15 +64,59 @@ public:
   RBTreeNode header;
   int numNodes;
 
-  RBTree() : header(), numNodes(0) {
+  // The nodes are allocated from the pool, so they are placed compactly.
+  // When the macro RBTREE_NO_POOL is defined, every node is allocated
+  // by a separate "new" (it is useful for comparison).
+  NodePool nodePool;
+
+  // Every node may be followed by valueSpace bytes reserved for its value
+  // (see inlineValue), then a node and its value share a cache line.
+  size_t valueSpace;
+
+  // If true, the sizes of subtrees are maintained in nodes,
+  // then select and rank take O(log n) time
+  bool orderStatistics;
+
+  RBTree(size_t valueSize = 0)
+      : header(), numNodes(0), nodePool(sizeof(RBTreeNode) + valueSize),
+        valueSpace(valueSize), orderStatistics(false) {
     header.red = true; // The header has the red color!
   }
 
+  // Start maintaining the sizes of subtrees (it takes O(n) time once)
+  void enableOrderStatistics();
+
+  // The number of nodes in a subtree
+  static int subtreeSize(const RBTreeNode *x) { return (x != 0) ? x->size : 0; }
+
+  // The k-th node in increasing order, k = 0, 1, ..., size()-1
+  // (or header, if k is out of range). Requires orderStatistics.
+  const RBTreeNode *select(int k) const;
+  RBTreeNode *select(int k) {
+    return (RBTreeNode *)(((const RBTree *)this)->select(k));
+  }
+
+  // The number of values less than key. Requires orderStatistics.
+  int rank(const RBTreeNodeValue *key) const;
+
+  // The number of nodes preceding a node. Requires orderStatistics.
+  int rank(const RBTreeNode *node) const;
+
+  // Remove all nodes. The values are erased by eraseNode,
+  // the memory of nodes is released at once
   void clear();
   void erase() { clear(); }
   void removeAll() { clear(); }
 
-  ~RBTree() { clear(); }
+  virtual ~RBTree() { clear(); }
+
+  // Allocate a new node (not linked to the tree) / delete a node
+  RBTreeNode *newNode();
+  void deleteNode(RBTreeNode *node);
+
+  // The memory for a value placed just after the node.
+  // A value constructed there is destroyed (not deleted) by eraseNode.
+  static void *inlineValue(RBTreeNode *node) { return node + 1; }
 
   RBTreeNode *root() { return header.left; }
   const RBTreeNode *root() const { return header.left; }
@@ -92,17 +141,55 @@ public:
   // Should be called after the "find" method, that returned "false".
   void insert(RBTreeNode *parentNode, RBTreeNodeValue *v);
 
+  // The same for a node allocated by newNode, with the value assigned
+  void insertNode(RBTreeNode *parentNode, RBTreeNode *x);
+
   // Rotate a node x to the left
   void rotateLeft(RBTreeNode *x);
 
   // Rotate a node x to the right
   void rotateRight(RBTreeNode *x);
 
-  void rebalanceAfterInsert(RBTreeNode *x);
+  // Return true if the black height of the tree has grown
+  bool rebalanceAfterInsert(RBTreeNode *x);
+
+  // Remove a node from the tree in O(log n), keeping the tree balanced.
+  // The value of the node is erased by eraseNode.
+  void removeNode(RBTreeNode *z);
+
+  // Restore the Red-Black properties after a black node was removed:
+  // x (possibly 0) is the node that has taken its place,
+  // xParent is the parent of x.
+  void rebalanceAfterRemove(RBTreeNode *x, RBTreeNode *xParent);
+
+  // Remove all nodes with values v such that lo <= v < hi.
+  // The tree is split by lo and hi, the middle part is removed
+  // and the rest is joined back: O(log n + k), where k is the number
+  // of nodes removed. Return k.
+  int eraseRange(const RBTreeNodeValue *lo, const RBTreeNodeValue *hi);
 
   // Remove a subtree and return the number of nodes removed
   int removeSubtree(RBTreeNode *subTreeRoot);
 
+  // Make the empty tree of n nodes given in increasing order of values
+  // (the nodes are allocated by newNode and have the values assigned).
+  // The tree is perfectly balanced: it is built in O(n) without rotations,
+  // only the nodes of the lowest level are red.
+  void buildFromNodes(RBTreeNode **nodes, int n);
+
+  // Move all nodes of the tree t into this tree, t becomes empty.
+  // The trees must be of the same class with the same valueSpace.
+  // If a value is in both trees, the node of t replaces the node
+  // of this tree. It takes O(m log(n/m + 1)) time, where m is the size
+  // of the smaller tree. Return the number of replaced nodes.
+  int merge(RBTree &t);
+
+  // The first node with the value not less than key (or header)
+  const RBTreeNode *lowerBound(const RBTreeNodeValue *key) const;
+  RBTreeNode *lowerBound(const RBTreeNodeValue *key) {
+    return (RBTreeNode *)(((const RBTree *)this)->lowerBound(key));
+  }
+
   const RBTreeNode *minimalNode(const RBTreeNode *subTreeRoot = 0) const;
   RBTreeNode *minimalNode(const RBTreeNode *subTreeRoot = 0) {
     return (RBTreeNode *)(((const RBTree *)this)->minimalNode(subTreeRoot));
@@ -124,7 +211,59 @@ public:
   }
 
 protected:
-  void eraseNode(RBTreeNode *node);
+  // Erase the value of a node that is removed from the tree.
+  // The default implementation deletes RBTreeNodeValue
+  // or calls its destructor if the value is inline.
+  virtual void eraseNode(RBTreeNode *node);
+
+  // Erase the values of all nodes in a subtree (without removing nodes)
+  void eraseValues(RBTreeNode *subTreeRoot);
+
+  // Exclude a node from the tree and rebalance it, the node is not deleted
+  void unlinkNode(RBTreeNode *z);
+
+  // Split and join work with detached subtrees: the root of such subtree
+  // is black (or it is 0), its parent is 0, and its black height
+  // (the number of black nodes on a path from the root to a leaf)
+  // is known.
+  static int blackHeight(const RBTreeNode *subTreeRoot);
+
+  // Join the trees l < k < r using the node k, return the new root.
+  // Out: bh -- the black height of the result.
+  RBTreeNode *join(RBTreeNode *l, int bhL, RBTreeNode *k, RBTreeNode *r,
+                   int bhR, int &bh);
+
+  // Join the trees l < r, return the new root
+  RBTreeNode *join(RBTreeNode *l, int bhL, RBTreeNode *r, int bhR, int &bh);
+
+  // Split the tree t into l (the values less than key)
+  // and r (the values greater than or equal to key)
+  void split(RBTreeNode *t, int bh, const RBTreeNodeValue *key,
+             RBTreeNode *&l, int &bhL, RBTreeNode *&r, int &bhR);
+
+  // Make the tree t the tree under header / detach it from header
+  void attach(RBTreeNode *t);
+  RBTreeNode *detach();
+
+  // The union of detached trees a and b (see merge), return the new root.
+  // Out: bh -- the black height of the result,
+  //      numReplaced -- increased by the number of replaced nodes of a.
+  RBTreeNode *unite(RBTreeNode *a, int bhA, RBTreeNode *b, int bhB, int &bh,
+                    int &numReplaced);
+
+  // Link nodes[0..n-1] into a balanced subtree, return its root
+  static RBTreeNode *buildSubtree(RBTreeNode **nodes, int n, int depth,
+                                  int redDepth);
+
+  // Add delta to the sizes of a node and all its ancestors
+  void addToSizes(RBTreeNode *x, int delta);
+
+  // Recalculate the sizes in a subtree, return its size
+  static int countSizes(RBTreeNode *subTreeRoot);
+
+  // Erase and delete all nodes of a subtree (the parent is not changed),
+  // return the number of nodes
+  int freeSubtree(RBTreeNode *subTreeRoot);
 
 public:
   class const_iterator {
@@ -13,11 +13,19 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/time.h>
+#include <new>
 #include "RBTree.h"
+#include "TreeSet.h"
+#include "BTreeSet.h"
 
 static bool writeIntegerTree(const RBTreeNode *root, FILE *f, int level = 0);
 static bool readIntegerTree(RBTree &tree, FILE *f);
 static void printHelp();
+static void benchmarkTree(int n);
+static bool stressTest(int n);
+static bool benchmarkSets(int n);
+static bool bulkTest(int n);
 
 class Integer : public RBTreeNodeValue {
 public:
@@ -198,7 +206,46 @@ int main() {
       printf("\n");
     }
     ///////////////////// ================================================
-    else if (strncmp("quit", line + commandBeg, commandLen) == 0)
+    else if (strncmp("bench", line + commandBeg, commandLen) == 0) {
+      while (i < len && isspace(line[i]))
+        ++i; // Skip a space
+      if (i >= len || !isdigit(line[i])) {
+        printf("Incorrect command.\n");
+        printHelp();
+        continue;
+      }
+      benchmarkTree(atoi(line + i));
+    } else if (strncmp("stress", line + commandBeg, commandLen) == 0) {
+      while (i < len && isspace(line[i]))
+        ++i; // Skip a space
+      if (i >= len || !isdigit(line[i])) {
+        printf("Incorrect command.\n");
+        printHelp();
+        continue;
+      }
+      if (stressTest(atoi(line + i)))
+        printf("OK\n");
+    } else if (strncmp("setbench", line + commandBeg, commandLen) == 0) {
+      while (i < len && isspace(line[i]))
+        ++i; // Skip a space
+      if (i >= len || !isdigit(line[i])) {
+        printf("Incorrect command.\n");
+        printHelp();
+        continue;
+      }
+      if (benchmarkSets(atoi(line + i)))
+        printf("OK\n");
+    } else if (strncmp("bulk", line + commandBeg, commandLen) == 0) {
+      while (i < len && isspace(line[i]))
+        ++i; // Skip a space
+      if (i >= len || !isdigit(line[i])) {
+        printf("Incorrect command.\n");
+        printHelp();
+        continue;
+      }
+      if (bulkTest(atoi(line + i)))
+        printf("OK\n");
+    } else if (strncmp("quit", line + commandBeg, commandLen) == 0)
       break; // end if
   }          // end while
 
@@ -282,7 +329,7 @@ static bool readIntegerTree(RBTree &tree, FILE *f) {
     RBTree rightSubtree;
     if (!readIntegerTree(rightSubtree, f))
       return false;
-    RBTreeNode *rootNode = new RBTreeNode();
+    RBTreeNode *rootNode = tree.newNode();
     rootNode->red = red;
     rootNode->value = new Integer(n);
     tree.header.left = rootNode;
@@ -296,6 +343,8 @@ static bool readIntegerTree(RBTree &tree, FILE *f) {
 
       leftSubtree.header.left = 0;
       leftSubtree.numNodes = 0;
+      // The nodes now belong to the pool of tree
+      tree.nodePool.adopt(leftSubtree.nodePool);
     }
 
     if (rightSubtree.size() > 0) {
@@ -305,6 +354,8 @@ static bool readIntegerTree(RBTree &tree, FILE *f) {
 
       rightSubtree.header.left = 0;
       rightSubtree.numNodes = 0;
+      // The nodes now belong to the pool of tree
+      tree.nodePool.adopt(rightSubtree.nodePool);
     }
   }
 
@@ -321,5 +372,416 @@ static void printHelp() {
          "read a tree from the file \"fileName\"\n"
          "  writetree fileName\t"
          "write a tree into the file \"fileName\"\n"
+         "  bench n\t\t"
+         "time building, traversal and clearing of a tree with n nodes\n"
+         "  stress n\t\t"
+         "n random insertions and removals, checking the tree\n"
+         "  setbench n\t\t"
+         "compare TreeSet and BTreeSet with n keys\n"
+         "  bulk n\t\t\t"
+         "bulk loading and merging of sets with n keys\n"
          "  quit\t\t\tquit\n");
 }
+
+static double currentTime() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+
+// Measure the time of building a tree of n random keys,
+// of in-order traversal and of removing all nodes.
+// Compile with -DRBTREE_NO_POOL to compare with the version where
+// every node is allocated by a separate "new".
+static void benchmarkTree(int n) {
+#ifdef RBTREE_NO_POOL
+  RBTree tree;
+#else
+  RBTree tree(sizeof(Integer));
+#endif
+  double t0 = currentTime();
+  while (tree.size() < n) {
+    // Keys are less than 2^30, so compareTo does not overflow
+    Integer num(rand() & 0x3fffffff);
+    RBTreeNode *node;
+    if (!tree.find(&num, tree.root(), &node)) {
+#ifdef RBTREE_NO_POOL
+      tree.insert(node, new Integer(num));
+#else
+      // The value is placed in the same pool object as the node
+      RBTreeNode *x = tree.newNode();
+      x->value = new (RBTree::inlineValue(x)) Integer(num);
+      tree.insertNode(node, x);
+#endif
+    }
+  }
+  double t1 = currentTime();
+
+  long long sum = 0;
+  RBTree::const_iterator i = tree.begin();
+  RBTree::const_iterator e = tree.end();
+  while (i != e) {
+    sum += ((const Integer *)i->value)->number;
+    ++i;
+  }
+  double t2 = currentTime();
+
+  tree.clear();
+  double t3 = currentTime();
+
+#ifdef RBTREE_NO_POOL
+  printf("Nodes allocated by new:\n");
+#else
+  printf("Nodes allocated from pool:\n");
+#endif
+  printf("  build %d nodes:\t%.3f sec\n"
+         "  traversal:\t\t%.3f sec (checksum %lld)\n"
+         "  clear:\t\t%.3f sec\n",
+         n, t1 - t0, t2 - t1, sum, t3 - t2);
+}
+
+// Check the Red-Black properties of a subtree, the order of values
+// and the parent pointers. Return the black height or (-1) on error.
+// If sizes == true, check also the sizes of subtrees.
+static int checkSubtree(const RBTreeNode *x, const RBTreeNode *parent,
+                        const Integer *lo, const Integer *hi, bool sizes,
+                        int &count) {
+  if (x == 0)
+    return 0;
+  const Integer *v = (const Integer *)x->value;
+  if (x->parent != parent) {
+    printf("Wrong parent of %d\n", v->number);
+    return (-1);
+  }
+  if ((lo != 0 && v->number <= lo->number) ||
+      (hi != 0 && v->number >= hi->number)) {
+    printf("Wrong order at %d\n", v->number);
+    return (-1);
+  }
+  if (x->red && ((x->left != 0 && x->left->red) ||
+                 (x->right != 0 && x->right->red))) {
+    printf("Red node %d has a red son\n", v->number);
+    return (-1);
+  }
+  int c = count;
+  ++count;
+  int bl = checkSubtree(x->left, x, lo, v, sizes, count);
+  int br = checkSubtree(x->right, x, v, hi, sizes, count);
+  if (bl < 0 || br < 0)
+    return (-1);
+  if (sizes && x->size != count - c) {
+    printf("Wrong size of subtree %d\n", v->number);
+    return (-1);
+  }
+  if (bl != br) {
+    printf("Different black heights at %d\n", v->number);
+    return (-1);
+  }
+  return bl + (x->red ? 0 : 1);
+}
+
+static bool checkTree(const RBTree &tree) {
+  const RBTreeNode *root = tree.root();
+  if (root != 0 && root->red) {
+    printf("The root is red\n");
+    return false;
+  }
+  int count = 0;
+  if (checkSubtree(root, &tree.header, 0, 0, tree.orderStatistics, count) <
+      0)
+    return false;
+  if (count != tree.size()) {
+    printf("Wrong number of nodes: %d, size() = %d\n", count, tree.size());
+    return false;
+  }
+  return true;
+}
+
+// Random insertions, removals of single nodes and of ranges.
+// After every operation the tree is checked and compared
+// with the set of keys kept in a plain array.
+// In the second half of the test the tree maintains the sizes
+// of subtrees, and select and rank are checked too.
+static bool stressTest(int n) {
+  const int MAX_KEY = 2 * n + 1;
+  bool *present = new bool[MAX_KEY];
+  memset(present, 0, MAX_KEY * sizeof(bool));
+  int numKeys = 0;
+  bool ok = true;
+  RBTree tree;
+  for (int step = 0; ok && step < 4 * n; ++step) {
+    if (step == 2 * n)
+      tree.enableOrderStatistics();
+    int op = rand() % 100;
+    Integer key(rand() % MAX_KEY);
+    RBTreeNode *node;
+    bool found = tree.find(&key, tree.root(), &node);
+    if (op < 55) {
+      if (!found) {
+        tree.insert(node, new Integer(key));
+        present[key.number] = true;
+        ++numKeys;
+      }
+    } else if (op < 95) {
+      if (found) {
+        tree.removeNode(node);
+        present[key.number] = false;
+        --numKeys;
+      }
+    } else {
+      Integer hi(key.number + rand() % (MAX_KEY / 8 + 1));
+      int expected = 0;
+      for (int k = key.number; k < hi.number && k < MAX_KEY; ++k) {
+        if (present[k]) {
+          present[k] = false;
+          ++expected;
+        }
+      }
+      int removed = tree.eraseRange(&key, &hi);
+      numKeys -= expected;
+      if (removed != expected) {
+        printf("eraseRange removed %d nodes instead of %d\n", removed,
+               expected);
+        ok = false;
+      }
+    }
+    ok = ok && checkTree(tree);
+    if (ok && tree.size() != numKeys) {
+      printf("Wrong size %d instead of %d\n", tree.size(), numKeys);
+      ok = false;
+    }
+    // Compare the keys with the array
+    RBTree::const_iterator i = tree.begin();
+    RBTree::const_iterator e = tree.end();
+    int r = 0; // The rank of k
+    for (int k = 0; ok && k < MAX_KEY; ++k) {
+      if (tree.orderStatistics && (k % 7 == 0 || present[k])) {
+        Integer key(k);
+        if (tree.rank(&key) != r) {
+          printf("Wrong rank of %d\n", k);
+          ok = false;
+        }
+      }
+      if (!present[k])
+        continue;
+      if (i == e || ((const Integer *)i->value)->number != k) {
+        printf("Key %d is lost\n", k);
+        ok = false;
+      } else {
+        if (tree.orderStatistics &&
+            (tree.select(r) != &(*i) || tree.rank(&(*i)) != r)) {
+          printf("Wrong select(%d)\n", r);
+          ok = false;
+        }
+        ++i;
+        ++r;
+      }
+    }
+    if (tree.orderStatistics && tree.select(r) != &tree.header) {
+      printf("select(size()) is not the end\n");
+      ok = false;
+    }
+    if (!ok)
+      printf("Error at step %d\n", step);
+  }
+  delete[] present;
+  return ok;
+}
+
+// An integer key for TreeSet and BTreeSet
+class IntKey : public TreeSetKey {
+public:
+  int number; // Non-negative
+
+  IntKey(int n = 0) : TreeSetKey(), number(n) {}
+  virtual int compareTo(const TreeSetKey &k) const {
+    return (number - ((const IntKey &)k).number);
+  }
+  virtual IntKey *clone() const { return new IntKey(*this); }
+  virtual unsigned long long orderHint() const { return number; }
+};
+
+class IntValue : public TreeSetValue {
+public:
+  int number;
+
+  IntValue(int n = 0) : TreeSetValue(), number(n) {}
+  virtual IntValue *clone() const { return new IntValue(*this); }
+};
+
+// Compare the contents of the sets
+template <class Set1, class Set2>
+static bool equalSets(const Set1 &s1, const Set2 &s2) {
+  typename Set1::const_iterator i1 = s1.begin();
+  typename Set2::const_iterator i2 = s2.begin();
+  while (i1 != s1.end() && i2 != s2.end()) {
+    if (((const IntKey *)i1->key)->number != ((const IntKey *)i2->key)->number)
+      return false;
+    ++i1;
+    ++i2;
+  }
+  return (i1 == s1.end() && i2 == s2.end());
+}
+
+// Time of point lookups of the keys (half of them are absent)
+// and of range scans of 100 keys starting from random points
+template <class Set>
+static void benchmarkSet(const Set &set, const int *keys, int n,
+                         const char *name) {
+  double t0 = currentTime();
+  int found = 0;
+  for (int j = 0; j < n; ++j) {
+    IntKey k(keys[j] + (j & 1)); // Keys are even
+    if (set.value(&k) != 0)
+      ++found;
+  }
+  double t1 = currentTime();
+  long long sum = 0;
+  for (int j = 0; j < n / 100 + 1; ++j) {
+    IntKey k(keys[(j * 7919) % n]);
+    typename Set::const_iterator i = set.lowerBound(&k);
+    for (int m = 0; m < 100 && i != set.end(); ++m, ++i)
+      sum += ((const IntValue *)i->value)->number;
+  }
+  double t2 = currentTime();
+  printf("  %s:\tlookups %.3f sec (%d found), range scans %.3f sec "
+         "(checksum %lld)\n",
+         name, t1 - t0, found, t2 - t1, sum);
+}
+
+// Compare the RB-tree and B+-tree implementations of sets
+static bool benchmarkSets(int n) {
+  if (n <= 0)
+    return true;
+  int *keys = new int[n];
+  for (int j = 0; j < n; ++j)
+    keys[j] = (rand() & 0x1fffffff) * 2;
+
+  TreeSet rbSet;
+  BTreeSet bSet;
+  double t0 = currentTime();
+  for (int j = 0; j < n; ++j) {
+    IntKey k(keys[j]);
+    IntValue v(j);
+    rbSet.add(&k, &v);
+  }
+  double t1 = currentTime();
+  for (int j = 0; j < n; ++j) {
+    IntKey k(keys[j]);
+    IntValue v(j);
+    bSet.add(&k, &v);
+  }
+  double t2 = currentTime();
+  printf("Build: TreeSet %.3f sec, BTreeSet %.3f sec, %d keys\n", t1 - t0,
+         t2 - t1, bSet.size());
+
+  benchmarkSet(rbSet, keys, n, "TreeSet");
+  benchmarkSet(bSet, keys, n, "BTreeSet");
+
+  // Remove a half of keys and compare the sets
+  bool ok = equalSets(rbSet, bSet);
+  for (int j = 0; ok && j < n; j += 2) {
+    IntKey k(keys[j]);
+    rbSet.remove(&k);
+    bSet.remove(&k);
+  }
+  ok = ok && rbSet.size() == bSet.size() && equalSets(rbSet, bSet);
+  if (!ok)
+    printf("The sets are different\n");
+  delete[] keys;
+  return ok;
+}
+
+// Build an RBTree from the integers lo, lo + step, ... (count of them)
+static void buildIntegerTree(RBTree &tree, int lo, int step, int count) {
+  RBTreeNode **nodes = new RBTreeNode *[count];
+  for (int j = 0; j < count; ++j) {
+    nodes[j] = tree.newNode();
+    nodes[j]->value = new Integer(lo + j * step);
+  }
+  tree.buildFromNodes(nodes, count);
+  delete[] nodes;
+}
+
+// Compare the values of pairs with equal keys
+static bool equalValues(const TreeSet &s1, const TreeSet &s2) {
+  TreeSet::const_iterator i1 = s1.begin();
+  TreeSet::const_iterator i2 = s2.begin();
+  for (; i1 != s1.end() && i2 != s2.end(); ++i1, ++i2) {
+    if (((const IntValue *)i1->value)->number !=
+        ((const IntValue *)i2->value)->number)
+      return false;
+  }
+  return true;
+}
+
+// Check the trees built from sorted nodes and merged by split/join,
+// then compare the time of building a TreeSet by add(), by assign()
+// and by merging two sets
+static bool bulkTest(int n) {
+  bool ok = true;
+  for (int m = 0; ok && m <= 100; ++m) {
+    RBTree t1, t2;
+    t1.enableOrderStatistics();
+    buildIntegerTree(t1, 0, 3, m);          // 0, 3, 6, ...
+    buildIntegerTree(t2, m, 2, m / 2 + 1); // m, m + 2, ...
+    ok = checkTree(t1) && checkTree(t2);
+    int numCommon = 0;
+    for (int j = 0; j <= m / 2; ++j) {
+      int x = m + 2 * j;
+      if (x % 3 == 0 && x < 3 * m)
+        ++numCommon;
+    }
+    int replaced = t1.merge(t2);
+    if (ok && (!checkTree(t1) || t2.size() != 0 || replaced != numCommon ||
+               t1.size() != m + m / 2 + 1 - numCommon)) {
+      printf("Wrong merge of trees of sizes %d and %d\n", m, m / 2 + 1);
+      ok = false;
+    }
+  }
+  if (!ok || n <= 0)
+    return ok;
+
+  int *keys = new int[n];
+  const TreeSetKey **k = new const TreeSetKey *[n];
+  const TreeSetValue **v = new const TreeSetValue *[n];
+  for (int j = 0; j < n; ++j) {
+    keys[j] = rand() % n; // Some keys are repeated
+    k[j] = new IntKey(keys[j]);
+    v[j] = new IntValue(j);
+  }
+
+  TreeSet added, loaded, loaded1, merged, half;
+  double t0 = currentTime();
+  for (int j = 0; j < n; ++j)
+    added.add(k[j], v[j]);
+  double t1 = currentTime();
+  loaded.assign(k, v, n);
+  double t2 = currentTime();
+  loaded1.assign(k, v, n, 1);
+  double t3 = currentTime();
+  // The halves overlap, the pairs of the second one replace the first
+  merged.assign(k, v, n / 2);
+  half.assign(k + n / 2, v + n / 2, n - n / 2);
+  double t4 = currentTime();
+  merged.merge(half);
+  double t5 = currentTime();
+  printf("TreeSet of %d keys: add %.3f sec, assign %.3f sec "
+         "(1 thread %.3f sec), merge of halves %.3f sec\n",
+         added.size(), t1 - t0, t2 - t1, t3 - t2, t5 - t4);
+
+  ok = equalSets(added, loaded) && equalValues(added, loaded) &&
+       equalSets(added, loaded1) && equalValues(added, loaded1) &&
+       equalSets(added, merged) && equalValues(added, merged) &&
+       half.size() == 0;
+  if (!ok)
+    printf("The sets are different\n");
+  for (int j = 0; j < n; ++j) {
+    delete k[j];
+    delete v[j];
+  }
+  delete[] v;
+  delete[] k;
+  delete[] keys;
+  return ok;
+}
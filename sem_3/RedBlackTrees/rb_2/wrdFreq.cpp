@@ -32,6 +32,7 @@
 #include <assert.h>
 
 #include "TreeSet.h"
+#include "WordReader.h"
 
 static void printHelp();
 
@@ -40,7 +41,11 @@ static void printHelp();
 // This is the dynamic array of characters.
 // The class Word is derived from class TreeSetKey,
 // so the object of this class can be used
-// as keys in TreeSet
+// as keys in TreeSet.
+// A word either owns its characters (capacity > 0),
+// or is a view of external memory (capacity == 0), for instance,
+// of the buffer of WordReader. A view is not null-terminated;
+// a copy of any word owns a null-terminated string.
 //
 // Interface of class Word:
 //
@@ -53,36 +58,73 @@ public:
   Word();
   Word(const char *s, int l = (-1)); // (-1) means "undefined"
   Word(const Word &w);
-  virtual ~Word() { delete[] str; }
+  virtual ~Word() { clear(); }
   virtual Word *clone() const { return new Word(*this); }
 
+  Word &operator=(const Word &w);
+
   int length() const { return len; }
   int size() const { return len; }
-  void initialize();
 
-  // Add a character to the end of word
-  Word &operator+=(int c);
+  // Make the word a view of l characters starting from s
+  void setView(const char *s, int l);
 
-  // Convertor to C-string
+  // Convertor to C-string (only for words that own their characters)
   operator const char *() { return str; }
   const char *getString() const { return str; }
 
   virtual bool operator==(const TreeSetKey &s) const {
-    return (strcmp(str, ((Word &)s).str) == 0);
+    return (compareTo(s) == 0);
   }
 
   virtual int compareTo(const TreeSetKey &key) const {
-    return strcmp(str, ((const Word &)key).str);
+    const Word &w = (const Word &)key;
+    int n = memcmp(str, w.str, (len < w.len) ? len : w.len);
+    if (n != 0)
+      return n;
+    return len - w.len;
+  }
+
+  // The first 8 characters as a big-endian number
+  virtual unsigned long long orderHint() const {
+    unsigned long long h = 0;
+    for (int i = 0; i < 8; ++i) {
+      h <<= 8;
+      if (i < len)
+        h |= (unsigned char)str[i];
+    }
+    return h;
   }
+
+private:
+  void assign(const char *s, int l);
+  void clear();
 };
 
 // Implementation of class Word
 Word::Word() : TreeSetKey(), str(0), len(0), capacity(0) {}
 
 Word::Word(const char *s, int l) : TreeSetKey(), str(0), len(0), capacity(0) {
-  assert(str != 0);
+  assert(s != 0);
   if (l < 0)
-    l = strlen(str);
+    l = strlen(s);
+  assign(s, l);
+}
+
+Word::Word(const Word &w) : TreeSetKey(w), str(0), len(0), capacity(0) {
+  assign(w.str, w.len);
+}
+
+Word &Word::operator=(const Word &w) {
+  if (this != &w) {
+    clear();
+    assign(w.str, w.len);
+  }
+  return *this;
+}
+
+// Copy l characters starting from s (the word must be empty)
+void Word::assign(const char *s, int l) {
   len = l;
   capacity = len + 1;
   str = new char[capacity];
@@ -90,37 +132,18 @@ Word::Word(const char *s, int l) : TreeSetKey(), str(0), len(0), capacity(0) {
   str[len] = 0;
 }
 
-Word::Word(const Word &w)
-    : TreeSetKey(w), str(0), len(w.len), capacity(w.capacity) {
-  if (w.len > 0) {
-    str = new char[w.capacity];
-    memmove(str, w.str, capacity);
-  }
-}
-
-void Word::initialize() {
-  len = 0;
+void Word::clear() {
   if (capacity > 0)
-    str[0] = 0;
+    delete[] str;
+  str = 0;
+  len = 0;
+  capacity = 0;
 }
 
-// Add a character to the end of word
-Word &Word::operator+=(int c) {
-  if (capacity <= len + 1) {
-    // Allocate additional space
-    int extent = capacity / 8;
-    if (extent < 16)
-      extent = 16;
-    char *new_str = new char[capacity + extent];
-    memmove(new_str, str, len);
-    delete[] str;
-    capacity += extent;
-    str = new_str;
-  }
-  str[len] = (char)c;
-  ++len;
-  str[len] = 0;
-  return *this;
+void Word::setView(const char *s, int l) {
+  clear();
+  str = (char *)s;
+  len = l;
 }
 
 // class Integer represents the number of inclusions of word in text
@@ -142,45 +165,36 @@ public:
 
 int main(int argc, char *argv[]) {
   TreeSet set;
-  FILE *input;
+  WordReader input;
+  const char *fileName = 0; // Standard input
   if (argc > 1) {
     if (*argv[1] == '-') {
       printHelp();
       return 0;
     }
-    input = fopen(argv[1], "r");
-    if (input == 0) {
-      perror("Cannot open an input file");
-      return 1;
-    }
-  } else {
-    input = stdin; // Standard input
+    fileName = argv[1];
+  }
+  if (!input.open(fileName)) {
+    perror("Cannot open an input file");
+    return 1;
   }
 
+  // The current word is a view of the input buffer,
+  // it is copied only when a new key is added to the set
   Word currentWord;
-  bool wasLetter = false;
-  bool endOfFileDetected = false;
-  while (!endOfFileDetected) {
-    int c = fgetc(input);
-    if (isalpha(c)) {   // If this is an English letter
-      currentWord += c; // Add a letter to a word
-      wasLetter = true;
+  const char *s;
+  int l;
+  while (input.nextWord(s, l)) {
+    currentWord.setView(s, l);
+    Integer *val = (Integer *)set.value(&currentWord);
+    if (val != 0) {
+      ++(val->number); // Increment a number of inclusions
     } else {
-      if (wasLetter) {
-        // The end of current word detected
-        if (set.contains(&currentWord)) {
-          Integer *val = (Integer *)set.value(&currentWord);
-          ++(val->number); // Increment a number of inclusions
-        } else {
-          Integer unit(1);
-          set.add(&currentWord, &unit);
-        }
-        currentWord.initialize();
-      }
-      wasLetter = false;
-      endOfFileDetected = (c == EOF);
+      Integer unit(1);
+      set.add(&currentWord, &unit);
     }
   }
+  input.printStatistics();
 
   // Print the set of words in the text and
   // define the most frequent word
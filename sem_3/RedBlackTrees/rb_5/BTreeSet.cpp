@@ -0,0 +1,475 @@
+// Set (Map) based on B+-tree
+// class BTreeSet, implementation
+#include <assert.h>
+#include <new>
+#include "BTreeSet.h"
+
+BTreeSet::BTreeSet()
+    : rootNode(0), firstLeaf(0), lastLeaf(0), numElements(0),
+      leafPool(sizeof(LeafNode), 256), innerPool(sizeof(InnerNode), 64) {}
+
+BTreeSet::LeafNode *BTreeSet::newLeaf() {
+  LeafNode *leaf = new (leafPool.allocate()) LeafNode();
+  leaf->numKeys = 0;
+  leaf->leaf = true;
+  leaf->prev = 0;
+  leaf->next = 0;
+  return leaf;
+}
+
+BTreeSet::InnerNode *BTreeSet::newInner() {
+  InnerNode *node = new (innerPool.allocate()) InnerNode();
+  node->numKeys = 0;
+  node->leaf = false;
+  return node;
+}
+
+int BTreeSet::leafLowerBound(const LeafNode *leaf, const TreeSetKey *k,
+                             Hint h) {
+  int lo = 0;
+  int hi = leaf->numKeys;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (compare(k, h, leaf->pairs[mid].key, leaf->hints[mid]) > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+int BTreeSet::sonIndex(const InnerNode *node, const TreeSetKey *k, Hint h) {
+  // The number of separating keys that are not greater than k
+  int lo = 0;
+  int hi = node->numKeys;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (compare(k, h, node->keys[mid], node->hints[mid]) >= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+const BTreeSet::LeafNode *BTreeSet::findLeaf(const TreeSetKey *k,
+                                             Hint h) const {
+  const Node *node = rootNode;
+  while (node != 0 && !node->leaf) {
+    const InnerNode *inner = (const InnerNode *)node;
+    node = inner->sons[sonIndex(inner, k, h)];
+  }
+  return (const LeafNode *)node;
+}
+
+bool BTreeSet::contains(const TreeSetKey *k) const {
+  Hint h = k->orderHint();
+  const LeafNode *leaf = findLeaf(k, h);
+  if (leaf == 0)
+    return false;
+  int i = leafLowerBound(leaf, k, h);
+  return (i < leaf->numKeys &&
+          compare(k, h, leaf->pairs[i].key, leaf->hints[i]) == 0);
+}
+
+TreeSetValue *BTreeSet::value(const TreeSetKey *k) const {
+  Hint h = k->orderHint();
+  const LeafNode *leaf = findLeaf(k, h);
+  if (leaf == 0)
+    return 0;
+  int i = leafLowerBound(leaf, k, h);
+  if (i < leaf->numKeys &&
+      compare(k, h, leaf->pairs[i].key, leaf->hints[i]) == 0)
+    return leaf->pairs[i].value;
+  return 0;
+}
+
+BTreeSet::const_iterator BTreeSet::lowerBound(const TreeSetKey *k) const {
+  Hint h = k->orderHint();
+  const LeafNode *leaf = findLeaf(k, h);
+  if (leaf == 0)
+    return end();
+  int i = leafLowerBound(leaf, k, h);
+  if (i >= leaf->numKeys) {
+    // All keys of the leaf are less than k
+    leaf = leaf->next;
+    i = 0;
+  }
+  return const_iterator(this, leaf, i);
+}
+
+void BTreeSet::add(const TreeSetKey *k, const TreeSetValue *v /* = 0 */) {
+  Hint h = k->orderHint();
+  LeafNode *leaf = (LeafNode *)findLeaf(k, h);
+  if (leaf != 0) {
+    int i = leafLowerBound(leaf, k, h);
+    if (i < leaf->numKeys &&
+        compare(k, h, leaf->pairs[i].key, leaf->hints[i]) == 0) {
+      // The key is already in the set
+      delete leaf->pairs[i].value; // Remove the old value
+      leaf->pairs[i].value = (v != 0) ? v->clone() : 0;
+      return;
+    }
+  }
+
+  TreeSetValue *val = (v != 0) ? v->clone() : 0;
+  if (rootNode == 0) {
+    LeafNode *leaf = newLeaf();
+    firstLeaf = leaf;
+    lastLeaf = leaf;
+    rootNode = leaf;
+  }
+  const TreeSetKey *splitKey;
+  Hint splitHint;
+  Node *right = insert(rootNode, k->clone(), h, val, splitKey, splitHint);
+  if (right != 0) {
+    // The root is split: the tree grows up
+    InnerNode *r = newInner();
+    r->numKeys = 1;
+    r->keys[0] = splitKey;
+    r->hints[0] = splitHint;
+    r->sons[0] = rootNode;
+    r->sons[1] = right;
+    rootNode = r;
+  }
+  ++numElements;
+}
+
+BTreeSet::Node *BTreeSet::insert(Node *node, const TreeSetKey *k, Hint h,
+                                 TreeSetValue *v, const TreeSetKey *&splitKey,
+                                 Hint &splitHint) {
+  if (node->leaf) {
+    LeafNode *leaf = (LeafNode *)node;
+    int i = leafLowerBound(leaf, k, h);
+    LeafNode *right = 0;
+    if (leaf->numKeys == LEAF_KEYS) {
+      // Split the leaf: the upper half goes to the new right leaf
+      right = newLeaf();
+      int mid = LEAF_KEYS / 2;
+      right->numKeys = LEAF_KEYS - mid;
+      for (int j = mid; j < LEAF_KEYS; ++j) {
+        right->hints[j - mid] = leaf->hints[j];
+        right->pairs[j - mid] = leaf->pairs[j];
+      }
+      leaf->numKeys = mid;
+      right->prev = leaf;
+      right->next = leaf->next;
+      if (leaf->next != 0)
+        leaf->next->prev = right;
+      else
+        lastLeaf = right;
+      leaf->next = right;
+      if (i > mid) {
+        leaf = right;
+        i -= mid;
+      }
+    }
+    for (int j = leaf->numKeys; j > i; --j) {
+      leaf->hints[j] = leaf->hints[j - 1];
+      leaf->pairs[j] = leaf->pairs[j - 1];
+    }
+    leaf->hints[i] = h;
+    leaf->pairs[i] = Pair(k, v);
+    ++(leaf->numKeys);
+    if (right != 0) {
+      splitKey = right->pairs[0].key->clone();
+      splitHint = right->hints[0];
+    }
+    return right;
+  }
+
+  InnerNode *inner = (InnerNode *)node;
+  int i = sonIndex(inner, k, h);
+  const TreeSetKey *sonKey;
+  Hint sonHint;
+  Node *newSon = insert(inner->sons[i], k, h, v, sonKey, sonHint);
+  if (newSon == 0)
+    return 0;
+
+  if (inner->numKeys < INNER_KEYS) {
+    for (int j = inner->numKeys; j > i; --j) {
+      inner->keys[j] = inner->keys[j - 1];
+      inner->hints[j] = inner->hints[j - 1];
+      inner->sons[j + 1] = inner->sons[j];
+    }
+    inner->keys[i] = sonKey;
+    inner->hints[i] = sonHint;
+    inner->sons[i + 1] = newSon;
+    ++(inner->numKeys);
+    return 0;
+  }
+
+  // Split the inner node: put all keys in temporary arrays,
+  // the middle key goes up
+  const TreeSetKey *keys[INNER_KEYS + 1];
+  Hint hints[INNER_KEYS + 1];
+  Node *sons[INNER_KEYS + 2];
+  int n = 0;
+  sons[0] = inner->sons[0];
+  for (int j = 0; j < INNER_KEYS; ++j) {
+    if (j == i) {
+      keys[n] = sonKey;
+      hints[n] = sonHint;
+      sons[n + 1] = newSon;
+      ++n;
+    }
+    keys[n] = inner->keys[j];
+    hints[n] = inner->hints[j];
+    sons[n + 1] = inner->sons[j + 1];
+    ++n;
+  }
+  if (i == INNER_KEYS) {
+    keys[n] = sonKey;
+    hints[n] = sonHint;
+    sons[n + 1] = newSon;
+    ++n;
+  }
+  assert(n == INNER_KEYS + 1);
+
+  int mid = n / 2;
+  InnerNode *right = newInner();
+  inner->numKeys = mid;
+  for (int j = 0; j < mid; ++j) {
+    inner->keys[j] = keys[j];
+    inner->hints[j] = hints[j];
+    inner->sons[j] = sons[j];
+  }
+  inner->sons[mid] = sons[mid];
+  right->numKeys = n - mid - 1;
+  for (int j = mid + 1; j < n; ++j) {
+    right->keys[j - mid - 1] = keys[j];
+    right->hints[j - mid - 1] = hints[j];
+    right->sons[j - mid - 1] = sons[j];
+  }
+  right->sons[n - mid - 1] = sons[n];
+  splitKey = keys[mid];
+  splitHint = hints[mid];
+  return right;
+}
+
+void BTreeSet::remove(const TreeSetKey *k) {
+  if (rootNode == 0)
+    return;
+  if (!remove(rootNode, k, k->orderHint()))
+    return;
+  --numElements;
+
+  // Shrink the tree
+  if (rootNode->numKeys == 0) {
+    if (rootNode->leaf) {
+      leafPool.release(rootNode);
+      rootNode = 0;
+      firstLeaf = 0;
+      lastLeaf = 0;
+    } else {
+      Node *son = ((InnerNode *)rootNode)->sons[0];
+      innerPool.release(rootNode);
+      rootNode = son;
+    }
+  }
+}
+
+bool BTreeSet::remove(Node *node, const TreeSetKey *k, Hint h) {
+  if (node->leaf) {
+    LeafNode *leaf = (LeafNode *)node;
+    int i = leafLowerBound(leaf, k, h);
+    if (i >= leaf->numKeys ||
+        compare(k, h, leaf->pairs[i].key, leaf->hints[i]) != 0)
+      return false;
+    delete leaf->pairs[i].key;
+    delete leaf->pairs[i].value;
+    --(leaf->numKeys);
+    for (int j = i; j < leaf->numKeys; ++j) {
+      leaf->hints[j] = leaf->hints[j + 1];
+      leaf->pairs[j] = leaf->pairs[j + 1];
+    }
+    return true;
+  }
+
+  InnerNode *inner = (InnerNode *)node;
+  int i = sonIndex(inner, k, h);
+  if (!remove(inner->sons[i], k, h))
+    return false;
+  Node *son = inner->sons[i];
+  int minKeys = son->leaf ? MIN_LEAF_KEYS : MIN_INNER_KEYS;
+  if (son->numKeys < minKeys)
+    fixSon(inner, i);
+  return true;
+}
+
+void BTreeSet::fixSon(InnerNode *node, int i) {
+  Node *son = node->sons[i];
+  Node *left = (i > 0) ? node->sons[i - 1] : 0;
+  Node *right = (i < node->numKeys) ? node->sons[i + 1] : 0;
+
+  if (son->leaf) {
+    LeafNode *s = (LeafNode *)son;
+    if (left != 0 && left->numKeys > MIN_LEAF_KEYS) {
+      // Take the last pair of the left brother
+      LeafNode *l = (LeafNode *)left;
+      for (int j = s->numKeys; j > 0; --j) {
+        s->hints[j] = s->hints[j - 1];
+        s->pairs[j] = s->pairs[j - 1];
+      }
+      --(l->numKeys);
+      s->hints[0] = l->hints[l->numKeys];
+      s->pairs[0] = l->pairs[l->numKeys];
+      ++(s->numKeys);
+      delete node->keys[i - 1];
+      node->keys[i - 1] = s->pairs[0].key->clone();
+      node->hints[i - 1] = s->hints[0];
+      return;
+    }
+    if (right != 0 && right->numKeys > MIN_LEAF_KEYS) {
+      // Take the first pair of the right brother
+      LeafNode *r = (LeafNode *)right;
+      s->hints[s->numKeys] = r->hints[0];
+      s->pairs[s->numKeys] = r->pairs[0];
+      ++(s->numKeys);
+      --(r->numKeys);
+      for (int j = 0; j < r->numKeys; ++j) {
+        r->hints[j] = r->hints[j + 1];
+        r->pairs[j] = r->pairs[j + 1];
+      }
+      delete node->keys[i];
+      node->keys[i] = r->pairs[0].key->clone();
+      node->hints[i] = r->hints[0];
+      return;
+    }
+  } else {
+    InnerNode *s = (InnerNode *)son;
+    if (left != 0 && left->numKeys > MIN_INNER_KEYS) {
+      // The separating key goes down, the last key of left goes up
+      InnerNode *l = (InnerNode *)left;
+      s->sons[s->numKeys + 1] = s->sons[s->numKeys];
+      for (int j = s->numKeys; j > 0; --j) {
+        s->keys[j] = s->keys[j - 1];
+        s->hints[j] = s->hints[j - 1];
+        s->sons[j] = s->sons[j - 1];
+      }
+      s->keys[0] = node->keys[i - 1];
+      s->hints[0] = node->hints[i - 1];
+      s->sons[0] = l->sons[l->numKeys];
+      ++(s->numKeys);
+      --(l->numKeys);
+      node->keys[i - 1] = l->keys[l->numKeys];
+      node->hints[i - 1] = l->hints[l->numKeys];
+      return;
+    }
+    if (right != 0 && right->numKeys > MIN_INNER_KEYS) {
+      // The separating key goes down, the first key of right goes up
+      InnerNode *r = (InnerNode *)right;
+      s->keys[s->numKeys] = node->keys[i];
+      s->hints[s->numKeys] = node->hints[i];
+      s->sons[s->numKeys + 1] = r->sons[0];
+      ++(s->numKeys);
+      node->keys[i] = r->keys[0];
+      node->hints[i] = r->hints[0];
+      --(r->numKeys);
+      for (int j = 0; j < r->numKeys; ++j) {
+        r->keys[j] = r->keys[j + 1];
+        r->hints[j] = r->hints[j + 1];
+        r->sons[j] = r->sons[j + 1];
+      }
+      r->sons[r->numKeys] = r->sons[r->numKeys + 1];
+      return;
+    }
+  }
+
+  // Merge the son with a brother: the sons j and j+1 are merged
+  int j = (left != 0) ? i - 1 : i;
+  Node *a = node->sons[j];
+  Node *b = node->sons[j + 1];
+  if (a->leaf) {
+    LeafNode *l = (LeafNode *)a;
+    LeafNode *r = (LeafNode *)b;
+    assert(l->numKeys + r->numKeys <= LEAF_KEYS);
+    for (int m = 0; m < r->numKeys; ++m) {
+      l->hints[l->numKeys + m] = r->hints[m];
+      l->pairs[l->numKeys + m] = r->pairs[m];
+    }
+    l->numKeys += r->numKeys;
+    l->next = r->next;
+    if (r->next != 0)
+      r->next->prev = l;
+    else
+      lastLeaf = l;
+    delete node->keys[j];
+    leafPool.release(r);
+  } else {
+    InnerNode *l = (InnerNode *)a;
+    InnerNode *r = (InnerNode *)b;
+    assert(l->numKeys + 1 + r->numKeys <= INNER_KEYS);
+    l->keys[l->numKeys] = node->keys[j]; // The separating key goes down
+    l->hints[l->numKeys] = node->hints[j];
+    ++(l->numKeys);
+    for (int m = 0; m < r->numKeys; ++m) {
+      l->keys[l->numKeys + m] = r->keys[m];
+      l->hints[l->numKeys + m] = r->hints[m];
+      l->sons[l->numKeys + m] = r->sons[m];
+    }
+    l->numKeys += r->numKeys;
+    l->sons[l->numKeys] = r->sons[r->numKeys];
+    innerPool.release(r);
+  }
+
+  // Exclude the key j and the son j+1 from the node
+  --(node->numKeys);
+  for (int m = j; m < node->numKeys; ++m) {
+    node->keys[m] = node->keys[m + 1];
+    node->hints[m] = node->hints[m + 1];
+    node->sons[m + 1] = node->sons[m + 2];
+  }
+}
+
+void BTreeSet::removeSubtree(Node *node) {
+  if (node->leaf) {
+    LeafNode *leaf = (LeafNode *)node;
+    for (int i = 0; i < leaf->numKeys; ++i) {
+      delete leaf->pairs[i].key;
+      delete leaf->pairs[i].value;
+    }
+  } else {
+    InnerNode *inner = (InnerNode *)node;
+    for (int i = 0; i < inner->numKeys; ++i)
+      delete inner->keys[i];
+    for (int i = 0; i <= inner->numKeys; ++i)
+      removeSubtree(inner->sons[i]);
+  }
+}
+
+void BTreeSet::clear() {
+  if (rootNode != 0)
+    removeSubtree(rootNode);
+  rootNode = 0;
+  firstLeaf = 0;
+  lastLeaf = 0;
+  numElements = 0;
+  leafPool.clear(); // All nodes are released at once
+  innerPool.clear();
+}
+
+BTreeSet::const_iterator &BTreeSet::const_iterator::operator++() {
+  if (leaf != 0) {
+    ++index;
+    if (index >= leaf->numKeys) {
+      leaf = leaf->next;
+      index = 0;
+    }
+  }
+  return *this;
+}
+
+BTreeSet::const_iterator &BTreeSet::const_iterator::operator--() {
+  if (leaf == 0) {
+    // From the end to the last pair
+    leaf = set->lastLeaf;
+    index = (leaf != 0) ? leaf->numKeys - 1 : 0;
+  } else if (index > 0) {
+    --index;
+  } else {
+    leaf = leaf->prev;
+    index = (leaf != 0) ? leaf->numKeys - 1 : 0;
+  }
+  return *this;
+}
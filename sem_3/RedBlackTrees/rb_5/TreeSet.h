@@ -30,6 +30,12 @@ public:
   // virtual Foo* clone() const { return new Foo(*this); }
   //
   virtual TreeSetKey *clone() const = 0;
+
+  // The hint of order can be compared without calling compareTo:
+  // if a.orderHint() < b.orderHint(), then a < b. The keys with
+  // equal hints are compared by compareTo. BTreeSet keeps the hints
+  // in its nodes. The default hint 0 gives no information.
+  virtual unsigned long long orderHint() const { return 0; }
 };
 
 // An ABSTRACT class representing a value of a key in TreeSet
@@ -45,7 +51,8 @@ public:
 // It stores the set of pairs: (key, value).
 // All keys are unique (different pairs have different keys).
 //
-// The implementation is based on the Red-Black Tree
+// The implementation is based on the Red-Black Tree.
+// Every pair is placed in the same pool object as its tree node.
 //
 class TreeSet : protected RBTree {
 public:
@@ -63,11 +70,39 @@ public:
     }
   };
 
+  TreeSet() : RBTree(sizeof(Pair)) {}
+  virtual ~TreeSet() { clear(); }
+
+  // Remove all pairs from the set
+  void clear() { RBTree::clear(); }
+
   // Add a pair (key, value) to the set
   void add(const TreeSetKey *k, const TreeSetValue *v = 0);
 
+  // Remove a key from the set in O(log n)
   void remove(const TreeSetKey *key);
 
+  // Remove all keys k such that lo <= k < hi, return the number of keys
+  // removed. It takes O(log n + k) time, see RBTree::eraseRange
+  int removeRange(const TreeSetKey *lo, const TreeSetKey *hi);
+
+  // Replace the contents of the set by the pairs (keys[i], values[i]),
+  // i = 0, 1, ..., n-1 (values may be 0). The keys may be unsorted:
+  // they are sorted by numThreads threads (0 means the number of
+  // processors), for equal keys the last pair is taken as in add().
+  // Then the balanced tree is built in O(n) without rotations.
+  void assign(const TreeSetKey *const *keys, const TreeSetValue *const *values,
+              int n, int numThreads = 0);
+
+  // Move all pairs of s into this set, s becomes empty. The pairs of s
+  // replace the pairs with equal keys. The trees are united by split
+  // and join in O(m log(n/m + 1)), where m is the size of smaller set.
+  // Return the number of replaced pairs.
+  int merge(TreeSet &s) { return RBTree::merge(s); }
+
+  // Add copies of all pairs of s (the union of sets)
+  void addAll(const TreeSet &s, int numThreads = 0);
+
   // Return a value of a key
   TreeSetValue *value(const TreeSetKey *k) const;
 
@@ -75,7 +110,7 @@ public:
 
   bool contains(const TreeSetKey *k) const;
 
-  int size() { return RBTree::size(); }
+  int size() const { return RBTree::size(); }
 
   class const_iterator : public RBTree::const_iterator {
   public:
@@ -103,6 +138,37 @@ public:
 
   iterator begin() { return RBTree::begin(); }
   iterator end() { return RBTree::end(); }
+
+  // The first pair with the key not less than k
+  const_iterator lowerBound(const TreeSetKey *k) const {
+    Pair key(k, 0);
+    return RBTree::const_iterator(this, RBTree::lowerBound(&key));
+  }
+  iterator lowerBound(const TreeSetKey *k) {
+    Pair key(k, 0);
+    return RBTree::iterator(this, RBTree::lowerBound(&key));
+  }
+
+  // Order statistics: after enableOrderStatistics() the set maintains
+  // the sizes of subtrees, then select and rank take O(log n) time
+  void enableOrderStatistics() { RBTree::enableOrderStatistics(); }
+
+  // The k-th pair in increasing order of keys, k = 0, 1, ..., size()-1
+  // (or end(), if k is out of range)
+  const_iterator select(int k) const {
+    return RBTree::const_iterator(this, RBTree::select(k));
+  }
+  iterator select(int k) { return RBTree::iterator(this, RBTree::select(k)); }
+
+  // The number of keys less than k
+  int rank(const TreeSetKey *k) const {
+    Pair key(k, 0);
+    return RBTree::rank(&key);
+  }
+
+protected:
+  // Delete the key and the value of the pair
+  virtual void eraseNode(RBTreeNode *node);
 };
 
 #endif
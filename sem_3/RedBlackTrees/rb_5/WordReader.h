@@ -0,0 +1,61 @@
+//
+// class WordReader: a fast tokenizer for the word-frequency programs.
+//
+// A regular file is mapped into memory with mmap; the standard input
+// (or anything that cannot be mapped) is read in big blocks.
+// Word boundaries are found 16 bytes at a time with SSE2 character-class
+// scans. A word is returned as a pointer into the buffer plus a length
+// (a "string view"): nothing is allocated or copied while reading,
+// so the caller should copy a word only when it stores it.
+//
+// A word is a maximal sequence of English letters [A-Za-z].
+//
+#ifndef WORD_READER_H
+#define WORD_READER_H
+
+#include <stdio.h>
+
+class WordReader {
+  int fd;             // File descriptor, (-1) if not opened
+  bool mapped;        // The file is mapped into memory
+  char *buffer;       // Mapped file or the block buffer
+  long long capacity; // Size of the block buffer
+  long long bufLen;   // Number of valid bytes in buffer
+  long long pos;      // Current scan position in buffer
+  bool endOfFile;     // No more data can be read into buffer
+  long long numBytes; // Total number of bytes scanned
+  double startTime;   // Time of opening (in seconds)
+
+public:
+  WordReader();
+  ~WordReader() { close(); }
+
+  // Open a file; if fileName == 0, then read the standard input.
+  // Return false if the file cannot be opened.
+  bool open(const char *fileName = 0);
+  void close();
+
+  // Get the next word.
+  // Out: word -- a pointer to the first letter (NOT null-terminated!),
+  //      len  -- the length of the word.
+  // The pointer stays valid until the next call of nextWord.
+  // Return value: false, if there are no more words.
+  bool nextWord(const char *&word, int &len);
+
+  long long bytesRead() const { return numBytes; }
+
+  // Time elapsed since open() in seconds
+  double elapsedTime() const;
+
+  // Print the amount of data scanned and the throughput in GB/s
+  void printStatistics(FILE *f = stderr) const;
+
+private:
+  bool fillBuffer(); // Read the next block (for non-mapped input)
+
+  // Find the first letter / non-letter in buffer starting from pos
+  long long skipNonLetters(long long i) const;
+  long long skipLetters(long long i) const;
+};
+
+#endif /* WORD_READER_H */
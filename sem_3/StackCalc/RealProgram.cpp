@@ -0,0 +1,242 @@
+// =====================================
+// One task on the StackCalc project
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+//
+// Program of the stack calculator, implementation
+//
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "RealProgram.h"
+
+static const struct {
+  const char *name;
+  int code;
+} commands[] = {
+    {"+", RealProgram::OP_ADD},
+    {"-", RealProgram::OP_SUB},
+    {"*", RealProgram::OP_MUL},
+    {"/", RealProgram::OP_DIV},
+    {"d", RealProgram::OP_NOD},
+    {"^", RealProgram::OP_POWER},
+    {"cos", RealProgram::OP_COS},
+    {"sin", RealProgram::OP_SIN},
+    {"tan", RealProgram::OP_TAN},
+    {"acos", RealProgram::OP_ACOS},
+    {"asin", RealProgram::OP_ASIN},
+    {"atan", RealProgram::OP_ATAN},
+    {"x", RealProgram::PUSH_INPUT},
+    {0, 0}};
+
+void RealProgram::add(int code, double value) {
+  if (len >= capacity) {
+    int newCapacity = (capacity > 0) ? 2 * capacity : 16;
+    Instruction *newProgram = new Instruction[newCapacity];
+    if (len > 0)
+      memmove(newProgram, program, len * sizeof(Instruction));
+    delete[] program;
+    program = newProgram;
+    capacity = newCapacity;
+  }
+  program[len].code = code;
+  program[len].value = value;
+  ++len;
+}
+
+void RealProgram::compile(const char *text) {
+  len = 0;
+  stackDepth = 0;
+  int depth = 0;
+  char word[256];
+  while (true) {
+    while (isspace((unsigned char)*text))
+      ++text;
+    if (*text == 0)
+      break;
+    int n = 0;
+    while (*text != 0 && !isspace((unsigned char)*text)) {
+      if (n < (int)sizeof(word) - 1)
+        word[n++] = *text;
+      ++text;
+    }
+    word[n] = 0;
+
+    const char *digits = word; // A number: [sign] [.] digit ...
+    if (*digits == '-' || *digits == '+')
+      ++digits;
+    if (*digits == '.')
+      ++digits;
+    if (isdigit((unsigned char)*digits)) {
+      add(PUSH_CONST, atof(word));
+      ++depth;
+    } else {
+      int k = 0;
+      while (commands[k].name != 0 && strcmp(commands[k].name, word) != 0)
+        ++k;
+      if (commands[k].name == 0)
+        throw StackException("Unknown command");
+      int code = commands[k].code;
+      // Operands popped and the result pushed
+      int operands = (code == PUSH_INPUT) ? 0 : (code < OP_COS) ? 2 : 1;
+      if (depth < operands)
+        throw StackException("Stack empty");
+      depth -= operands - 1;
+      add(code, 0.);
+    }
+    if (depth > stackDepth)
+      stackDepth = depth;
+  }
+  if (depth == 0)
+    throw StackException("Stack empty");
+}
+
+double RealProgram::apply(int code, double x, double y) {
+  switch (code) {
+  case OP_ADD:
+    return x + y;
+  case OP_SUB:
+    return x - y;
+  case OP_MUL:
+    return x * y;
+  case OP_DIV:
+    return x / y;
+  case OP_NOD: {
+    int a = (int)x;
+    int b = (int)y;
+    if (b > a) {
+      int tmp = a;
+      a = b;
+      b = tmp;
+    }
+    while (b) {
+      int r = a % b;
+      a = b;
+      b = r;
+    }
+    return a;
+  }
+  case OP_POWER: {
+    double result = 1;
+    int power = (int)y;
+    while (power) {
+      if (power % 2)
+        result *= x;
+      x *= x;
+      power /= 2;
+    }
+    return result;
+  }
+  case OP_COS:
+    return cos(x);
+  case OP_SIN:
+    return sin(x);
+  case OP_TAN:
+    return tan(x);
+  case OP_ACOS:
+    return acos(x);
+  case OP_ASIN:
+    return asin(x);
+  case OP_ATAN:
+    return atan(x);
+  }
+  return 0.;
+}
+
+double RealProgram::evaluate(double x, RealStack &stack) const {
+  stack.init();
+  stack.reserve(stackDepth);
+  for (int k = 0; k < len; ++k) {
+    const Instruction &ins = program[k];
+    if (ins.code == PUSH_CONST) {
+      stack.pushFast(ins.value);
+    } else if (ins.code == PUSH_INPUT) {
+      stack.pushFast(x);
+    } else if (ins.code >= OP_COS) {
+      stack.pushFast(apply(ins.code, stack.popFast(), 0.));
+    } else {
+      double y = stack.popFast();
+      double a = stack.popFast();
+      stack.pushFast(apply(ins.code, a, y));
+    }
+  }
+  return stack.topFast();
+}
+
+void RealProgram::evaluate(int n, const double *input, double *result) const {
+  int i = 0;
+#ifdef __SSE2__
+  // A value of stack is R registers of 2 lanes
+  const int R = BATCH / 2;
+  __m128d *lanes = new __m128d[stackDepth * R];
+  for (; i + BATCH <= n; i += BATCH) {
+    __m128d *top = lanes; // Next free value
+    for (int k = 0; k < len; ++k) {
+      const Instruction &ins = program[k];
+      switch (ins.code) {
+      case PUSH_CONST: {
+        __m128d c = _mm_set1_pd(ins.value);
+        for (int j = 0; j < R; ++j)
+          top[j] = c;
+        top += R;
+      } break;
+      case PUSH_INPUT:
+        for (int j = 0; j < R; ++j)
+          top[j] = _mm_loadu_pd(input + i + 2 * j);
+        top += R;
+        break;
+      case OP_ADD:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_add_pd(top[j - R], top[j]);
+        break;
+      case OP_SUB:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_sub_pd(top[j - R], top[j]);
+        break;
+      case OP_MUL:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_mul_pd(top[j - R], top[j]);
+        break;
+      case OP_DIV:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_div_pd(top[j - R], top[j]);
+        break;
+      default: {
+        // No SSE2 operation: the lanes one by one
+        double v[BATCH], y[BATCH];
+        bool binary = (ins.code < OP_COS);
+        if (binary) {
+          top -= R;
+          for (int j = 0; j < R; ++j)
+            _mm_storeu_pd(y + 2 * j, top[j]);
+        }
+        for (int j = 0; j < R; ++j)
+          _mm_storeu_pd(v + 2 * j, top[j - R]);
+        for (int j = 0; j < BATCH; ++j)
+          v[j] = apply(ins.code, v[j], binary ? y[j] : 0.);
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_loadu_pd(v + 2 * j);
+      } break;
+      }
+    }
+    for (int j = 0; j < R; ++j)
+      _mm_storeu_pd(result + i + 2 * j, top[j - R]);
+  }
+  delete[] lanes;
+#endif
+  // The rest of values (all values without SSE2)
+  RealStack stack(stackDepth);
+  for (; i < n; ++i)
+    result[i] = evaluate(input[i], stack);
+}
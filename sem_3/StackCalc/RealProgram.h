@@ -0,0 +1,84 @@
+// =====================================
+// One task on the StackCalc project
+// (C) rdmr, 2k6
+// Unautorized Duplication Appreciated!
+// =====================================
+
+//
+// Program of the stack calculator: the commands in reverse Polish
+// notation ("x 2 ^ 1 + cos"), x is the input value.
+//
+// A column of input values is evaluated in batches of BATCH values:
+// the stack has BATCH lanes (one lane per value). The arithmetic
+// (+ - * /) is applied to the whole batch by SSE2 operations, the other
+// commands (nod, ^, the trigonometric functions) lane by lane by apply.
+//
+#ifndef REAL_PROGRAM_H
+#define REAL_PROGRAM_H
+
+#include "RealStack.h"
+
+class RealProgram {
+public:
+  enum Code {
+    PUSH_CONST,
+    PUSH_INPUT,
+    // Binary operations
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NOD,   // Largest common divider
+    OP_POWER, // Integer power
+    // Unary operations
+    OP_COS,
+    OP_SIN,
+    OP_TAN,
+    OP_ACOS,
+    OP_ASIN,
+    OP_ATAN
+  };
+
+  enum { BATCH = 8 };
+
+private:
+  class Instruction {
+  public:
+    int code;
+    double value; // PUSH_CONST
+  };
+
+  Instruction *program;
+  int len;
+  int capacity;
+  int stackDepth; // The maximal depth of stack
+
+public:
+  RealProgram() : program(0), len(0), capacity(0), stackDepth(0) {}
+  ~RealProgram() { delete[] program; }
+
+  // Compile the commands separated by spaces.
+  // Throws StackException if a command is unknown or the stack
+  // has not enough values for a command.
+  void compile(const char *text);
+
+  int size() const { return len; }
+
+  // The value of program (the top of stack) for the input x
+  double evaluate(double x, RealStack &stack) const;
+
+  // result[i] is the value of program for input[i]
+  void evaluate(int n, const double *input, double *result) const;
+
+  // The value of operation (y is not used by unary ones); the interactive
+  // calculator uses it too
+  static double apply(int code, double x, double y);
+
+private:
+  RealProgram(const RealProgram &);            // Copying is prohibited
+  RealProgram &operator=(const RealProgram &); //
+
+  void add(int code, double value);
+};
+
+#endif
@@ -7,45 +7,47 @@
 //
 // Stack of real numbers, implementation
 //
+#include <string.h>
 #include "RealStack.h"
 
-RealStack::RealStack() : stack(0), max_size(STACK_MAXSIIZE), size(0) {
-  stack = new double[max_size];
+RealStack::RealStack()
+    : stack(0), capacity(STACK_INITIAL_SIZE), size(0) {
+  stack = new double[capacity];
 }
 
-RealStack::RealStack(int maxSize) : stack(0), max_size(maxSize), size(0) {
-  stack = new double[max_size];
+RealStack::RealStack(int initialSize)
+    : stack(0), capacity(initialSize > 0 ? initialSize : 1), size(0) {
+  stack = new double[capacity];
 }
 
-void RealStack::push(double x) throw(StackException) {
-  if (size >= max_size)
-    throw StackException("Stack overflow");
-  stack[size] = x;
-  size++;
+void RealStack::reserve(int n) {
+  if (n <= capacity)
+    return;
+  int newCapacity = 2 * capacity;
+  while (newCapacity < n)
+    newCapacity *= 2;
+  double *newStack = new double[newCapacity];
+  if (size > 0)
+    memmove(newStack, stack, size * sizeof(double));
+  delete[] stack;
+  stack = newStack;
+  capacity = newCapacity;
 }
 
-double RealStack::pop() throw(StackException) {
+double RealStack::pop() {
   if (size == 0)
     throw StackException("Stack empty");
-  double x = stack[size - 1];
-  size--;
-  return x;
+  return stack[--size];
 }
 
-double RealStack::top() const throw(StackException) {
+double RealStack::top() const {
   if (size == 0)
     throw StackException("Stack empty");
   return stack[size - 1];
 }
 
-int RealStack::depth() const { return size; }
-
-void RealStack::init() { size = 0; }
-
-bool RealStack::empty() const { return (size == 0); }
-
 double RealStack::elementAt(int i) const {
-  if (i >= size)
+  if (i < 0 || i >= size)
     throw StackException("Out of bounds");
   return stack[size - 1 - i];
 }
@@ -7,12 +7,15 @@
 //
 // Stack of real numbers
 //
+// The stack grows (its capacity is doubled), so push never fails.
+// pop, top and elementAt check the depth and throw StackException;
+// the unchecked variants (popFast, topFast) are for the code which
+// knows the depth, e.g. a program of RealProgram (after reserve).
+//
 #ifndef REAL_STACK_H
 #define REAL_STACK_H
 
-#pragma warning(disable : 4290)
-
-const int STACK_MAXSIIZE = 1024;
+const int STACK_INITIAL_SIZE = 1024;
 
 class StackException {
 public:
@@ -24,19 +27,38 @@ public:
 class RealStack {
 private:
   double *stack;
-  int max_size;
+  int capacity;
   int size;
 
 public:
   RealStack();
-  RealStack(int maxSize);
-  void push(double) throw(StackException);
-  double pop() throw(StackException);
-  double top() const throw(StackException);
-  int depth() const;
-  void init();
-  bool empty() const;
+  RealStack(int initialSize);
+  ~RealStack() { delete[] stack; }
+
+  void push(double x) {
+    if (size >= capacity)
+      reserve(size + 1);
+    stack[size++] = x;
+  }
+  double pop();
+  double top() const;
+  int depth() const { return size; }
+  void init() { size = 0; }
+  bool empty() const { return (size == 0); }
   double elementAt(int i) const;
+
+  // Make room for n elements
+  void reserve(int n);
+
+  // Unchecked operations: the stack must have room (pushFast)
+  // or an element (popFast, topFast)
+  void pushFast(double x) { stack[size++] = x; }
+  double popFast() { return stack[--size]; }
+  double topFast() const { return stack[size - 1]; }
+
+private:
+  RealStack(const RealStack &);            // Copying is prohibited
+  RealStack &operator=(const RealStack &); //
 };
 
 #endif
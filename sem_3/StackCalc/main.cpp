@@ -14,6 +14,7 @@
 #include <string.h>
 #include <math.h>
 #include "RealStack.h"
+#include "RealProgram.h"
 
 static void onAdd();
 static void onSub();
@@ -33,10 +34,21 @@ static void onInit();
 static void display();
 static void printHelp();
 static void onShow();
+static int runProgram(const char *text, const char *fileName);
 
 static RealStack *Stack = 0;
 
-int main() {
+int main(int argc, char *argv[]) {
+  if (argc > 2 && strcmp(argv[1], "-b") == 0)
+    return runProgram(argv[2], (argc > 3) ? argv[3] : 0);
+  if (argc > 1) {
+    printf("Usage: %s [-b program [file]]\n"
+           "\t-b\tEvaluate the program (commands separated by spaces,\n"
+           "\t\tx is the input value) for the values of file or of\n"
+           "\t\tthe standard input\n",
+           argv[0]);
+    return 1;
+  }
   printHelp();
   char line[256];
   Stack = new RealStack();
@@ -119,23 +131,16 @@ static void onDiv() {
   display();
 }
 
-static void onNod() {
-  int y = (int)Stack->pop();
-  int x = (int)Stack->pop();
-  if (y > x) {
-    int tmp = x;
-    x = y;
-    y = tmp;
-  }
-  while (y) {
-    int r = x % y;
-    x = y;
-    y = r;
-  }
-  Stack->push(x);
+// A binary operation of RealProgram on the two values of top
+static void onBinary(int code) {
+  double y = Stack->pop();
+  double x = Stack->pop();
+  Stack->push(RealProgram::apply(code, x, y));
   display();
 }
 
+static void onNod() { onBinary(RealProgram::OP_NOD); }
+
 static void onCos() {
   double x = Stack->pop();
   Stack->push(cos(x));
@@ -167,19 +172,7 @@ static void onATan() {
   display();
 }
 
-static void onPower() {
-  double Result = 1;
-  int Power = (int)Stack->pop();
-  double Base = Stack->pop();
-  while (Power) {
-    if (Power % 2)
-      Result *= Base;
-    Base *= Base;
-    Power /= 2;
-  }
-  Stack->push(Result);
-  display();
-}
+static void onPower() { onBinary(RealProgram::OP_POWER); }
 
 static void onPush(const char *line) {
   double x = atof(line);
@@ -204,6 +197,46 @@ static void onShow() {
     printf("\t%lf\n", Stack->elementAt(i));
 }
 
+// Batch mode: the values of program for a column of input values
+static int runProgram(const char *text, const char *fileName) {
+  RealProgram program;
+  try {
+    program.compile(text);
+  } catch (StackException &e) {
+    fprintf(stderr, "Stack Exception: %s\n", e.reason);
+    return 1;
+  }
+  FILE *f = (fileName != 0) ? fopen(fileName, "r") : stdin;
+  if (f == 0) {
+    perror(fileName);
+    return 1;
+  }
+  int n = 0;
+  int capacity = 1024;
+  double *input = new double[capacity];
+  double x;
+  while (fscanf(f, "%lf", &x) == 1) {
+    if (n >= capacity) {
+      double *newInput = new double[2 * capacity];
+      memmove(newInput, input, n * sizeof(double));
+      delete[] input;
+      input = newInput;
+      capacity *= 2;
+    }
+    input[n++] = x;
+  }
+  if (f != stdin)
+    fclose(f);
+
+  double *result = new double[n];
+  program.evaluate(n, input, result);
+  for (int i = 0; i < n; ++i)
+    printf("%.17lg\n", result[i]);
+  delete[] result;
+  delete[] input;
+  return 0;
+}
+
 static void printHelp() {
   printf(
       "Stack Calculator commands:\n\t<number>\tPush to stack\n"
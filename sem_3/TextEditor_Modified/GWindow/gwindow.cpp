@@ -42,6 +42,13 @@ void GWindow::messageLoop(GWindow *dialogWnd /* = 0 */) {
          (dialogWnd == 0 || dialogWnd->m_Window != 0)) {
     //... XNextEvent(m_Display, &event);
     if (!getNextEvent(event)) {
+      ListHeader *p = m_WindowList.next;
+      for (int i = 0; i < m_NumWindows && p != &m_WindowList; ++i) {
+        ListHeader *next = p->next;
+        ((GWindow *)p)->onIdle();
+        p = next;
+      }
+
       // Sleep a bit
       timeval dt;
       dt.tv_sec = 0;
@@ -860,6 +867,8 @@ void GWindow::onFocusIn(XEvent &) {}
 
 void GWindow::onFocusOut(XEvent &) {}
 
+void GWindow::onIdle() {}
+
 void GWindow::recalculateMap() {
   if (m_IWinRect.width() == 0)
     m_IWinRect.setWidth(1);
@@ -131,6 +131,9 @@ private:
   static GWindow *findWindow(Window w);
 
 public:
+  // The rectangle that is exposed (drawing is clipped by it in onExpose)
+  const XRectangle &clipRectangle() const { return m_ClipRectangle; }
+
   void drawFrame();
   void setCoordinates(double xmin, double ymin, double xmax, double ymax);
   void setCoordinates(const R2Rectangle &coordRect);
@@ -241,6 +244,10 @@ public:
   // "true" to close the window or "false" to leave the window open.
   virtual bool onWindowClosing();
 
+  // It is called by the message loop when there are no events
+  // (a window may show the results of a background work)
+  virtual void onIdle();
+
   // Message loop
   static bool getNextEvent(XEvent &e);
   static void dispatchEvent(XEvent &e);
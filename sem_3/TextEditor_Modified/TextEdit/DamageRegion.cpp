@@ -0,0 +1,75 @@
+// class DamageRegion, implementation
+#include <limits.h>
+#include "DamageRegion.h"
+
+void DamageRegion::Rect::unite(const Rect &r) {
+  if (r.x0 < x0)
+    x0 = r.x0;
+  if (r.y0 < y0)
+    y0 = r.y0;
+  if (r.x1 > x1)
+    x1 = r.x1;
+  if (r.y1 > y1)
+    y1 = r.y1;
+}
+
+void DamageRegion::add(const Rect &rect) {
+  if (rect.isEmpty())
+    return;
+  Rect r = rect;
+  // Unite the rectangle with all the rectangles touching it.
+  // The union may touch other rectangles, so repeat until none is left.
+  bool united = true;
+  while (united) {
+    united = false;
+    for (int i = 0; i < numRects; ++i) {
+      if (rects[i].touches(r)) {
+        r.unite(rects[i]);
+        rects[i] = rects[--numRects];
+        united = true;
+        break;
+      }
+    }
+  }
+  if (numRects == MAX_RECTS) {
+    // Too many rectangles: unite all of them
+    for (int i = 1; i < numRects; ++i)
+      rects[0].unite(rects[i]);
+    numRects = 1;
+    rects[0].unite(r);
+    return;
+  }
+  rects[numRects++] = r;
+}
+
+// The new number of the line b, when n lines are inserted
+// or removed before the line y
+static int moveFirst(int b, int y, int n) {
+  if (b < y)
+    return b;
+  if (n < 0 && b < y - n)
+    return y; // The line is removed, the next one takes its place
+  return b + n;
+}
+
+// The same for the exclusive bound: b is the line after the last one
+static int moveBound(int b, int y, int n) {
+  if (b == INT_MAX || b <= y)
+    return b;
+  if (n < 0 && b < y - n)
+    return y; // The last line is removed
+  return b + n;
+}
+
+void DamageRegion::moveLines(int y, int n) {
+  int i = 0;
+  while (i < numRects) {
+    Rect &r = rects[i];
+    r.y0 = moveFirst(r.y0, y, n);
+    r.y1 = moveBound(r.y1, y, n);
+    if (r.isEmpty())
+      rects[i] = rects[--numRects];
+    else
+      ++i;
+  }
+}
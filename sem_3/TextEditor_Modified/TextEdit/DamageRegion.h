@@ -0,0 +1,57 @@
+//
+// The region of text that must be redrawn ("damaged").
+//
+// The editor commands add the rectangles they change, the region
+// coalesces them, and the editor redraws it once after a command
+// (or after a series of key presses that came together).
+// The rectangles are in text coordinates: x is a column, y is a line;
+// the bounds are exclusive and may be INT_MAX ("to the end").
+//
+#ifndef DAMAGE_REGION_H
+#define DAMAGE_REGION_H
+
+class DamageRegion {
+public:
+  enum { MAX_RECTS = 16 };
+
+  class Rect {
+  public:
+    int x0, y0; // The first column and line
+    int x1, y1; // The column and line after the last ones
+
+    Rect() : x0(0), y0(0), x1(0), y1(0) {}
+    Rect(int l, int t, int r, int b) : x0(l), y0(t), x1(r), y1(b) {}
+
+    bool isEmpty() const { return (x1 <= x0 || y1 <= y0); }
+
+    // The rectangles intersect or touch each other
+    bool touches(const Rect &r) const {
+      return (x0 <= r.x1 && r.x0 <= x1 && y0 <= r.y1 && r.y0 <= y1);
+    }
+
+    void unite(const Rect &r);
+  };
+
+private:
+  Rect rects[MAX_RECTS];
+  int numRects;
+
+public:
+  DamageRegion() : numRects(0) {}
+
+  void clear() { numRects = 0; }
+  bool isEmpty() const { return (numRects == 0); }
+
+  int size() const { return numRects; }
+  const Rect &operator[](int i) const { return rects[i]; }
+
+  // Add a rectangle; the rectangles touching it are united with it
+  void add(const Rect &r);
+  void add(int x0, int y0, int x1, int y1) { add(Rect(x0, y0, x1, y1)); }
+
+  // Lines were inserted (n > 0) or removed (n < 0) before the line y:
+  // move the damaged lines with the text
+  void moveLines(int y, int n);
+};
+
+#endif /* DAMAGE_REGION_H */
@@ -0,0 +1,533 @@
+// class EditJournal, implementation
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "EditJournal.h"
+
+// The log file: a header, then the records of operations.
+// Header: "TEJ1", size and modification time of the base file
+// (8 bytes each). Record: type (1 byte), y, x, removedLen, insertedLen,
+// checksum (4 bytes each), then the removed and inserted characters.
+// A record torn by a crash is detected by its length or checksum.
+static const char LOG_MAGIC[4] = {'T', 'E', 'J', '1'};
+static const int HEADER_SIZE = 4 + 2 * 8;
+static const int RECORD_SIZE = 1 + 5 * 4;
+static const int MAX_WRITE_BUFFER = 4096;
+static const double SYNC_INTERVAL = 1.; // Seconds between fdatasync's
+
+static double currentTime() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+
+// FNV-1a hash
+static unsigned int checksum(unsigned int h, const char *p, int n) {
+  for (int i = 0; i < n; ++i) {
+    h ^= (unsigned char)p[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static const unsigned int CHECKSUM_INIT = 2166136261U;
+
+static bool writeAll(int fd, const char *p, long long n) {
+  while (n > 0) {
+    ssize_t k = write(fd, p, n);
+    if (k < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+// memmove of n >= 0 characters (the source may be 0 for n == 0)
+static void copyChars(char *dst, const char *src, int n) {
+  if (n > 0)
+    memmove(dst, src, n);
+}
+
+static void putInt(char *p, int v) { memcpy(p, &v, 4); }
+
+static int getInt(const char *p) {
+  int v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+EditJournal::EditJournal()
+    : ops(0), numOps(0), numDone(0), opsCapacity(0), pool(0), poolLen(0),
+      poolCapacity(0), newGroup(true), mergeAllowed(false), logPath(""),
+      logFd(-1), baseSize(-1), baseTime(0), lastSync(0.) {}
+
+EditJournal::~EditJournal() {
+  if (logFd >= 0)
+    ::close(logFd); // The log is kept: the text was not saved
+  delete[] ops;
+  delete[] pool;
+}
+
+void EditJournal::clear() {
+  numOps = 0;
+  numDone = 0;
+  poolLen = 0;
+  newGroup = true;
+  mergeAllowed = false;
+}
+
+void EditJournal::reservePool(int n) {
+  if (poolLen + n <= poolCapacity)
+    return;
+  int newCapacity = (poolCapacity > 0) ? 2 * poolCapacity : 1024;
+  while (newCapacity < poolLen + n)
+    newCapacity *= 2;
+  char *newPool = new char[newCapacity];
+  copyChars(newPool, pool, poolLen);
+  delete[] pool;
+  pool = newPool;
+  poolCapacity = newCapacity;
+}
+
+void EditJournal::record(int type, int y, int x, const char *removed,
+                         int removedLen, const char *inserted,
+                         int insertedLen) {
+  addOp(type, y, x, removed, removedLen, inserted, insertedLen);
+  writeLog(type, y, x, removed, removedLen, inserted, insertedLen);
+}
+
+bool EditJournal::canMerge(int type, int y, int x, int removedLen,
+                           int insertedLen) const {
+  if (!mergeAllowed || type != REPLACE || numOps == 0 || numOps > numDone)
+    return false;
+  // The last operation is a single operation of its command
+  // (so merging does not join different commands)
+  const Op &last = ops[numOps - 1];
+  if (last.type != REPLACE || !last.groupStart || last.y != y)
+    return false;
+  if (removedLen == 0 && last.insertedLen > 0)
+    return (x == last.x + last.insertedLen); // Typed after the previous
+  if (insertedLen == 0 && last.insertedLen == 0)
+    return (x == last.x || x + removedLen == last.x); // Delete, BackSpace
+  return false;
+}
+
+void EditJournal::addOp(int type, int y, int x, const char *removed,
+                        int removedLen, const char *inserted,
+                        int insertedLen) {
+  if (numOps > numDone) {
+    // The undone operations cannot be redone any more
+    numOps = numDone;
+    poolLen = 0;
+    if (numDone > 0) {
+      const Op &last = ops[numDone - 1];
+      poolLen = last.textOffset + last.removedLen + last.insertedLen;
+    }
+    mergeAllowed = false;
+  }
+
+  if (canMerge(type, y, x, removedLen, insertedLen)) {
+    // The characters of the last operation are at the end of pool
+    Op &last = ops[numOps - 1];
+    if (removedLen == 0) {
+      // A character typed after the previous ones
+      reservePool(insertedLen);
+      copyChars(pool + poolLen, inserted, insertedLen);
+      poolLen += insertedLen;
+      last.insertedLen += insertedLen;
+    } else {
+      reservePool(removedLen);
+      char *t = pool + last.textOffset;
+      if (x == last.x) {
+        // Delete: the next characters are removed
+        copyChars(t + last.removedLen, removed, removedLen);
+      } else {
+        // BackSpace: the previous characters are removed
+        copyChars(t + removedLen, t, last.removedLen);
+        copyChars(t, removed, removedLen);
+        last.x = x;
+      }
+      poolLen += removedLen;
+      last.removedLen += removedLen;
+    }
+    newGroup = false;
+    return;
+  }
+
+  if (numOps >= opsCapacity) {
+    int newCapacity = (opsCapacity > 0) ? 2 * opsCapacity : 256;
+    Op *newOps = new Op[newCapacity];
+    if (numOps > 0)
+      memmove(newOps, ops, numOps * sizeof(Op));
+    delete[] ops;
+    ops = newOps;
+    opsCapacity = newCapacity;
+  }
+  reservePool(removedLen + insertedLen);
+  Op &op = ops[numOps];
+  op.type = (unsigned char)type;
+  op.groupStart = newGroup;
+  op.y = y;
+  op.x = x;
+  op.textOffset = poolLen;
+  op.removedLen = removedLen;
+  op.insertedLen = insertedLen;
+  copyChars(pool + poolLen, removed, removedLen);
+  poolLen += removedLen;
+  copyChars(pool + poolLen, inserted, insertedLen);
+  poolLen += insertedLen;
+  ++numOps;
+  numDone = numOps;
+  newGroup = false;
+  mergeAllowed = (type == REPLACE);
+}
+
+void EditJournal::recordLineChange(int y, const char *oldLine, int oldLen,
+                                   const char *newLine, int newLen,
+                                   int cursorX) {
+  int p = 0; // Common prefix
+  while (p < oldLen && p < newLen && oldLine[p] == newLine[p])
+    ++p;
+  if (p == oldLen && p == newLen)
+    return; // No change
+  int s = 0; // Common suffix (it may overlap the prefix)
+  while (s < oldLen && s < newLen &&
+         oldLine[oldLen - 1 - s] == newLine[newLen - 1 - s])
+    ++s;
+  int minLen = (oldLen < newLen) ? oldLen : newLen;
+  if (p + s >= minLen) {
+    // Characters are only inserted or only removed, at any place x in
+    // [minLen - s, p] (e.g. "a" typed after "a"). The place is the
+    // cursor, or the one that continues the last operation, so that
+    // a typed run stays one operation; otherwise the end of the prefix.
+    int removedLen = oldLen - minLen;
+    int insertedLen = newLen - minLen;
+    int x = p;
+    if (cursorX >= minLen - s && cursorX <= p) {
+      x = cursorX;
+    } else if (numOps > 0) {
+      const Op &last = ops[numOps - 1];
+      int candidates[3] = {last.x + last.insertedLen, last.x,
+                           last.x - removedLen};
+      for (int i = 0; i < 3; ++i) {
+        int c = candidates[i];
+        if (c >= minLen - s && c <= p &&
+            canMerge(REPLACE, y, c, removedLen, insertedLen)) {
+          x = c;
+          break;
+        }
+      }
+    }
+    recordReplace(y, x, oldLine + x, removedLen, newLine + x, insertedLen);
+    return;
+  }
+  if (s > minLen - p)
+    s = minLen - p;
+  recordReplace(y, p, oldLine + p, oldLen - p - s, newLine + p,
+                newLen - p - s);
+}
+
+int EditJournal::inverseType(int type) {
+  switch (type) {
+  case SPLIT_LINE:
+    return JOIN_LINES;
+  case JOIN_LINES:
+    return SPLIT_LINE;
+  case INSERT_LINE:
+    return DELETE_LINE;
+  case DELETE_LINE:
+    return INSERT_LINE;
+  default:
+    return type;
+  }
+}
+
+bool EditJournal::apply(Text &text, int type, int y, int x,
+                        const char *removed, int removedLen,
+                        const char *inserted, int insertedLen) {
+  int n = text.size();
+  if (y < 0 || y > n || x < 0 || removedLen < 0 || insertedLen < 0)
+    return false;
+  if (y == n && type != INSERT_LINE)
+    return false;
+
+  switch (type) {
+  case REPLACE: {
+    TextLine &line = text.getLine(y);
+    const char *s = (line.length() > 0) ? line.getString() : "";
+    if (x + removedLen > line.length() ||
+        (removedLen > 0 && memcmp(s + x, removed, removedLen) != 0))
+      return false;
+    TextLine changed;
+    changed.ensureCapacity(line.length() - removedLen + insertedLen + 1);
+    changed.setString(s, x);
+    for (int i = 0; i < insertedLen; ++i)
+      changed.append(inserted[i]);
+    changed.append(s + x + removedLen);
+    line = changed;
+    break;
+  }
+  case SPLIT_LINE: {
+    TextLine &line = text.getLine(y);
+    if (x > line.length())
+      return false;
+    TextLine *tail = new TextLine();
+    if (x < line.length())
+      tail->setString(line.getString() + x);
+    line.truncate(x);
+    text.setPointer(y + 1);
+    text.addAfter(tail);
+    break;
+  }
+  case JOIN_LINES: {
+    if (y + 1 >= n || text.getLine(y).length() != x)
+      return false;
+    TextLine &next = text.getLine(y + 1);
+    if (next.length() > 0)
+      text.getLine(y).append(next.getString());
+    text.setPointer(y + 1);
+    text.removeAfter();
+    break;
+  }
+  case INSERT_LINE: {
+    TextLine *line = new TextLine();
+    if (insertedLen > 0)
+      line->setString(inserted, insertedLen);
+    text.setPointer(y);
+    text.addAfter(line);
+    break;
+  }
+  case DELETE_LINE: {
+    TextLine &line = text.getLine(y);
+    if (line.length() != removedLen ||
+        (removedLen > 0 &&
+         memcmp(line.getString(), removed, removedLen) != 0))
+      return false;
+    text.setPointer(y);
+    text.removeAfter();
+    break;
+  }
+  default:
+    return false;
+  }
+  return true;
+}
+
+bool EditJournal::undo(Text &text, int &cursorX, int &cursorY) {
+  if (numDone == 0)
+    return false;
+  do {
+    const Op &op = ops[--numDone];
+    int type = inverseType(op.type);
+    apply(text, type, op.y, op.x, insertedText(op), op.insertedLen,
+          removedText(op), op.removedLen);
+    writeLog(type, op.y, op.x, insertedText(op), op.insertedLen,
+             removedText(op), op.removedLen);
+    cursorX = op.x;
+    cursorY = op.y;
+  } while (!ops[numDone].groupStart);
+  newGroup = true;
+  mergeAllowed = false;
+  return true;
+}
+
+bool EditJournal::redo(Text &text, int &cursorX, int &cursorY) {
+  if (numDone == numOps)
+    return false;
+  do {
+    const Op &op = ops[numDone++];
+    apply(text, op.type, op.y, op.x, removedText(op), op.removedLen,
+          insertedText(op), op.insertedLen);
+    writeLog(op.type, op.y, op.x, removedText(op), op.removedLen,
+             insertedText(op), op.insertedLen);
+    cursorX = (op.type == REPLACE) ? op.x + op.insertedLen : op.x;
+    cursorY = (op.type == SPLIT_LINE) ? op.y + 1 : op.y;
+    if (op.type == SPLIT_LINE)
+      cursorX = 0;
+  } while (numDone < numOps && !ops[numDone].groupStart);
+  newGroup = true;
+  mergeAllowed = false;
+  return true;
+}
+
+void EditJournal::openLog(const char *path, long long size, long long time) {
+  if (logFd >= 0)
+    ::close(logFd);
+  logFd = (-1);
+  logPath = path;
+  baseSize = size;
+  baseTime = time;
+}
+
+bool EditJournal::createLog() {
+  logFd = ::open(logPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+  if (logFd < 0)
+    return false;
+  char header[HEADER_SIZE];
+  memcpy(header, LOG_MAGIC, 4);
+  memcpy(header + 4, &baseSize, 8);
+  memcpy(header + 12, &baseTime, 8);
+  if (!writeAll(logFd, header, HEADER_SIZE)) {
+    ::close(logFd);
+    logFd = (-1);
+    return false;
+  }
+  lastSync = 0.;
+  return true;
+}
+
+void EditJournal::writeLog(int type, int y, int x, const char *removed,
+                           int removedLen, const char *inserted,
+                           int insertedLen) {
+  if (logPath.length() == 0)
+    return; // No log
+  if (logFd < 0 && !createLog()) {
+    perror("Cannot create the journal file");
+    logPath = ""; // Do not try again
+    return;
+  }
+
+  char head[RECORD_SIZE];
+  head[0] = (char)type;
+  putInt(head + 1, y);
+  putInt(head + 5, x);
+  putInt(head + 9, removedLen);
+  putInt(head + 13, insertedLen);
+  unsigned int h = checksum(CHECKSUM_INIT, head, 17);
+  h = checksum(h, removed, removedLen);
+  h = checksum(h, inserted, insertedLen);
+  putInt(head + 17, (int)h);
+
+  // A small record is written by one system call
+  bool success;
+  int len = RECORD_SIZE + removedLen + insertedLen;
+  if (len <= MAX_WRITE_BUFFER) {
+    char buffer[MAX_WRITE_BUFFER];
+    memcpy(buffer, head, RECORD_SIZE);
+    copyChars(buffer + RECORD_SIZE, removed, removedLen);
+    copyChars(buffer + RECORD_SIZE + removedLen, inserted, insertedLen);
+    success = writeAll(logFd, buffer, len);
+  } else {
+    success = writeAll(logFd, head, RECORD_SIZE) &&
+              writeAll(logFd, removed, removedLen) &&
+              writeAll(logFd, inserted, insertedLen);
+  }
+  if (!success) {
+    perror("Cannot write the journal file");
+    ::close(logFd);
+    logFd = (-1);
+    logPath = "";
+    return;
+  }
+
+  // The record is in the file system cache, so it survives a crash
+  // of the editor at once; against a crash of the system it is
+  // flushed to the disk at most once per SYNC_INTERVAL
+  double t = currentTime();
+  if (t - lastSync >= SYNC_INTERVAL) {
+    fdatasync(logFd);
+    lastSync = t;
+  }
+}
+
+int EditJournal::recover(Text &text) {
+  if (logPath.length() == 0)
+    return 0;
+  int fd = ::open(logPath, O_RDWR | O_APPEND);
+  if (fd < 0)
+    return 0;
+
+  char *data = 0;
+  long long len = 0;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= HEADER_SIZE) {
+    data = new char[st.st_size];
+    while (len < st.st_size) {
+      ssize_t k = pread(fd, data + len, st.st_size - len, len);
+      if (k < 0 && errno == EINTR)
+        continue;
+      if (k <= 0)
+        break;
+      len += k;
+    }
+  }
+
+  long long pos = 0;
+  int numReplayed = 0;
+  long long size = 0, time = 0;
+  if (len >= HEADER_SIZE) {
+    memcpy(&size, data + 4, 8);
+    memcpy(&time, data + 12, 8);
+  }
+  if (len >= HEADER_SIZE && memcmp(data, LOG_MAGIC, 4) == 0 &&
+      size == baseSize && time == baseTime) {
+    text.waitLoaded();
+    pos = HEADER_SIZE;
+    while (pos + RECORD_SIZE <= len) {
+      const char *head = data + pos;
+      int type = (unsigned char)head[0];
+      int y = getInt(head + 1);
+      int x = getInt(head + 5);
+      int removedLen = getInt(head + 9);
+      int insertedLen = getInt(head + 13);
+      if (removedLen < 0 || insertedLen < 0 ||
+          pos + RECORD_SIZE + removedLen + insertedLen > len)
+        break;
+      const char *removed = head + RECORD_SIZE;
+      const char *inserted = removed + removedLen;
+      unsigned int h = checksum(CHECKSUM_INIT, head, 17);
+      h = checksum(h, removed, removedLen);
+      h = checksum(h, inserted, insertedLen);
+      if ((int)h != getInt(head + 17) ||
+          !apply(text, type, y, x, removed, removedLen, inserted,
+                 insertedLen))
+        break;
+      beginCommand();
+      addOp(type, y, x, removed, removedLen, inserted, insertedLen);
+      pos += RECORD_SIZE + removedLen + insertedLen;
+      ++numReplayed;
+    }
+  }
+  delete[] data;
+
+  if (pos == 0) {
+    // A log of another version of file: it is replaced
+    // by the log of this one
+    ::close(fd);
+    return 0;
+  }
+  if (pos < len)
+    ftruncate(fd, pos); // Cut off a torn record
+  if (logFd >= 0)
+    ::close(logFd);
+  logFd = fd;
+  newGroup = true;
+  mergeAllowed = false;
+  return numReplayed;
+}
+
+void EditJournal::resetLog(long long size, long long time) {
+  if (logPath.length() == 0)
+    return;
+  TextLine path = logPath;
+  removeLog();
+  openLog(path, size, time);
+}
+
+void EditJournal::removeLog() {
+  if (logFd >= 0)
+    ::close(logFd);
+  logFd = (-1);
+  if (logPath.length() > 0)
+    unlink(logPath);
+  logPath = "";
+}
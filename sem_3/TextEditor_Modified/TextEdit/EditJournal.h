@@ -0,0 +1,161 @@
+//
+// Journal of editing operations: undo/redo and autosave.
+//
+// A change made by an editor command is recorded as a few compact
+// operations on lines:
+//   REPLACE(y, x, removed, inserted) -- the characters "removed" at
+//       the column x of line y are replaced by "inserted";
+//   SPLIT_LINE(y, x) -- the line y is split at the column x,
+//       JOIN_LINES(y, x) is the inverse operation;
+//   INSERT_LINE(y, s), DELETE_LINE(y, s) -- the line s is inserted
+//       at the place y / the line y (equal to s) is deleted.
+// An operation is a small fixed record, its characters are kept in
+// a common pool, so appending an operation takes O(1) amortized time.
+// The operations of one command form a group that is undone and redone
+// at once. A character typed next to the previous one (or deleted next
+// to the previous deletion) is merged into the last operation, so
+// a typed run is undone in one step.
+//
+// The operations are also appended to a side file as they are done
+// (a redo log of the base file saved last). After a crash the text is
+// recovered by replaying the log over the base file, so an autosave
+// writes a few bytes per command instead of the whole document.
+//
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include "Text.h"
+
+class EditJournal {
+public:
+  enum OpType {
+    REPLACE = 0,
+    SPLIT_LINE,
+    JOIN_LINES,
+    INSERT_LINE,
+    DELETE_LINE
+  };
+
+private:
+  class Op {
+  public:
+    unsigned char type;
+    bool groupStart; // The first operation of a command
+    int y;
+    int x;
+    int textOffset; // The characters in pool: removed, then inserted
+    int removedLen;
+    int insertedLen;
+  };
+
+  Op *ops;         // The operations ops[0..numDone-1] are done,
+  int numOps;      //   ops[numDone..numOps-1] are undone
+  int numDone;     //   (they are dropped by the next new operation)
+  int opsCapacity; //
+
+  char *pool; // Characters of operations
+  int poolLen;
+  int poolCapacity;
+
+  bool newGroup;     // The next operation starts a group
+  bool mergeAllowed; // The next operation may be merged into the last one
+
+  // The log file: the operations done after the base file
+  // (of size baseSize and modification time baseTime) was saved.
+  // It is created by the first operation.
+  TextLine logPath;
+  int logFd;
+  long long baseSize;
+  long long baseTime;
+  double lastSync; // Time of the last fdatasync
+
+public:
+  EditJournal();
+  ~EditJournal();
+
+  // Forget all operations
+  void clear();
+
+  // A new command is started: its operations form a new group
+  void beginCommand() { newGroup = true; }
+
+  // Record an operation that is done with the text
+  void recordReplace(int y, int x, const char *removed, int removedLen,
+                     const char *inserted, int insertedLen) {
+    record(REPLACE, y, x, removed, removedLen, inserted, insertedLen);
+  }
+  void recordSplitLine(int y, int x) { record(SPLIT_LINE, y, x, 0, 0, 0, 0); }
+  void recordInsertLine(int y, const char *s, int len) {
+    record(INSERT_LINE, y, 0, 0, 0, s, len);
+  }
+  void recordDeleteLine(int y, const char *s, int len) {
+    record(DELETE_LINE, y, 0, s, len, 0, 0);
+  }
+
+  // The line y was changed from oldLine to newLine:
+  // only the part that differs is recorded. cursorX is the column where
+  // the characters were typed or removed (-1 if it is unknown)
+  void recordLineChange(int y, const char *oldLine, int oldLen,
+                        const char *newLine, int newLen, int cursorX = -1);
+
+  bool canUndo() const { return (numDone > 0); }
+  bool canRedo() const { return (numDone < numOps); }
+
+  // Undo/redo the last group of operations.
+  // Out: the cursor position at the change. Return false if nothing to do.
+  bool undo(Text &text, int &cursorX, int &cursorY);
+  bool redo(Text &text, int &cursorX, int &cursorY);
+
+  // Set the path of log file and the base file identity
+  // (size is -1 if the base file does not exist)
+  void openLog(const char *path, long long size, long long time);
+
+  // Replay the log file that exists for the base file over the text
+  // loaded from it; the log is continued by next operations.
+  // Return the number of operations replayed.
+  int recover(Text &text);
+
+  // The text is saved: the log starts anew for the new base file
+  void resetLog(long long size, long long time);
+
+  // Close the log and remove its file
+  void removeLog();
+
+private:
+  EditJournal(const EditJournal &);            // Copying is prohibited
+  EditJournal &operator=(const EditJournal &); //
+
+  void record(int type, int y, int x, const char *removed, int removedLen,
+              const char *inserted, int insertedLen);
+
+  // The operation may be merged into the last one: a character typed
+  // after it or removed next to it in the same line
+  bool canMerge(int type, int y, int x, int removedLen,
+                int insertedLen) const;
+
+  // Add an operation to memory (merge it with the last one, if possible)
+  void addOp(int type, int y, int x, const char *removed, int removedLen,
+             const char *inserted, int insertedLen);
+
+  // Append the operation to the log file
+  void writeLog(int type, int y, int x, const char *removed, int removedLen,
+                const char *inserted, int insertedLen);
+
+  bool createLog();
+
+  void reservePool(int n);
+
+  const char *removedText(const Op &op) const { return pool + op.textOffset; }
+  const char *insertedText(const Op &op) const {
+    return pool + op.textOffset + op.removedLen;
+  }
+
+  static int inverseType(int type);
+
+  // Do the operation with the text. Return false if the text
+  // does not match the operation (a log of another text)
+  static bool apply(Text &text, int type, int y, int x, const char *removed,
+                    int removedLen, const char *inserted, int insertedLen);
+};
+
+#endif /* EDIT_JOURNAL_H */
@@ -0,0 +1,162 @@
+// class LineIndex, implementation
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "LineIndex.h"
+
+LineIndex::LineIndex()
+    : fd(-1), data(0), fileSize(0), chunks(0), maxChunks(0), scanned(0),
+      numIndexed(0), thread(), threadStarted(false), numLines(0),
+      finished(true), stopRequested(false) {
+  pthread_mutex_init(&mutex, 0);
+}
+
+bool LineIndex::open(const char *filePath) {
+  close();
+  fd = ::open(filePath, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close();
+    return false;
+  }
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    close();
+    return false;
+  }
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  data = (const char *)p;
+  fileSize = st.st_size;
+
+  // There are at most fileSize lines
+  maxChunks = (int)(fileSize / CHUNK_LINES) + 1;
+  chunks = new long long *[maxChunks];
+  memset(chunks, 0, maxChunks * sizeof(long long *));
+  scanned = 0;
+  numIndexed = 0;
+  numLines = 0;
+  finished = false;
+  stopRequested = false;
+
+  addLine(0);
+  if (scan(FIRST_BLOCK)) {
+    threadStarted = (pthread_create(&thread, 0, run, this) == 0);
+    if (!threadStarted) {
+      while (scan(scanned + SCAN_BLOCK)) {
+      }
+    }
+  }
+  return true;
+}
+
+void LineIndex::close() {
+  if (threadStarted) {
+    pthread_mutex_lock(&mutex);
+    stopRequested = true;
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, 0);
+    threadStarted = false;
+  }
+  if (chunks != 0) {
+    for (int i = 0; i < maxChunks; ++i)
+      delete[] chunks[i];
+    delete[] chunks;
+    chunks = 0;
+  }
+  if (data != 0)
+    munmap((void *)data, fileSize);
+  if (fd >= 0)
+    ::close(fd);
+  fd = (-1);
+  data = 0;
+  fileSize = 0;
+  maxChunks = 0;
+  numLines = 0;
+  finished = true;
+}
+
+int LineIndex::size() const {
+  pthread_mutex_lock(&mutex);
+  int n = numLines;
+  pthread_mutex_unlock(&mutex);
+  return n;
+}
+
+bool LineIndex::isFinished() const {
+  pthread_mutex_lock(&mutex);
+  bool f = finished;
+  pthread_mutex_unlock(&mutex);
+  return f;
+}
+
+void LineIndex::wait() {
+  if (threadStarted) {
+    pthread_join(thread, 0);
+    threadStarted = false;
+  }
+}
+
+long long LineIndex::lineEnd(long long offset) const {
+  const char *p =
+      (const char *)memchr(data + offset, '\n', (size_t)(fileSize - offset));
+  return (p != 0) ? (p - data) : fileSize;
+}
+
+void LineIndex::addLine(long long offset) {
+  int c = numIndexed / CHUNK_LINES;
+  if (chunks[c] == 0)
+    chunks[c] = new long long[CHUNK_LINES];
+  chunks[c][numIndexed % CHUNK_LINES] = offset;
+  ++numIndexed;
+}
+
+bool LineIndex::scan(long long end) {
+  if (end > fileSize)
+    end = fileSize;
+  long long i = scanned;
+#ifdef __SSE2__
+  const __m128i newLine = _mm_set1_epi8('\n');
+  while (i + 16 <= end) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+    int m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newLine));
+    while (m != 0) {
+      long long next = i + __builtin_ctz(m) + 1;
+      if (next < fileSize)
+        addLine(next);
+      m &= m - 1; // Clear the lowest bit
+    }
+    i += 16;
+  }
+#endif
+  while (i < end) {
+    const char *p = (const char *)memchr(data + i, '\n', (size_t)(end - i));
+    if (p == 0)
+      break;
+    i = (p - data) + 1;
+    if (i < fileSize)
+      addLine(i);
+  }
+  scanned = end;
+
+  pthread_mutex_lock(&mutex);
+  numLines = numIndexed; // Publish the lines
+  finished = (scanned >= fileSize);
+  bool goOn = !finished && !stopRequested;
+  pthread_mutex_unlock(&mutex);
+  return goOn;
+}
+
+void *LineIndex::run(void *arg) {
+  LineIndex *index = (LineIndex *)arg;
+  while (index->scan(index->scanned + SCAN_BLOCK)) {
+  }
+  return 0;
+}
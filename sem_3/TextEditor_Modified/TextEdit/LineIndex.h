@@ -0,0 +1,84 @@
+//
+// Index of lines of a file mapped into memory.
+//
+// The file is mapped by mmap, the offsets of the beginnings of lines
+// are found by a background thread (the newlines are searched by SSE2,
+// 16 bytes at once). The first block of the file is indexed at once
+// in open(), so the first lines are available immediately, and the rest
+// of lines appear while the thread goes on.
+//
+// The offsets are kept in chunks that are never moved, so they can be
+// read while the thread appends new ones.
+//
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <pthread.h>
+
+class LineIndex {
+public:
+  enum {
+    CHUNK_LINES = 1 << 16,  // Number of offsets in a chunk
+    FIRST_BLOCK = 1 << 18,  // Size of the block indexed in open()
+    SCAN_BLOCK = 1 << 20    // Size of the block published at once
+  };
+
+private:
+  int fd;
+  const char *data;   // The contents of the file
+  long long fileSize; //
+  long long **chunks; // Offsets of the lines
+  int maxChunks;
+  long long scanned;  // Number of bytes indexed (used by the scanner)
+  int numIndexed;     // Number of lines found (used by the scanner)
+
+  pthread_t thread;
+  bool threadStarted;
+  mutable pthread_mutex_t mutex; // Protects the fields below
+  int numLines;                  // Number of lines published
+  bool finished;                 // The whole file is indexed
+  bool stopRequested;
+
+public:
+  LineIndex();
+  ~LineIndex() {
+    close();
+    pthread_mutex_destroy(&mutex);
+  }
+
+  // Map the file and start indexing.
+  // Returns false, if the file cannot be mapped.
+  bool open(const char *filePath);
+  void close();
+
+  const char *text() const { return data; }
+  long long length() const { return fileSize; }
+
+  // Number of lines indexed so far
+  int size() const;
+  bool isFinished() const;
+
+  // Wait until the whole file is indexed
+  void wait();
+
+  // The offset of the beginning of i-th line, 0 <= i < size()
+  long long lineOffset(int i) const {
+    return chunks[i / CHUNK_LINES][i % CHUNK_LINES];
+  }
+
+  // The end of line beginning at offset (the position of '\n'
+  // or the end of file)
+  long long lineEnd(long long offset) const;
+
+private:
+  LineIndex(const LineIndex &);            // Copying is prohibited
+  LineIndex &operator=(const LineIndex &); //
+
+  // Index the bytes up to the position end and publish the lines found
+  bool scan(long long end);
+  void addLine(long long offset);
+
+  static void *run(void *arg);
+};
+
+#endif /* LINE_INDEX_H */
@@ -1,30 +1,32 @@
 // Implementation of text
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "Text.h"
 
 static const int MIN_EXTENT = 16;
 static const int MAX_EXTENT = 1024;
 static const int EXT_ALIGNMENT = 16;
 
-TextLine::TextLine() : L2ListHeader(), capacity(0), len(0), str(0) {}
+TextLine::TextLine() : capacity(0), len(0), str(0) {}
 
 TextLine::TextLine(const TextLine &line)
-    : L2ListHeader(), capacity(line.capacity), len(line.len), str(0) {
+    : capacity(line.capacity), len(line.len), str(0) {
   if (capacity > 0) {
     str = new char[capacity];
     memmove(str, line.str, len + 1);
   }
 }
 
-TextLine::TextLine(const char *line)
-    : L2ListHeader(), capacity(0), len(0), str(0) {
+TextLine::TextLine(const char *line) : capacity(0), len(0), str(0) {
   setString(line);
 }
 
 TextLine::~TextLine() {
-  delete str;
+  delete[] str;
   // printf("Destructor ~TextLine: this = %p, str=%p\n", this, str);
 }
 
@@ -212,6 +214,14 @@ void TextLine::trim() { // Remove white space at the end of line
 
 bool Text::load(const char *filePath) {
   removeAll();
+  lineIndex = new LineIndex();
+  if (lineIndex->open(filePath))
+    return true; // The lines will be loaded lazily
+  delete lineIndex;
+  lineIndex = 0;
+
+  // Cannot map the file (it is not a regular file or it is empty):
+  // read it by blocks
   FILE *f = fopen(filePath, "r");
   if (f == 0)
     return false;
@@ -266,55 +276,280 @@ bool Text::load(const char *filePath) {
   return true;
 }
 
-bool Text::save(const char *filePath) const {
-  int ret = true;
-  FILE *f = fopen(filePath, "w");
-  if (f == 0)
-    return false;
-  const_iterator i = begin();
-  const_iterator e = end();
-  for (int k = 0; k < size() && i != e; ++k, ++i) {
-    const TextLine &line = (const TextLine &)*i;
-    int l = line.size();
+void Text::convertLine(long long offset, TextLine &line) const {
+  const char *s = lineIndex->text();
+  long long end = lineIndex->lineEnd(offset);
+  line.setSize(0);
+  int pos = 0;
+  int prevChar = 0;
+  for (long long i = offset; i < end; ++i) {
+    int c = s[i];
+    if (prevChar == '\r') {
+      line.append(prevChar);
+      pos++;
+    }
+    if (c == '\t') {
+      // Convert a tabulation into spaces
+      int spacesToAdd = tabWidth - (pos % tabWidth);
+      while (spacesToAdd > 0) {
+        line.append(' ');
+        pos++;
+        spacesToAdd--;
+      }
+    } else if (c != '\r') {
+      line.append(c);
+      pos++;
+    }
+    prevChar = c;
+  }
+  line.truncate(strlen(line.getString())); // As TextLine(const char *)
+  line.trim();
+}
+
+bool Text::writeLines(FILE *f) const {
+  int n = size();
+  for (int k = 0; k < n; ++k) {
+    int l;
+    const char *line = lineView(k, l);
     if (l > 0) {
       // Write a line
-      if (fwrite(line.getString(), 1, l, f) <= 0) {
-        ret = false; // Write error
-        break;
-      }
+      if (fwrite(line, 1, l, f) <= 0)
+        return false; // Write error
     }
     // Write the "end of line" character
-    if (fputc('\n', f) < 0) {
-      ret = false; // Write error
-      break;
-    }
+    if (fputc('\n', f) < 0)
+      return false; // Write error
   }
-  fclose(f);
+  return true;
+}
+
+bool Text::writeInPlace(const char *filePath) {
+  if (lineIndex != 0) {
+    // The file may be the mapped one: all lines are loaded before
+    // the file is truncated, so the mapping is not read any more
+    int n = size();
+    for (int k = 0; k < n; ++k)
+      getLine(k);
+  }
+  FILE *f = fopen(filePath, "w");
+  if (f == 0)
+    return false;
+  bool ret = writeLines(f);
+  if (fclose(f) != 0)
+    ret = false;
   return ret;
 }
 
-TextLine &Text::getLine(int n) {
-  setPointer(n);
-  return (TextLine &)elementAfter();
+bool Text::save(const char *filePath) {
+  if (lineIndex == 0)
+    return writeInPlace(filePath);
+  lineIndex->wait(); // All lines must be known
+
+  // The mapped file may be the same: write a new file beside the real
+  // one (the symbolic links are followed), give it the mode and owner
+  // of the old one and rename it, then the mapped one remains valid.
+  // If it is impossible, the file is written in place.
+  struct stat st;
+  char *realPath = realpath(filePath, 0);
+  if (realPath == 0 || stat(realPath, &st) != 0 || !S_ISREG(st.st_mode)) {
+    free(realPath);
+    return writeInPlace(filePath);
+  }
+  // A new name (mkstemp does not take an existing file)
+  char *path = new char[strlen(realPath) + 8];
+  strcpy(path, realPath);
+  strcat(path, ".XXXXXX");
+  int fd = mkstemp(path);
+  bool ret = (fd >= 0);
+  if (ret && (fchown(fd, st.st_uid, st.st_gid) != 0 ||
+              fchmod(fd, st.st_mode & 07777) != 0)) {
+    close(fd);
+    remove(path);
+    ret = false;
+  }
+  if (!ret) {
+    delete[] path;
+    free(realPath);
+    return writeInPlace(filePath);
+  }
+  FILE *f = fdopen(fd, "w");
+  if (f == 0) {
+    close(fd);
+    ret = false;
+  } else {
+    ret = writeLines(f);
+    if (fclose(f) != 0)
+      ret = false;
+  }
+  if (ret)
+    ret = (rename(path, realPath) == 0);
+  if (!ret)
+    remove(path);
+  delete[] path;
+  free(realPath);
+  return ret;
+}
+
+TextLine &Text::getLine(int n) throw(OutOfRangeException) {
+  if (n < 0 || n >= size())
+    throw OutOfRangeException("Line number out of range");
+  if (n >= bufferSize()) {
+    // Take the lines up to n from the tail into the buffer
+    int p = gapBeg;
+    setPointer(n + 1);
+    setPointer(p);
+  }
+  LineRef &r = (n < gapBeg) ? lines[n] : lines[n + (gapEnd - gapBeg)];
+  if (!isLoadedRef(r)) {
+    // Load the line
+    TextLine *line = new TextLine();
+    convertLine(refOffset(r), *line);
+    r = (LineRef)line;
+  }
+  return *((TextLine *)r);
 }
 
 const char *Text::getString(int n) const {
   if (n < 0 || n >= size())
     return 0;
-  int pos = getPointerPosition();
-  const_iterator i;
-  if (n < pos) {
-    i = endBefore();
-    while (pos != n) {
-      --i;
-      --pos;
-    }
+  LineRef r = ref(n);
+  if (isLoadedRef(r))
+    return ((const TextLine *)r)->getString();
+  convertLine(refOffset(r), viewLine);
+  return viewLine.getString();
+}
+
+const char *Text::lineView(int n, int &len, TextLine &buffer) const {
+  LineRef r = ref(n);
+  if (isLoadedRef(r)) {
+    const TextLine *line = (const TextLine *)r;
+    len = line->length();
+    return line->getString();
+  }
+  // A line of file is shown as it is, if it need not be converted
+  long long offset = refOffset(r);
+  const char *s = lineIndex->text() + offset;
+  int l = (int)(lineIndex->lineEnd(offset) - offset);
+  bool clean = (l == 0 || !isspace(s[l - 1]));
+  for (int i = 0; clean && i < l; ++i) {
+    if (s[i] == '\t' || s[i] == '\r' || s[i] == 0)
+      clean = false;
+  }
+  if (clean) {
+    len = l;
+    return s;
+  }
+  convertLine(offset, buffer);
+  len = buffer.length();
+  return buffer.getString();
+}
+
+Text::~Text() {
+  removeAll();
+  delete[] lines;
+}
+
+void Text::removeAll() {
+  for (int i = 0; i < gapBeg; ++i)
+    deleteRef(lines[i]);
+  for (int i = gapEnd; i < capacity; ++i)
+    deleteRef(lines[i]);
+  gapBeg = 0;
+  gapEnd = capacity;
+  delete lineIndex;
+  lineIndex = 0;
+  tailBeg = 0;
+}
+
+void Text::ensureGap(int n) {
+  if (gapEnd - gapBeg >= n)
+    return;
+  int numAfter = capacity - gapEnd;
+  int newCapacity = 2 * capacity;
+  if (newCapacity < bufferSize() + n)
+    newCapacity = bufferSize() + n;
+  if (newCapacity < MIN_EXTENT)
+    newCapacity = MIN_EXTENT;
+  LineRef *newLines = new LineRef[newCapacity];
+  if (lines != 0) {
+    memmove(newLines, lines, gapBeg * sizeof(LineRef));
+    memmove(newLines + newCapacity - numAfter, lines + gapEnd,
+            numAfter * sizeof(LineRef));
+    delete[] lines;
+  }
+  lines = newLines;
+  capacity = newCapacity;
+  gapEnd = capacity - numAfter;
+}
+
+void Text::moveGap(int n) {
+  if (n < gapBeg) {
+    // Move the lines n..gapBeg-1 to the end of gap
+    int d = gapBeg - n;
+    memmove(lines + gapEnd - d, lines + n, d * sizeof(LineRef));
+    gapBeg -= d;
+    gapEnd -= d;
+  } else if (n > gapBeg) {
+    // Move the first lines after gap to its beginning
+    int d = n - gapBeg;
+    memmove(lines + gapBeg, lines + gapEnd, d * sizeof(LineRef));
+    gapBeg += d;
+    gapEnd += d;
+  }
+}
+
+int Text::setPointer(int n) {
+  if (n < 0)
+    n = 0;
+  int s = size();
+  if (n > s)
+    n = s;
+  int b = bufferSize();
+  if (n <= b) {
+    moveGap(n);
   } else {
-    i = beginAfter();
-    while (pos != n) {
-      ++i;
-      ++pos;
-    }
+    // Take the lines from the tail (they are not loaded)
+    moveGap(b);
+    ensureGap(n - b);
+    while (gapBeg < n)
+      lines[gapBeg++] = lazyRef(lineIndex->lineOffset(tailBeg++));
   }
-  return ((const TextLine &)*i).getString();
+  return gapBeg;
+}
+
+void Text::moveForward() throw(L2ListException) {
+  if (inEnd())
+    throw L2ListException("moveForward: End of list");
+  setPointer(gapBeg + 1);
+}
+
+void Text::moveBack() throw(L2ListException) {
+  if (inBeg())
+    throw L2ListException("moveBack: Beginning of list");
+  lines[--gapEnd] = lines[--gapBeg];
+}
+
+void Text::addBefore(TextLine *l) {
+  ensureGap(1);
+  lines[gapBeg++] = (LineRef)l;
+}
+
+void Text::addAfter(TextLine *l) {
+  ensureGap(1);
+  lines[--gapEnd] = (LineRef)l;
+}
+
+void Text::removeBefore() throw(L2ListException) {
+  if (inBeg())
+    throw L2ListException("removeBefore: Beginning of list");
+  deleteRef(lines[--gapBeg]);
+}
+
+void Text::removeAfter() throw(L2ListException) {
+  if (inEnd())
+    throw L2ListException("removeAfter: End of list");
+  if (gapEnd < capacity)
+    deleteRef(lines[gapEnd++]);
+  else
+    ++tailBeg; // The first line of tail
 }
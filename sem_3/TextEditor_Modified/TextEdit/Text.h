@@ -1,7 +1,9 @@
 #ifndef L2LIST_TEXT_H
 #define L2LIST_TEXT_H
 
-#include "L2List.h"
+#include <stdio.h>
+#include "L2List.h" // L2ListException
+#include "LineIndex.h"
 
 class OutOfRangeException {
 public:
@@ -13,7 +15,7 @@ public:
 //
 // TextLine is the dynamic array of characters
 //
-class TextLine : public L2ListHeader {
+class TextLine {
   int capacity;
   int len; // Not including the terminating zero character
   char *str;
@@ -22,7 +24,7 @@ public:
   TextLine();
   TextLine(const TextLine &line); // Copy constructor
   TextLine(const char *line);
-  virtual ~TextLine();
+  ~TextLine();
 
   // Assignment
   TextLine &operator=(const TextLine &line);
@@ -68,31 +70,156 @@ public:
   void removeAt(int position);
 };
 
-class Text : public L2List {
+//
+// Text is the sequence of lines with a pointer between them
+// (it has the interface of L2List).
+//
+// The lines are kept in a gap buffer: an array of pointers to lines
+// with a gap at the place of the pointer. So the access to the i-th line
+// takes O(1) time, and adding or removing a line at the pointer
+// is O(1) too. Moving the pointer by d lines moves d pointers
+// through the gap (memmove of 8*d bytes), that is much cheaper than
+// walking d elements of a linked list.
+//
+// A file is loaded lazily: it is mapped into memory, and its lines
+// are indexed by a background thread (see LineIndex). A line of file
+// becomes a TextLine only when it is accessed by getLine (i.e. it may be
+// edited); for viewing, lineView gives the characters of the mapped file.
+// The lines of file that the pointer has not passed yet are not
+// in the gap buffer: they follow it in the index ("tail" of text).
+//
+class Text {
+  // An element of gap buffer: a pointer to TextLine
+  // or (offset << 1 | 1) for a line of mapped file not loaded yet
+  typedef size_t LineRef;
+
+  LineRef *lines; // lines[0..gapBeg-1], gap, lines[gapEnd..capacity-1]
+  int capacity;
+  int gapBeg; // Number of lines before the pointer
+  int gapEnd;
+
+  LineIndex *lineIndex; // The mapped file (0, if the text is not mapped)
+  int tailBeg; // The lines lineIndex[tailBeg..] follow the gap buffer
+
+  mutable TextLine viewLine; // A converted line of file for lineView
+
 public:
   int tabWidth; // Size of tabulation
 
-  Text() : L2List(), tabWidth(8) {}
+  Text()
+      : lines(0), capacity(0), gapBeg(0), gapEnd(0), lineIndex(0),
+        tailBeg(0), viewLine(), tabWidth(8) {}
+  ~Text();
 
-  // Load/save text in a file
+  // Load/save text in a file.
+  // A regular file is mapped and loaded lazily (see above).
   bool load(const char *filePath);
-  bool save(const char *filePath) const;
+  bool save(const char *filePath);
+
+  // The number of lines. While the file is indexed, it grows
+  int size() const { return bufferSize() + tailSize(); }
+
+  // The whole file is indexed, size() is final
+  bool isLoaded() const {
+    return (lineIndex == 0 || lineIndex->isFinished());
+  }
+
+  // Wait until the whole file is indexed
+  void waitLoaded() {
+    if (lineIndex != 0)
+      lineIndex->wait();
+  }
 
   // Get a pointer to i-th line, i = 0..size-1
-  TextLine &getLine(int i);
+  TextLine &getLine(int i) throw(OutOfRangeException);
+
+  // The string of i-th line. For a line not loaded it is kept
+  // until the next call of getString or lineView.
   const char *getString(int i) const;
 
-  class iterator : public L2List::iterator {
+  // The characters of i-th line (not terminated by zero),
+  // the line is not loaded. Out: len -- the length of line.
+  const char *lineView(int i, int &len) const {
+    return lineView(i, len, viewLine);
+  }
+
+  // The same, a converted line is put into the buffer
+  // (so the lines may be viewed by different threads)
+  const char *lineView(int i, int &len, TextLine &buffer) const;
+
+  //
+  // The interface of L2List: the pointer is between the lines
+  //
+  void removeAll();
+
+  void moveToBeg() { setPointer(0); }
+  void moveToEnd() { setPointer(size()); }
+
+  bool inBeg() const { return (gapBeg == 0); }
+  bool inEnd() const { return (gapEnd == capacity && tailSize() == 0); }
+
+  void moveForward() throw(L2ListException);
+  void moveBack() throw(L2ListException);
+
+  TextLine &elementAfter() { return getLine(gapBeg); }
+  TextLine &elementBefore() { return getLine(gapBeg - 1); }
+
+  // Add a line before/after the pointer.
+  // The line must be allocated in dynamic memory (using "new")
+  void addBefore(TextLine *line);
+  void addAfter(TextLine *line);
+
+  // Remove (and delete) a line before/after the pointer
+  void removeBefore() throw(L2ListException);
+  void removeAfter() throw(L2ListException);
+
+  // Set the pointer after first n lines, if possible.
+  // Returns the actual number of lines before pointer.
+  int setPointer(int n);
+
+  int getPointerPosition() const { return gapBeg; }
+
+  class iterator {
+  protected:
+    Text *text;
+    int lineNumber; // The number of a line
+
   public:
-    iterator() : L2List::iterator() {}
+    iterator() : text(0), lineNumber(0) {}
 
-    iterator(const L2List::iterator &i) : L2List::iterator(i) {}
+    iterator(Text *t, int i) : text(t), lineNumber(i) {}
+
+    iterator &operator++() {
+      ++lineNumber;
+      return *this;
+    }
 
-    TextLine &operator*() const {
-      return (TextLine &)L2List::iterator::operator*();
+    iterator operator++(int) { // Postfix increment operator
+      iterator tmp = *this;
+      ++lineNumber;
+      return tmp;
     }
 
+    iterator &operator--() {
+      --lineNumber;
+      return *this;
+    }
+
+    iterator operator--(int) { // Postfix decrement operator
+      iterator tmp = *this;
+      --lineNumber;
+      return tmp;
+    }
+
+    TextLine &operator*() const { return text->getLine(lineNumber); }
+
     TextLine *operator->() const { return &(operator*()); }
+
+    bool operator==(const iterator &i) const {
+      return (text == i.text && lineNumber == i.lineNumber);
+    }
+
+    bool operator!=(const iterator &i) const { return !operator==(i); }
   };
 
   class const_iterator : public iterator {
@@ -108,22 +235,63 @@ public:
     const TextLine *operator->() const { return &(operator*()); }
   };
 
-  iterator begin() { return (iterator)L2List::begin(); }
-  iterator end() { return (iterator)L2List::end(); }
-  iterator endBefore() {
-    return (iterator)L2List::endBefore();
-    ;
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size()); }
+
+  // end of lines before pointer
+  iterator endBefore() { return iterator(this, gapBeg); }
+
+  // beginning of lines after pointer
+  iterator beginAfter() { return iterator(this, gapBeg); }
+
+  const_iterator begin() const { return iterator((Text *)this, 0); }
+  const_iterator end() const { return iterator((Text *)this, size()); }
+  const_iterator endBefore() const { return iterator((Text *)this, gapBeg); }
+  const_iterator beginAfter() const {
+    return iterator((Text *)this, gapBeg);
   }
-  iterator beginAfter() { return (iterator)L2List::beginAfter(); }
 
-  const_iterator begin() const { return (const_iterator)L2List::begin(); }
-  const_iterator end() const { return (const_iterator)L2List::end(); }
-  const_iterator endBefore() const {
-    return (const_iterator)L2List::endBefore();
+private:
+  Text(const Text &);            // Copying is prohibited
+  Text &operator=(const Text &); //
+
+  int bufferSize() const { return capacity - (gapEnd - gapBeg); }
+  int tailSize() const {
+    return (lineIndex != 0) ? lineIndex->size() - tailBeg : 0;
   }
-  const_iterator beginAfter() const {
-    return (const_iterator)L2List::beginAfter();
+
+  static bool isLoadedRef(LineRef r) { return (r & 1) == 0; }
+  static LineRef lazyRef(long long offset) {
+    return ((LineRef)offset << 1) | 1;
+  }
+  static long long refOffset(LineRef r) { return (long long)(r >> 1); }
+  static void deleteRef(LineRef r) {
+    if (isLoadedRef(r))
+      delete (TextLine *)r;
   }
+
+  // The reference to i-th line, i = 0..size-1
+  LineRef ref(int i) const {
+    if (i < gapBeg)
+      return lines[i];
+    if (i < bufferSize())
+      return lines[i + (gapEnd - gapBeg)];
+    return lazyRef(lineIndex->lineOffset(tailBeg + i - bufferSize()));
+  }
+
+  // Make the gap at least of n elements
+  void ensureGap(int n);
+
+  // Move the gap to the place after n lines of buffer
+  void moveGap(int n);
+
+  // Convert the line of file at offset as the non-lazy load does:
+  // expand the tabulations, remove '\r' before '\n' and trailing spaces
+  void convertLine(long long offset, TextLine &line) const;
+
+  // Write the lines to the file, false on an error
+  bool writeLines(FILE *f) const;
+  bool writeInPlace(const char *filePath);
 };
 
 #endif /* L2LIST_TEXT_H */
@@ -7,6 +7,8 @@
 #include <signal.h>
 
 #include <limits.h>
+#include <sys/time.h>
+#include <sys/stat.h>
 
 #include <X11/keysym.h> /* X11 key symbols (in "/usr/include/X11/keysymdef.h") */
 #include <X11/Xutil.h>
@@ -116,6 +118,36 @@ const struct TextEdit::CommandDsc TextEdit::editorCommands[] = {
     {XK_Return, 0, ShiftMask, true, &TextEdit::onEnter},   // Enter
     {XK_KP_Enter, 0, ShiftMask, true, &TextEdit::onEnter}, // Enter on keypad
 
+    // Undo, redo
+    {XK_z, ControlMask, ControlMask | ShiftMask, true,
+     &TextEdit::onUndo}, // Ctrl+z
+    {XK_Z, ControlMask, ControlMask | ShiftMask, true,
+     &TextEdit::onUndo}, // Ctrl+Z
+    {XK_y, ControlMask, ControlMask, true, &TextEdit::onRedo}, // Ctrl+y
+    {XK_Y, ControlMask, ControlMask, true, &TextEdit::onRedo}, // Ctrl+Y
+    {XK_z, ControlMask | ShiftMask, ControlMask | ShiftMask, true,
+     &TextEdit::onRedo}, // Ctrl+Shift+z
+    {XK_Z, ControlMask | ShiftMask, ControlMask | ShiftMask, true,
+     &TextEdit::onRedo}, // Ctrl+Shift+Z
+
+    // Search
+    {XK_f, ControlMask, ControlMask, false, &TextEdit::onFind}, // Ctrl+f
+    {XK_F, ControlMask, ControlMask, false, &TextEdit::onFind}, // Ctrl+F
+    {XK_f, Mod1Mask, Mod1Mask, false, &TextEdit::onFindRegex},  // Alt+f
+    {XK_F, Mod1Mask, Mod1Mask, false, &TextEdit::onFindRegex},  // Alt+F
+    {XK_F3, 0, ShiftMask, false, &TextEdit::onFindNext},        // F3
+    {XK_F3, ShiftMask, ShiftMask, false,
+     &TextEdit::onFindPrevious},                                  // Shift+F3
+    {XK_g, ControlMask, ControlMask, false, &TextEdit::onFindNext}, // Ctrl+g
+    {XK_G, ControlMask, ControlMask, false, &TextEdit::onFindNext}, // Ctrl+G
+    {XK_Escape, 0, 0, false, &TextEdit::onEscape},                  // Escape
+
+    // Replace all
+    {XK_r, ControlMask, ControlMask, false, &TextEdit::onReplace}, // Ctrl+r
+    {XK_R, ControlMask, ControlMask, false, &TextEdit::onReplace}, // Ctrl+R
+    {XK_r, Mod1Mask, Mod1Mask, false, &TextEdit::onReplaceRegex},  // Alt+r
+    {XK_R, Mod1Mask, Mod1Mask, false, &TextEdit::onReplaceRegex},  // Alt+R
+
     // Quit
     {XK_q, ControlMask, ControlMask, false, &TextEdit::onQuit}, // Ctrl+q
     {XK_Q, ControlMask, ControlMask, false, &TextEdit::onQuit}, // Ctrl+Q
@@ -131,6 +163,12 @@ const struct TextEdit::CommandDsc TextEdit::editorCommands[] = {
     {0, 0, 0, false, 0} // Terminator
 };
 
+static double currentTime() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.;
+}
+
 static int IOErrorHandler(Display * /* display */) {
   printf("Connection to X Server broken...\n");
   return 0;
@@ -150,7 +188,7 @@ int main(int argc, char *argv[]) {
 }
 
 TextEdit::TextEdit()
-    : GWindow(), text(), cursorX(0), cursorY(0), windowX(0), windowY(0),
+    : GWindow(), text(), journal(), search(text), cursorX(0), cursorY(0), windowX(0), windowY(0),
       windowWidth(80), // Window size in characters (dx, dy)
       windowHeight(24), lastChar(0), textFont(0), fontStruct(),
       fontName(0), // Font name (in X11 form)
@@ -159,7 +197,12 @@ TextEdit::TextEdit()
       fileName("noname.txt"), fileNameSet(false),
       endOfText("[* End of text *]"), textChanged(false), textSaved(false),
       inputDisabled(false), focusIn(true), bgColor(0), fgColor(0),
-      bgStatusLineColor(0), fgStatusLineColor(0) {}
+      bgStatusLineColor(0), fgStatusLineColor(0), damage(),
+      promptMode(PROMPT_NONE), promptRegex(false), promptLine(""),
+      findPattern(""), statusMessage(""), jumpPending(false),
+      jumpAtCursor(false), shownMatches(0), shownFinished(true),
+      showFrameTime(getenv("TEXTEDIT_FRAME_TIME") != 0), frameStart(0.),
+      totalFrameTime(0.), numFrames(0) {}
 
 void TextEdit::createWindow() {
   if (GWindow::m_Display == 0) {
@@ -267,7 +310,39 @@ void TextEdit::loadTextFont() {
 bool TextEdit::loadFile(const char *filePath) {
   setFileName(filePath);
   fileNameSet = true;
-  return text.load(filePath);
+  long long size, time;
+  fileIdentity(filePath, size, time); // Before loading: the base of journal
+  bool res = text.load(filePath);
+  journal.clear();
+  TextLine path;
+  journalPath(filePath, path);
+  journal.openLog(path, size, time);
+
+  // Recover the changes not saved because of a crash
+  int n = journal.recover(text);
+  if (n > 0) {
+    fprintf(stderr, "%d changes are recovered from %s\n", n,
+            path.getString());
+    textChanged = true;
+  }
+  return res;
+}
+
+void TextEdit::journalPath(const char *filePath, TextLine &path) {
+  path = filePath;
+  path.append(".journal");
+}
+
+void TextEdit::fileIdentity(const char *filePath, long long &size,
+                            long long &time) {
+  struct stat st;
+  if (stat(filePath, &st) == 0) {
+    size = (long long)st.st_size;
+    time = (long long)st.st_mtime;
+  } else {
+    size = (-1);
+    time = 0;
+  }
 }
 
 void TextEdit::redrawStatusLine() {
@@ -304,6 +379,30 @@ void TextEdit::drawStatusLine(bool createGC /* = false */) {
 
   drawString(m_IWinRect.width() - 15 * dx, y, "Ctrl+Q to quit");
 
+  // The pattern typed, or the search state, or a message
+  x += 30 * dx;
+  if (promptMode != PROMPT_NONE) {
+    const char *prompt = "Find: ";
+    if (promptMode == PROMPT_REPLACE_PATTERN)
+      prompt = "Replace: ";
+    else if (promptMode == PROMPT_REPLACE_WITH)
+      prompt = "With: ";
+    drawString(x, y, promptRegex ? "Regex " : "");
+    x += (promptRegex ? 6 : 0) * dx;
+    drawString(x, y, prompt);
+    x += strlen(prompt) * dx;
+    drawString(x, y, promptLine);
+    drawString(x + promptLine.length() * dx, y, "_");
+  } else if (search.isActive()) {
+    shownMatches = search.size();
+    shownFinished = search.isFinished();
+    sprintf(statusLine, "%d matches%s", shownMatches,
+            shownFinished ? "" : "...");
+    drawString(x, y, statusLine);
+  } else if (statusMessage.length() > 0) {
+    drawString(x, y, statusMessage);
+  }
+
   if (createGC) {
     // Release the temporary graphic contex, restore the previous GC
     XFreeGC(m_Display, m_GC);
@@ -312,37 +411,33 @@ void TextEdit::drawStatusLine(bool createGC /* = false */) {
 }
 
 void TextEdit::onExpose(XEvent & /* event */) {
-  // Draw a status line
-  drawStatusLine();
+  TextSearch::Lock lock(search);
 
-  // Erase a window
-  setForeground(bgColor);
-  fillRectangle(I2Rectangle(0, topMargin - statusLineMargin, m_IWinRect.width(),
-                            m_IWinRect.height()));
+  // Only the exposed part of window is drawn
+  const XRectangle &clip = clipRectangle();
+  int clipRight = clip.x + clip.width;
+  int clipBottom = clip.y + clip.height;
 
-  // Draw a text in a window
-  setForeground(fgColor);
-  int x = leftMargin;
-  int y = topMargin + ascent;
-  for (int screenY = 0; screenY < windowHeight; screenY++, y += dy) {
-    int textY = windowY + screenY;
-    const TextLine *currentLine;
-    if (textY > text.size()) {
-      break;
-    } else if (textY == text.size()) {
-      currentLine = &(endOfText);
-    } else {
-      currentLine = &(text.getLine(textY));
-    }
-    int len = currentLine->length();
-    if (len > windowX) {
-      int restrictedLen = len - windowX;
-      if (restrictedLen > windowWidth)
-        restrictedLen = windowWidth;
-      drawString(x, y, currentLine->getString() + windowX, restrictedLen);
-    }
+  // Draw a status line
+  if (clip.y < topMargin - statusLineMargin)
+    drawStatusLine();
+
+  // Erase the exposed part of text area
+  int textTop = topMargin - statusLineMargin;
+  if (clipBottom > textTop) {
+    int top = (clip.y > textTop) ? clip.y : textTop;
+    setForeground(bgColor);
+    fillRectangle(I2Rectangle(clip.x, top, clip.width, clipBottom - top));
   }
 
+  // Draw the exposed columns of the exposed lines
+  int x0 = (clip.x - leftMargin) / dx;
+  int y0 = (clip.y - topMargin) / dy;
+  int x1 = (clipRight - leftMargin + dx - 1) / dx;
+  int y1 = (clipBottom - topMargin + dy - 1) / dy;
+  drawTextRectangle(windowX + (x0 > 0 ? x0 : 0), windowY + (y0 > 0 ? y0 : 0),
+                    windowX + x1, windowY + y1);
+
   // Draw cursor
   if (!inputDisabled) {
     drawCursor(cursorX, cursorY, true);
@@ -382,15 +477,17 @@ void TextEdit::drawCursor(int cx, int cy, bool on,
     setForeground(fgColor);
 
   if (cy <= text.size()) {
-    TextLine *line;
+    const char *line;
+    int len;
     if (cy == text.size()) {
-      line = &(endOfText);
+      line = endOfText.getString();
+      len = endOfText.length();
     } else {
-      line = &(text.getLine(cy));
+      line = text.lineView(cy, len);
     }
 
-    if (cx < line->length()) {
-      drawString(x, y + ascent, line->getString() + cx, 1);
+    if (cx < len) {
+      drawString(x, y + ascent, line + cx, 1);
     }
   }
 
@@ -411,7 +508,10 @@ const char *TextEdit::getFileName() const { return fileName; }
 void TextEdit::onKeyPress(XEvent &event) {
   if (inputDisabled)
     return;
+  TextSearch::Lock lock(search);
 
+  if (showFrameTime && frameStart == 0.)
+    frameStart = currentTime(); // The first key press of a series
   preProcessCommand();
 
   // State of modifiers keys (Shift, Controld, Alt, etc.)
@@ -424,9 +524,17 @@ void TextEdit::onKeyPress(XEvent &event) {
   keyNameLen = XLookupString( // define keyboard symbol
       &(event.xkey), keyName, 255, &keySymbol, 0);
 
+  if (promptMode != PROMPT_NONE) {
+    // A pattern is typed
+    onPromptKey(keySymbol, keyName, keyNameLen);
+    postProcessCommand();
+    return;
+  }
+
   // Look up the command in the table
   const struct CommandDsc *command = editorCommands;
   bool commandFound = false;
+  bool changed = false;
   while (!commandFound && command->method != 0) {
     if (keySymbol == command->keysym &&
         (state & command->stateMask) == command->state) {
@@ -440,6 +548,7 @@ void TextEdit::onKeyPress(XEvent &event) {
     (this->*(command->method))(); // Perform the command
     if (command->change) {
       textChanged = true; // Command changes the text
+      changed = true;
     }
   } else if ((state & ControlMask) == 0) {
     // This is not a Control character
@@ -448,19 +557,27 @@ void TextEdit::onKeyPress(XEvent &event) {
       lastChar = keyName[0];
       onCharTyped();
       textChanged = true;
+      changed = true;
     } else if ((keySymbol & 0x8000) == 0) {
       // This is not a special character. Probably, it is a Russian letter
       lastChar = (keySymbol & 0xff);
       onCharTyped();
       textChanged = true;
+      changed = true;
     }
   }
 
+  // The matches are found again in the changed text
+  if (changed && search.isActive())
+    search.restart();
+
   postProcessCommand();
 }
 
 // Actions to be performed before any command
 void TextEdit::preProcessCommand() {
+  journal.beginCommand();
+  statusMessage = "";
   inputDisabled = true; // Disable any input while command is not completed
   drawCursor(cursorX, cursorY, false, true); // Remove cursor
 }
@@ -485,17 +602,35 @@ void TextEdit::postProcessCommand() {
 
   inputDisabled = false;
 
+  // If the next key press is already received, the damaged region
+  // is redrawn after it, so a series of commands is redrawn once
+  if (keyPressPending())
+    return;
+  updateDamage();
+
   drawCursor(cursorX, cursorY, true, true);
   drawStatusLine(true);
+
+  if (showFrameTime) {
+    XSync(m_Display, False); // Wait until the server draws everything
+    double t = currentTime() - frameStart;
+    totalFrameTime += t;
+    ++numFrames;
+    fprintf(stderr, "Frame time %.3f ms (average %.3f ms, %d lines)\n",
+            t * 1000., totalFrameTime * 1000. / numFrames, text.size());
+    frameStart = 0.;
+  }
 }
 
 void TextEdit::onFocusIn(XEvent & /* event */) {
+  TextSearch::Lock lock(search);
   focusIn = true;
   if (!inputDisabled)
     drawCursor(cursorX, cursorY, true, true);
 }
 
 void TextEdit::onFocusOut(XEvent & /* event */) {
+  TextSearch::Lock lock(search);
   focusIn = false;
   drawCursor(cursorX, cursorY, false, true);
 }
@@ -503,6 +638,7 @@ void TextEdit::onFocusOut(XEvent & /* event */) {
 void TextEdit::onButtonPress(XEvent &event) {
   if (inputDisabled)
     return;
+  TextSearch::Lock lock(search);
 
   // Calculate the new position of cursor
   int x = event.xbutton.x;
@@ -596,14 +732,12 @@ void TextEdit::scrollLeft(int n) {
     n = windowX;
   windowX -= n;
   if (n > windowWidth / 2) {
-    redraw();
+    damage.add(0, windowY, INT_MAX, INT_MAX);
   } else {
     int shift = dx * n;
-    XCopyArea(m_Display, m_Window, m_Window, m_GC, leftMargin, topMargin,
-              windowWidth * dx - shift, windowHeight * dy, leftMargin + shift,
-              topMargin);
-    redrawRectangle(
-        I2Rectangle(leftMargin, topMargin, shift, windowHeight * dy));
+    copyArea(leftMargin, topMargin, windowWidth * dx - shift, windowHeight * dy,
+             leftMargin + shift, topMargin);
+    damage.add(windowX, windowY, windowX + n, INT_MAX);
   }
 }
 
@@ -612,14 +746,12 @@ void TextEdit::scrollRight(int n) {
     return;
   windowX += n;
   if (n > windowWidth / 2) {
-    redraw();
+    damage.add(0, windowY, INT_MAX, INT_MAX);
   } else {
     int shift = dx * n;
-    XCopyArea(m_Display, m_Window, m_Window, m_GC, leftMargin + shift,
-              topMargin, windowWidth * dx - shift, windowHeight * dy,
-              leftMargin, topMargin);
-    redrawRectangle(I2Rectangle(leftMargin + windowWidth * dx - shift,
-                                topMargin, shift, windowHeight * dy));
+    copyArea(leftMargin + shift, topMargin, windowWidth * dx - shift,
+             windowHeight * dy, leftMargin, topMargin);
+    damage.add(windowX + windowWidth - n, windowY, INT_MAX, INT_MAX);
   }
 }
 
@@ -630,14 +762,12 @@ void TextEdit::scrollUp(int n) {
     n = windowY;
   windowY -= n;
   if (n > windowHeight / 2) {
-    redraw();
+    damage.add(0, windowY, INT_MAX, INT_MAX);
   } else {
     int shift = dy * n;
-    XCopyArea(m_Display, m_Window, m_Window, m_GC, leftMargin, topMargin,
-              windowWidth * dx, windowHeight * dy - shift, leftMargin,
-              topMargin + shift);
-    redrawRectangle(
-        I2Rectangle(leftMargin, topMargin, windowWidth * dx, shift));
+    copyArea(leftMargin, topMargin, windowWidth * dx, windowHeight * dy - shift,
+             leftMargin, topMargin + shift);
+    damage.add(0, windowY, INT_MAX, windowY + n);
   }
 }
 
@@ -646,15 +776,12 @@ void TextEdit::scrollDown(int n) {
     return;
   windowY += n;
   if (n > windowHeight / 2) {
-    redraw();
+    damage.add(0, windowY, INT_MAX, INT_MAX);
   } else {
     int shift = dy * n;
-    XCopyArea(m_Display, m_Window, m_Window, m_GC, leftMargin,
-              topMargin + shift, windowWidth * dx, windowHeight * dy - shift,
-              leftMargin, topMargin);
-    redrawRectangle(I2Rectangle(leftMargin,
-                                topMargin + windowHeight * dy - shift,
-                                windowWidth * dx, shift));
+    copyArea(leftMargin, topMargin + shift, windowWidth * dx,
+             windowHeight * dy - shift, leftMargin, topMargin);
+    damage.add(0, windowY + windowHeight - n, INT_MAX, INT_MAX);
   }
 }
 
@@ -664,7 +791,7 @@ void TextEdit::onEnd() {
   if (cursorY >= text.size()) {
     cursorX = 0;
   } else {
-    cursorX = text.getLine(cursorY).length();
+    text.lineView(cursorY, cursorX); // The length of line
   }
 }
 
@@ -705,11 +832,15 @@ void TextEdit::onDelete() { // Delete current character
   if (cursorY >= text.size())
     return;
   TextLine &line = text.getLine(cursorY);
+  TextLine oldLine = line;
+  int len = line.length();
   if (cursorX < line.length()) {
     line.removeAt(cursorX);
   }
   line.trim();
-  redrawTextRectangle(cursorX, cursorY, INT_MAX, 1);
+  journal.recordLineChange(cursorY, oldLine.getString(), len,
+                           line.getString(), line.length(), cursorX);
+  damage.add(cursorX, cursorY, len, cursorY + 1);
 }
 
 void TextEdit::onInsert() { // Insert a space
@@ -726,6 +857,7 @@ void TextEdit::onCharTyped() {
     onInsertLine();
   text.setPointer(cursorY);
   TextLine &line = text.getLine(cursorY);
+  TextLine oldLine = line;
 
   if (cursorX > line.length()) {
     int extraSpaces = cursorX - line.length();
@@ -735,15 +867,22 @@ void TextEdit::onCharTyped() {
   }
   line.insert(cursorX, lastChar);
   line.trim();
+  journal.recordLineChange(cursorY, oldLine.getString(), oldLine.length(),
+                           line.getString(), line.length(), cursorX);
   cursorX++;
-  redrawTextRectangle(cursorX - 1, cursorY, INT_MAX, 1, true);
+  // The characters from cursor to the end of line are moved
+  damage.add(cursorX - 1, cursorY, line.length() + 1, cursorY + 1);
 }
 
 /// =================================================================
 void TextEdit::onDeleteWord() {
+  if (cursorY >= text.size())
+    return;
   TextLine &l = text.getLine(cursorY);
-  if (cursorX >= l.length())
+  int len = l.length();
+  if (cursorX >= len)
     return;
+  TextLine oldLine = l;
 
   if (l[cursorX] != ' ') // WORD
   {
@@ -768,7 +907,9 @@ void TextEdit::onDeleteWord() {
       else
         break;
   }
-  redrawTextRectangle(0, cursorY, INT_MAX, INT_MAX);
+  journal.recordLineChange(cursorY, oldLine.getString(), len, l.getString(),
+                           l.length());
+  damage.add(cursorX < 0 ? 0 : cursorX, cursorY, len, cursorY + 1);
 }
 
 /// =================================================================
@@ -776,15 +917,18 @@ void TextEdit::onDeleteWord() {
 void TextEdit::onDeleteLine() {
   if (cursorY >= text.size())
     return;
+  TextLine &line = text.getLine(cursorY);
+  journal.recordDeleteLine(cursorY, line.getString(), line.length());
   text.setPointer(cursorY);
   text.removeAfter();
-  redrawTextRectangle(0, cursorY, INT_MAX, INT_MAX);
+  moveTextLines(cursorY, -1);
 }
 
 void TextEdit::onInsertLine() {
   text.setPointer(cursorY);
   text.addAfter(new TextLine());
-  redrawTextRectangle(0, cursorY, INT_MAX, INT_MAX);
+  journal.recordInsertLine(cursorY, "", 0);
+  moveTextLines(cursorY, 1);
 }
 
 void TextEdit::onEnter() {
@@ -795,17 +939,195 @@ void TextEdit::onEnter() {
     int l = line.length();
     if (cursorX >= l) {
       text.addBefore(new TextLine());
+      journal.recordSplitLine(cursorY, l);
     } else {
       text.addBefore(new TextLine(line.getString() + cursorX));
       line.truncate(cursorX);
+      journal.recordSplitLine(cursorY, cursorX);
+      TextLine head = line;
       line.trim();
+      journal.recordLineChange(cursorY, head.getString(), cursorX,
+                               line.getString(), line.length());
+      damage.add(cursorX, cursorY, l, cursorY + 1);
     }
+    moveTextLines(cursorY + 1, 1);
   } else {
-    text.addBefore(new TextLine());
+    text.addBefore(new TextLine()); // Before the end of text
+    journal.recordInsertLine(cursorY, "", 0);
+    moveTextLines(cursorY, 1);
   }
   cursorX = 0;
   ++cursorY;
-  redrawTextRectangle(0, cursorY - 1, INT_MAX, INT_MAX);
+}
+
+void TextEdit::onUndo() {
+  if (journal.undo(text, cursorX, cursorY))
+    damage.add(0, windowY, INT_MAX, INT_MAX);
+}
+
+void TextEdit::onRedo() {
+  if (journal.redo(text, cursorX, cursorY))
+    damage.add(0, windowY, INT_MAX, INT_MAX);
+}
+
+void TextEdit::onFind() { startPrompt(PROMPT_FIND, false); }
+
+void TextEdit::onFindRegex() { startPrompt(PROMPT_FIND, true); }
+
+void TextEdit::onReplace() { startPrompt(PROMPT_REPLACE_PATTERN, false); }
+
+void TextEdit::onReplaceRegex() { startPrompt(PROMPT_REPLACE_PATTERN, true); }
+
+void TextEdit::startPrompt(int mode, bool regex) {
+  promptMode = mode;
+  promptRegex = regex;
+  promptLine = "";
+}
+
+void TextEdit::onPromptKey(KeySym keySymbol, const char *keyName,
+                           int keyNameLen) {
+  if (keySymbol == XK_Escape) {
+    promptMode = PROMPT_NONE;
+  } else if (keySymbol == XK_Return || keySymbol == XK_KP_Enter) {
+    acceptPrompt();
+  } else if (keySymbol == XK_BackSpace) {
+    if (promptLine.length() > 0)
+      promptLine.truncate(promptLine.length() - 1);
+  } else if (keyNameLen > 0) {
+    if ((unsigned char)keyName[0] >= ' ')
+      promptLine.append(keyName[0]);
+  } else if ((keySymbol & 0x8000) == 0) {
+    promptLine.append(keySymbol & 0xff); // Russian letter
+  }
+}
+
+void TextEdit::acceptPrompt() {
+  int mode = promptMode;
+  promptMode = PROMPT_NONE;
+  if (mode == PROMPT_FIND) {
+    if (search.start(promptLine, promptRegex))
+      findMatch(true);
+    else if (promptLine.length() > 0)
+      statusMessage = "Invalid regular expression";
+  } else if (mode == PROMPT_REPLACE_PATTERN) {
+    if (promptLine.length() == 0)
+      return;
+    findPattern = promptLine;
+    promptMode = PROMPT_REPLACE_WITH;
+    promptLine = "";
+  } else if (mode == PROMPT_REPLACE_WITH) {
+    replaceAll(findPattern, promptRegex, promptLine);
+  }
+}
+
+void TextEdit::onFindNext() {
+  if (search.isActive())
+    findMatch(false);
+}
+
+void TextEdit::onFindPrevious() {
+  if (!search.isActive())
+    return;
+  int i = search.findPrevious(cursorX, cursorY);
+  if (i < 0 && search.isFinished() && search.size() > 0) {
+    i = search.size() - 1;
+    statusMessage = "Search wrapped";
+  }
+  if (i >= 0) {
+    cursorX = search[i].x;
+    cursorY = search[i].y;
+  }
+}
+
+void TextEdit::findMatch(bool atCursor) {
+  jumpPending = false;
+  int i = search.findNext(cursorX, cursorY, atCursor);
+  if (i < 0 && !search.isFinished()) {
+    // The next match is not found yet: go to it later (see onIdle)
+    jumpPending = true;
+    jumpAtCursor = atCursor;
+    return;
+  }
+  if (i < 0 && search.size() > 0) {
+    i = 0;
+    statusMessage = "Search wrapped";
+  }
+  if (i >= 0) {
+    cursorX = search[i].x;
+    cursorY = search[i].y;
+  }
+}
+
+void TextEdit::onEscape() {
+  search.stop();
+  jumpPending = false;
+}
+
+void TextEdit::onIdle() {
+  if (m_Window == 0 || inputDisabled || !search.isActive())
+    return;
+  TextSearch::Lock lock(search);
+  if (jumpPending) {
+    if (search.findNext(cursorX, cursorY, jumpAtCursor) >= 0 ||
+        search.isFinished()) {
+      preProcessCommand();
+      findMatch(jumpAtCursor);
+      postProcessCommand();
+      return;
+    }
+  }
+  if (search.size() != shownMatches || search.isFinished() != shownFinished)
+    drawStatusLine(true);
+}
+
+// Append n characters to a line
+static void appendChars(TextLine &line, const char *s, int n) {
+  line.ensureCapacity(line.length() + n + 1);
+  for (int i = 0; i < n; ++i)
+    line.append(s[i]);
+}
+
+void TextEdit::replaceAll(const char *pattern, bool regex,
+                          const char *replacement) {
+  if (!search.start(pattern, regex)) {
+    statusMessage = "Invalid regular expression";
+    return;
+  }
+  search.searchAll();
+  int n = search.size();
+  int replacementLen = strlen(replacement);
+
+  // Every changed line is built at once
+  TextLine newLine;
+  int i = 0;
+  while (i < n) {
+    int y = search[i].y;
+    TextLine &line = text.getLine(y);
+    const char *s = line.getString();
+    newLine = "";
+    int x = 0;
+    for (; i < n && search[i].y == y; ++i) {
+      const TextSearch::Match &m = search[i];
+      appendChars(newLine, s + x, m.x - x);
+      appendChars(newLine, replacement, replacementLen);
+      x = m.x + m.len;
+    }
+    appendChars(newLine, s + x, line.length() - x);
+    newLine.trim();
+    journal.recordLineChange(y, s, line.length(), newLine.getString(),
+                             newLine.length());
+    line = newLine;
+  }
+  search.stop();
+
+  // All lines are redrawn once
+  if (n > 0) {
+    textChanged = true;
+    damage.add(0, windowY, INT_MAX, INT_MAX);
+  }
+  char message[64];
+  sprintf(message, "%d replaced", n);
+  statusMessage = message;
 }
 
 void TextEdit::onSave() {
@@ -813,6 +1135,11 @@ void TextEdit::onSave() {
     if (text.save(fileName)) {
       textChanged = false;
       textSaved = true;
+
+      // The journal is continued from the saved file
+      long long size, time;
+      fileIdentity(fileName, size, time);
+      journal.resetLog(size, time);
     }
   }
 }
@@ -830,12 +1157,16 @@ bool TextEdit::processQuit() {
     saveDialog.doModal();
     if (saveDialog.buttonPressed == SaveDialog::BUTTON_YES) {
       onSave();
+      if (textChanged)
+        quit = false; // Not saved: the text and its journal are kept
     } else if (saveDialog.buttonPressed == SaveDialog::BUTTON_NO) {
       // Nothing to do.
     } else if (saveDialog.buttonPressed == SaveDialog::BUTTON_CANCEL) {
       quit = false;
     }
   }
+  if (quit)
+    journal.removeLog(); // The text is saved or discarded
   return quit;
 }
 
@@ -843,7 +1174,10 @@ bool TextEdit::processQuit() {
 void TextEdit::close() { destroyWindow(); }
 
 // This virtual method is called when user presses the window close box
-bool TextEdit::onWindowClosing() { return processQuit(); }
+bool TextEdit::onWindowClosing() {
+  TextSearch::Lock lock(search);
+  return processQuit();
+}
 
 void TextEdit::redrawTextRectangle(int x, int y, int w, int h,
                                    bool createGC /* = false */
@@ -855,28 +1189,36 @@ void TextEdit::redrawTextRectangle(int x, int y, int w, int h,
   if (h == INT_MAX)
     y1 = INT_MAX;
 
-  int x0 = x;
+  if (!createGC) {
+    int x0 = (x < windowX) ? windowX : x;
+    int y0 = (y < windowY) ? windowY : y;
+    if (x1 > windowX + windowWidth)
+      x1 = windowX + windowWidth;
+    if (y1 > windowY + windowHeight)
+      y1 = windowY + windowHeight;
+    if (x1 <= x0 || y1 <= y0)
+      return;
+    redrawRectangle(I2Rectangle(leftMargin + (x0 - windowX) * dx,
+                                topMargin + (y0 - windowY) * dy,
+                                (x1 - x0) * dx, (y1 - y0) * dy));
+  } else {
+    damage.add(x, y, x1, y1);
+    updateDamage();
+  }
+}
+
+void TextEdit::drawTextRectangle(int x0, int y0, int x1, int y1) {
   if (x0 < windowX)
     x0 = windowX;
-  int y0 = y;
   if (y0 < windowY)
     y0 = windowY;
-
   if (x1 > windowX + windowWidth)
     x1 = windowX + windowWidth;
   if (y1 > windowY + windowHeight)
     y1 = windowY + windowHeight;
-  if (x1 <= x || y1 <= y)
+  if (x1 <= x0 || y1 <= y0)
     return;
 
-  GC savedGC;
-  if (createGC) {
-    // Save the previous graphic contex, create a temporary GC
-    savedGC = m_GC;
-    m_GC = XCreateGC(m_Display, m_Window, 0, 0);
-    setFont(textFont);
-  }
-
   int left = leftMargin + (x0 - windowX) * dx;
   int top = topMargin + (y0 - windowY) * dy;
   int width = (x1 - x0) * dx;
@@ -887,40 +1229,91 @@ void TextEdit::redrawTextRectangle(int x, int y, int w, int h,
   if (top + height > m_IWinRect.height())
     height -= (top + height - m_IWinRect.height());
 
-  if (!createGC) {
-    redrawRectangle(I2Rectangle(left, top, width, height));
-  } else {
-    // Erase a window
-    setForeground(bgColor);
-    fillRectangle(I2Rectangle(left, top, width, height));
+  // Erase a rectangle
+  setForeground(bgColor);
+  fillRectangle(I2Rectangle(left, top, width, height));
 
-    // Draw a text in a window
-    setForeground(fgColor);
-    int iy = top + ascent;
-    for (int yy = y0; yy < y1; yy++, iy += dy) {
-      const TextLine *currentLine;
-      if (yy > text.size()) {
-        break;
-      } else if (yy == text.size()) {
-        currentLine = &(endOfText);
-      } else {
-        currentLine = &(text.getLine(yy));
-      }
-      int len = currentLine->length();
-      if (len > x0) {
-        len -= x0;
-        if (len > x1 - x0)
-          len = x1 - x0;
-        drawString(left, iy, currentLine->getString() + x0, len);
-      }
+  // Draw a text in a rectangle: only the characters of lines,
+  // the rest is blank
+  setForeground(fgColor);
+  int iy = top + ascent;
+  for (int yy = y0; yy < y1; yy++, iy += dy) {
+    const char *currentLine; // The lines are not loaded for drawing
+    int len;
+    if (yy > text.size()) {
+      break;
+    } else if (yy == text.size()) {
+      currentLine = endOfText.getString();
+      len = endOfText.length();
+    } else {
+      currentLine = text.lineView(yy, len);
+    }
+    if (len > x0) {
+      len -= x0;
+      if (len > x1 - x0)
+        len = x1 - x0;
+      drawString(left, iy, currentLine + x0, len);
     }
   }
+}
 
-  if (createGC) {
-    // Release the temporary graphic contex, restore the previous GC
-    XFreeGC(m_Display, m_GC);
-    m_GC = savedGC;
+void TextEdit::updateDamage() {
+  if (damage.isEmpty() || m_Window == 0)
+    return;
+  // Save the previous graphic contex, create a temporary GC
+  GC savedGC = m_GC;
+  m_GC = XCreateGC(m_Display, m_Window, 0, 0);
+  setFont(textFont);
+
+  for (int i = 0; i < damage.size(); ++i) {
+    const DamageRegion::Rect &r = damage[i];
+    drawTextRectangle(r.x0, r.y0, r.x1, r.y1);
   }
+  damage.clear();
+
+  // Release the temporary graphic contex, restore the previous GC
+  XFreeGC(m_Display, m_GC);
+  m_GC = savedGC;
+}
+
+void TextEdit::copyArea(int x, int y, int w, int h, int destX, int destY) {
+  // The clip rectangle of m_GC may be set by redrawRectangle,
+  // so a temporary GC is used
+  GC gc = XCreateGC(m_Display, m_Window, 0, 0);
+  XCopyArea(m_Display, m_Window, m_Window, gc, x, y, w, h, destX, destY);
+  XFreeGC(m_Display, gc);
+}
+
+void TextEdit::moveTextLines(int y, int n) {
+  damage.moveLines(y, n);
+  int row = y - windowY; // The screen row of line y
+  if (row >= windowHeight)
+    return; // Lines below the window
+  int m = (n > 0) ? n : (-n);
+  int rowsMoved = windowHeight - row - m;
+  if (row < 0 || rowsMoved <= 0) {
+    damage.add(0, (row < 0) ? windowY : y, INT_MAX, INT_MAX);
+    return;
+  }
+  int width = windowWidth * dx;
+  int top = topMargin + row * dy;
+  if (n > 0) {
+    // Move the lines down, the inserted lines are damaged
+    copyArea(leftMargin, top, width, rowsMoved * dy, leftMargin, top + m * dy);
+    damage.add(0, y, INT_MAX, y + m);
+  } else {
+    // Move the lines up, the lines appeared at the bottom are damaged
+    copyArea(leftMargin, top + m * dy, width, rowsMoved * dy, leftMargin, top);
+    damage.add(0, windowY + windowHeight - m, INT_MAX, windowY + windowHeight);
+  }
+}
+
+bool TextEdit::keyPressPending() {
+  if (XPending(m_Display) == 0)
+    return false;
+  XEvent event;
+  XPeekEvent(m_Display, &event);
+  return (event.type == KeyPress && event.xany.window == m_Window);
 }
 
 ///////////////////////////////////////
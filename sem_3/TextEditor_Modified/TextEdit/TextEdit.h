@@ -10,7 +10,10 @@
 #include "GWindow/gwindow.h" // Graphic window interface
 #include <X11/keysym.h>
 
-#include "Text.h" // Text based on L2List
+#include "Text.h" // Text: a gap buffer of lines
+#include "DamageRegion.h"
+#include "EditJournal.h"
+#include "TextSearch.h"
 
 /**
  * Simple text editor.
@@ -18,6 +21,13 @@
 class TextEdit : public GWindow {
   Text text; // Text storage
 
+  // Operations done with the text: undo/redo,
+  // autosave in the file "<fileName>.journal"
+  EditJournal journal;
+
+  // Search of a pattern in the background
+  TextSearch search;
+
   int cursorX; // Cursor position in the text
   int cursorY;
 
@@ -60,6 +70,35 @@ class TextEdit : public GWindow {
   unsigned long bgStatusLineColor; // Status line colors
   unsigned long fgStatusLineColor;
 
+  // The part of text changed by commands, it is redrawn after a command
+  // or after a series of key presses (see postProcessCommand)
+  DamageRegion damage;
+
+  // A pattern (or a replacement) is typed in the status line
+  enum {
+    PROMPT_NONE = 0,
+    PROMPT_FIND,
+    PROMPT_REPLACE_PATTERN,
+    PROMPT_REPLACE_WITH
+  };
+  int promptMode;
+  bool promptRegex;       // The pattern is a regular expression
+  TextLine promptLine;    // The text typed
+  TextLine findPattern;   // The pattern to be replaced
+  TextLine statusMessage; // A message shown in the status line
+  bool jumpPending;       // Go to a match when it is found
+  bool jumpAtCursor;      //     (it may be at the cursor)
+  int shownMatches;       // The search state shown in the status line
+  bool shownFinished;     //
+
+  // Frame time measurement: if the environment variable
+  // TEXTEDIT_FRAME_TIME is set, the time from a key press to the end
+  // of redrawing is printed to stderr
+  bool showFrameTime;
+  double frameStart;
+  double totalFrameTime;
+  int numFrames;
+
 public:
   TextEdit();
   void setFileName(const char *filePath);
@@ -78,6 +117,9 @@ protected:
 
   virtual bool onWindowClosing();
 
+  // Show the progress of search
+  virtual void onIdle();
+
   // Scrolling methods
   void scrollToCursor();
   void scrollLeft(int n);
@@ -127,6 +169,30 @@ protected:
   void onInsertLine(); // Insert an empty above the current
   void onEnter();      // Divide a current line in two pieces
 
+  // Undo/redo the last command changing the text
+  void onUndo();
+  void onRedo();
+
+  // Search and replace
+  void onFind();          // Find a string
+  void onFindRegex();     // Find a regular expression
+  void onFindNext();      // Go to the next match
+  void onFindPrevious();  // Go to the previous match
+  void onReplace();       // Replace all occurrences of a string
+  void onReplaceRegex();  // Replace all matches of a regular expression
+  void onEscape();        // Stop the search
+
+  // A key pressed while a pattern is typed
+  void onPromptKey(KeySym keySymbol, const char *keyName, int keyNameLen);
+  void startPrompt(int mode, bool regex);
+  void acceptPrompt();
+
+  // Move the cursor to the next match
+  void findMatch(bool atCursor);
+
+  // Replace all matches in one command (it is undone at once)
+  void replaceAll(const char *pattern, bool regex, const char *replacement);
+
   // Save file
   void onSave();   // Save a text in a file
   void onSaveAs(); // ...not implemented yet...
@@ -144,10 +210,33 @@ protected:
   // Redraw a rectangle in a text
   void redrawTextRectangle(int x, int y, int w, int h, bool createGC = true);
 
+  // Draw the text in columns x0..x1-1 of lines y0..y1-1 (by current GC)
+  void drawTextRectangle(int x0, int y0, int x1, int y1);
+
+  // Redraw the damaged region
+  void updateDamage();
+
+  // Lines were inserted (n > 0) or removed (n < 0) before the line y:
+  // move the lines below on the screen by XCopyArea,
+  // only the lines that appear are damaged
+  void moveTextLines(int y, int n);
+
+  // Copy a rectangle of window (by a temporary GC)
+  void copyArea(int x, int y, int w, int h, int destX, int destY);
+
+  // The next event is a key press
+  bool keyPressPending();
+
 private:
   void initialize();
   void loadTextFont();
 
+  // The journal file of a text file, the size and
+  // modification time of the text file (-1 if it does not exist)
+  static void journalPath(const char *filePath, TextLine &path);
+  static void fileIdentity(const char *filePath, long long &size,
+                           long long &time);
+
   // Command description
   struct CommandDsc {
     KeySym keysym;              // X11 Key (see "/usr/include/X11/keysymdef.h")
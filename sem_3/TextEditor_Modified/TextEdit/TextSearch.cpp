@@ -0,0 +1,369 @@
+// class TextSearch, implementation
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "TextSearch.h"
+
+void TextSearch::Finder::setPattern(const char *p, int len) {
+  pattern.setString(p, len);
+  for (int c = 0; c < 256; ++c)
+    skip[c] = len;
+  for (int i = 0; i < len - 1; ++i)
+    skip[(unsigned char)p[i]] = len - 1 - i;
+}
+
+int TextSearch::Finder::find(const char *s, int len, int from /* = 0 */
+                             ) const {
+  int m = pattern.length();
+  if (m == 0 || len - from < m)
+    return (-1);
+  const char *p = pattern.getString();
+  if (m == 1) {
+    const char *q = (const char *)memchr(s + from, p[0], len - from);
+    return (q != 0) ? (int)(q - s) : (-1);
+  }
+
+  int i = from;
+#ifdef __SSE2__
+  // Compare the first and the last characters of pattern with
+  // 16 positions at once, the candidates are compared completely
+  __m128i first = _mm_set1_epi8(p[0]);
+  __m128i last = _mm_set1_epi8(p[m - 1]);
+  while (i + m - 1 + 16 <= len) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+    int mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+    while (mask != 0) {
+      int k = __builtin_ctz(mask);
+      if (memcmp(s + i + k + 1, p + 1, m - 2) == 0)
+        return i + k;
+      mask &= mask - 1;
+    }
+    i += 16;
+  }
+#endif
+  // Boyer-Moore-Horspool (the rest of line for SSE2)
+  while (i + m <= len) {
+    unsigned char c = s[i + m - 1];
+    if (c == (unsigned char)p[m - 1] && memcmp(s + i, p, m - 1) == 0)
+      return i;
+    i += skip[c];
+  }
+  return (-1);
+}
+
+TextSearch::TextSearch(Text &t)
+    : text(t), pattern(""), isRegex(false), finder(), useFinder(false),
+      compiledRegex(), regexCompiled(false), matches(0), numMatches(0),
+      capacity(0), nextLine(0), active(false), finished(true), thread(),
+      threadStarted(false), waiters(0), stopRequested(false) {
+  // The editor locks the text again when a modal dialog
+  // is shown from a command
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+TextSearch::~TextSearch() {
+  stop();
+  if (regexCompiled)
+    regfree(&compiledRegex);
+  delete[] matches;
+  pthread_mutex_destroy(&mutex);
+}
+
+void TextSearch::lockText() {
+  __sync_fetch_and_add(&waiters, 1);
+  pthread_mutex_lock(&mutex);
+  __sync_fetch_and_sub(&waiters, 1);
+}
+
+void TextSearch::unlockText() { pthread_mutex_unlock(&mutex); }
+
+bool TextSearch::start(const char *pat, bool regex) {
+  stop();
+  pattern = pat;
+  isRegex = regex;
+  if (regexCompiled) {
+    regfree(&compiledRegex);
+    regexCompiled = false;
+  }
+  if (pattern.length() == 0)
+    return false;
+  if (isRegex) {
+    if (regcomp(&compiledRegex, pat, REG_EXTENDED) != 0)
+      return false;
+    regexCompiled = true;
+    TextLine s("");
+    requiredString(pat, s);
+    useFinder = (s.length() > 0);
+    if (useFinder)
+      finder.setPattern(s.getString(), s.length());
+  } else {
+    finder.setPattern(pat, pattern.length());
+    useFinder = true;
+  }
+  active = true;
+  restart();
+  return true;
+}
+
+void TextSearch::searchAll() {
+  if (!active)
+    return;
+  joinThread();
+  text.waitLoaded();
+  numMatches = 0;
+  TextLine buffer;
+  searchLines(0, text.size(), buffer);
+  nextLine = text.size();
+  finished = true;
+}
+
+void TextSearch::stop() {
+  joinThread();
+  active = false;
+  finished = true;
+  numMatches = 0;
+  nextLine = 0;
+}
+
+void TextSearch::restart() {
+  if (!active)
+    return;
+  numMatches = 0;
+  nextLine = 0;
+  if (finished) {
+    // The thread has ended (or was not started)
+    joinThread();
+    finished = false;
+    startThread();
+  }
+}
+
+void TextSearch::startThread() {
+  stopRequested = false;
+  threadStarted = (pthread_create(&thread, 0, run, this) == 0);
+  if (!threadStarted)
+    searchAll();
+}
+
+void TextSearch::joinThread() {
+  if (threadStarted) {
+    // The thread does not wait for the lock, when stop is requested
+    stopRequested = true;
+    pthread_join(thread, 0);
+    threadStarted = false;
+    stopRequested = false;
+  }
+}
+
+void *TextSearch::run(void *arg) {
+  ((TextSearch *)arg)->search();
+  return 0;
+}
+
+void TextSearch::search() {
+  TextLine buffer;
+  while (true) {
+    // Take the lock when the editor does not need it
+    while (true) {
+      if (stopRequested)
+        return;
+      if (waiters == 0 && pthread_mutex_trylock(&mutex) == 0)
+        break;
+      usleep(200);
+    }
+    if (stopRequested) {
+      pthread_mutex_unlock(&mutex);
+      return;
+    }
+    int n = text.size();
+    if (nextLine >= n) {
+      if (text.isLoaded()) {
+        finished = true;
+        pthread_mutex_unlock(&mutex);
+        return;
+      }
+      // Wait for the next lines of file
+      pthread_mutex_unlock(&mutex);
+      usleep(1000);
+      continue;
+    }
+    int end = nextLine + BLOCK_LINES;
+    if (end > n)
+      end = n;
+    searchLines(nextLine, end, buffer);
+    nextLine = end;
+    pthread_mutex_unlock(&mutex);
+    sched_yield();
+  }
+}
+
+void TextSearch::searchLines(int y0, int y1, TextLine &buffer) {
+  for (int y = y0; y < y1; ++y) {
+    int len;
+    const char *s = text.lineView(y, len, buffer);
+    searchLine(y, s, len, buffer);
+  }
+}
+
+void TextSearch::searchLine(int y, const char *s, int len,
+                            TextLine &buffer) {
+  if (!isRegex) {
+    int m = finder.length();
+    int x = finder.find(s, len);
+    while (x >= 0) {
+      addMatch(y, x, m);
+      x = finder.find(s, len, x + m);
+    }
+    return;
+  }
+
+  if (useFinder && finder.find(s, len) < 0)
+    return; // The line has not the required string
+  // regexec needs a zero-terminated string
+  if (len > 0)
+    buffer.setString(s, len);
+  else
+    buffer = "";
+  const char *str = buffer.getString();
+  int x = 0;
+  int flags = 0;
+  regmatch_t m;
+  while (x <= len && regexec(&compiledRegex, str + x, 1, &m, flags) == 0) {
+    int beg = x + (int)m.rm_so;
+    int end = x + (int)m.rm_eo;
+    if (end > beg) {
+      addMatch(y, beg, end - beg);
+      x = end;
+    } else {
+      x = end + 1; // Empty matches are skipped
+    }
+    flags = REG_NOTBOL;
+  }
+}
+
+void TextSearch::addMatch(int y, int x, int len) {
+  if (numMatches >= capacity) {
+    int newCapacity = (capacity > 0) ? 2 * capacity : 1024;
+    Match *newMatches = new Match[newCapacity];
+    if (numMatches > 0)
+      memmove(newMatches, matches, numMatches * sizeof(Match));
+    delete[] matches;
+    matches = newMatches;
+    capacity = newCapacity;
+  }
+  Match &m = matches[numMatches++];
+  m.y = y;
+  m.x = x;
+  m.len = len;
+}
+
+int TextSearch::findNext(int x, int y, bool atCursor /* = false */) const {
+  // Binary search of the first match after the position
+  int beg = 0;
+  int end = numMatches;
+  while (beg < end) {
+    int mid = (beg + end) / 2;
+    const Match &m = matches[mid];
+    bool before =
+        (m.y < y || (m.y == y && (atCursor ? m.x < x : m.x <= x)));
+    if (before)
+      beg = mid + 1;
+    else
+      end = mid;
+  }
+  return (beg < numMatches) ? beg : (-1);
+}
+
+int TextSearch::findPrevious(int x, int y) const {
+  int beg = 0;
+  int end = numMatches;
+  while (beg < end) {
+    int mid = (beg + end) / 2;
+    const Match &m = matches[mid];
+    if (m.y < y || (m.y == y && m.x < x))
+      beg = mid + 1;
+    else
+      end = mid;
+  }
+  return beg - 1;
+}
+
+void TextSearch::requiredString(const char *regex, TextLine &s) {
+  // Only the strings outside of groups and bracket expressions
+  // are considered; a character followed by '*', '?' or '{' is optional
+  TextLine run("");
+  s = "";
+  int depth = 0;
+  for (const char *p = regex; *p != 0; ++p) {
+    char c = *p;
+    bool ordinary = false;
+    if (c == '|' && depth == 0) {
+      s = ""; // Alternatives: nothing is required
+      return;
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')') {
+      --depth;
+    } else if (c == '[') {
+      // Skip a bracket expression
+      ++p;
+      if (*p == '^')
+        ++p;
+      if (*p == ']')
+        ++p;
+      while (*p != 0 && *p != ']') {
+        if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+          char delimiter = p[1];
+          p += 2;
+          while (*p != 0 && !(*p == delimiter && p[1] == ']'))
+            ++p;
+          if (*p != 0)
+            ++p;
+        }
+        if (*p != 0)
+          ++p;
+      }
+      if (*p == 0)
+        break;
+    } else if (c == '\\') {
+      if (p[1] == 0)
+        break;
+      ++p;
+      c = *p;
+      // An escaped punctuation character is an ordinary one
+      ordinary = (strchr(".[]()*+?{}|^$\\", c) != 0);
+    } else if (c == '*' || c == '?' || c == '{') {
+      if (run.length() > 0)
+        run.truncate(run.length() - 1);
+      if (c == '{') {
+        while (*p != 0 && *p != '}')
+          ++p;
+        if (*p == 0)
+          break;
+      }
+    } else if (strchr(".^$+", c) == 0) {
+      ordinary = true;
+    }
+
+    if (ordinary && depth == 0) {
+      run.append(c);
+    } else {
+      // The run is ended (the last character before '+' is kept)
+      if (run.length() > s.length())
+        s = run;
+      run = "";
+    }
+  }
+  if (run.length() > s.length())
+    s = run;
+}
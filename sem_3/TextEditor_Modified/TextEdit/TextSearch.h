@@ -0,0 +1,140 @@
+//
+// Search of a pattern in Text.
+//
+// All matches of a pattern (a string or a POSIX extended regular
+// expression) are found by a background thread; the matches found so far
+// are available at once, so the editor shows them incrementally.
+//
+// A string is searched by comparing its first and last characters
+// at 16 positions at once (SSE2), only the candidates are compared
+// completely; without SSE2, the Boyer-Moore-Horspool algorithm is used.
+// A regular expression is matched only against the lines that contain
+// the longest string it requires (if it is found in the expression),
+// so most lines are rejected by the fast string search.
+//
+// The thread reads the text, so the text is locked while the editor
+// works with it (see Lock): the thread searches a block of lines at a
+// time and gives the lock to the editor between blocks.
+// After the text is changed, the search is restarted.
+//
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <pthread.h>
+#include <regex.h>
+#include "Text.h"
+
+class TextSearch {
+public:
+  class Match {
+  public:
+    int y;   // Line
+    int x;   // Column
+    int len; // Length
+  };
+
+  // The text is locked by the editor while the object exists
+  class Lock {
+    TextSearch &search;
+
+  public:
+    Lock(TextSearch &s) : search(s) { search.lockText(); }
+    ~Lock() { search.unlockText(); }
+  };
+
+  // A string found by the Boyer-Moore-Horspool algorithm
+  // (or by SSE2 comparisons)
+  class Finder {
+    TextLine pattern;
+    int skip[256]; // Shifts of the BMH algorithm
+
+  public:
+    Finder() : pattern() {}
+    void setPattern(const char *p, int len);
+    int length() const { return pattern.length(); }
+
+    // The first occurrence in s[from..len-1], -1 if none
+    int find(const char *s, int len, int from = 0) const;
+  };
+
+  enum { BLOCK_LINES = 4096 }; // Lines searched without unlocking
+
+private:
+  Text &text;
+
+  TextLine pattern;
+  bool isRegex;
+  Finder finder; // The pattern or a string required by the regex
+  bool useFinder;
+  regex_t compiledRegex;
+  bool regexCompiled;
+
+  Match *matches; // Found (in the order of text)
+  int numMatches;
+  int capacity;
+
+  int nextLine; // The line to be searched by the thread
+  bool active;  // There is a pattern
+  bool finished;
+
+  pthread_t thread;
+  bool threadStarted;
+  pthread_mutex_t mutex;  // Locks the text and all the fields
+  volatile int waiters;   // The editor waits for the lock
+  volatile bool stopRequested;
+
+public:
+  TextSearch(Text &t);
+  ~TextSearch();
+
+  // Start the search of all matches.
+  // Returns false if the regular expression is invalid.
+  bool start(const char *pat, bool regex);
+
+  // Find all matches by the calling thread (the text is loaded
+  // completely), so the matches are final
+  void searchAll();
+
+  // Stop searching and forget the matches
+  void stop();
+
+  // The text was changed: search again from the beginning
+  void restart();
+
+  bool isActive() const { return active; }
+  bool isFinished() const { return finished; }
+  const char *getPattern() const { return pattern.getString(); }
+
+  // The matches found so far (the text must be locked)
+  int size() const { return numMatches; }
+  const Match &operator[](int i) const { return matches[i]; }
+
+  // The index of the first match after (x, y) (or at it, if atCursor)
+  // or -1 if it is not found yet
+  int findNext(int x, int y, bool atCursor = false) const;
+
+  // The index of the last match before (x, y), -1 if none
+  int findPrevious(int x, int y) const;
+
+  void lockText();
+  void unlockText();
+
+private:
+  TextSearch(const TextSearch &);            // Copying is prohibited
+  TextSearch &operator=(const TextSearch &); //
+
+  // Find the matches in the lines y0..y1-1
+  void searchLines(int y0, int y1, TextLine &buffer);
+  void searchLine(int y, const char *s, int len, TextLine &buffer);
+  void addMatch(int y, int x, int len);
+  void startThread();
+  void joinThread();
+
+  static void *run(void *arg);
+  void search();
+
+  // The longest string that every match of regex contains
+  static void requiredString(const char *regex, TextLine &s);
+};
+
+#endif /* TEXT_SEARCH_H */
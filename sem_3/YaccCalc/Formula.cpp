@@ -0,0 +1,236 @@
+// classes ExprTree, Formula, implementation
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Formula.h"
+
+// Stack of evaluation is allocated in memory if it is deeper
+static const int LOCAL_STACK = 64;
+
+int ExprTree::addNode(int type, int left, int right, double value) {
+  if (numNodes >= capacity) {
+    int newCapacity = (capacity > 0) ? 2 * capacity : 64;
+    Node *newNodes = new Node[newCapacity];
+    if (numNodes > 0)
+      memmove(newNodes, nodes, numNodes * sizeof(Node));
+    delete[] nodes;
+    nodes = newNodes;
+    capacity = newCapacity;
+  }
+  Node &n = nodes[numNodes];
+  n.type = type;
+  n.left = left;
+  n.right = right;
+  n.value = value;
+  return numNodes++;
+}
+
+Formula::Formula()
+    : program(0), programLen(0), constants(0), numConstants(0),
+      stackDepth(0) {
+  for (int v = 0; v < NUM_VARIABLES; ++v)
+    used[v] = false;
+}
+
+Formula::~Formula() { clear(); }
+
+void Formula::clear() {
+  delete[] program;
+  delete[] constants;
+  program = 0;
+  constants = 0;
+  programLen = 0;
+  numConstants = 0;
+  stackDepth = 0;
+  for (int v = 0; v < NUM_VARIABLES; ++v)
+    used[v] = false;
+}
+
+void Formula::compile(const ExprTree &tree, int root) {
+  clear();
+  // Every node gives at most one instruction and one constant
+  program = new Instruction[tree.size()];
+  constants = new double[tree.size()];
+  compileNode(tree, root, 1);
+}
+
+void Formula::compileNode(const ExprTree &tree, int i, int depth) {
+  // depth is the depth of stack after the value of node is pushed
+  const ExprTree::Node &node = tree[i];
+  if (depth > stackDepth)
+    stackDepth = depth;
+  switch (node.type) {
+  case ExprTree::CONSTANT:
+    constants[numConstants] = node.value;
+    addInstruction(PUSH_CONST, numConstants++);
+    break;
+  case ExprTree::VARIABLE:
+    used[(int)node.value] = true;
+    addInstruction(PUSH_VAR, (int)node.value);
+    break;
+  case ExprTree::NEGATION:
+    compileNode(tree, node.left, depth);
+    addInstruction(OP_NEG, 0);
+    break;
+  default:
+    compileNode(tree, node.left, depth);
+    compileNode(tree, node.right, depth + 1);
+    // The node types SUM..QUOTIENT have the same order as the codes
+    addInstruction(OP_ADD + (node.type - ExprTree::SUM), 0);
+    break;
+  }
+}
+
+void Formula::addInstruction(int code, int arg) {
+  Instruction &ins = program[programLen++];
+  ins.code = code;
+  ins.arg = arg;
+}
+
+bool Formula::isConstant() const {
+  for (int v = 0; v < NUM_VARIABLES; ++v) {
+    if (used[v])
+      return false;
+  }
+  return true;
+}
+
+double Formula::evaluate(const double *variables) const {
+  if (programLen == 0)
+    return 0.;
+  double localStack[LOCAL_STACK];
+  localStack[0] = 0.; // The compiler cannot see that the program sets it
+  double *stack = localStack;
+  if (stackDepth > LOCAL_STACK)
+    stack = new double[stackDepth];
+
+  int sp = 0; // Stack pointer: the number of values in stack
+  for (int k = 0; k < programLen; ++k) {
+    const Instruction &ins = program[k];
+    switch (ins.code) {
+    case PUSH_CONST:
+      stack[sp++] = constants[ins.arg];
+      break;
+    case PUSH_VAR:
+      stack[sp++] = variables[ins.arg];
+      break;
+    case OP_ADD:
+      --sp;
+      stack[sp - 1] += stack[sp];
+      break;
+    case OP_SUB:
+      --sp;
+      stack[sp - 1] -= stack[sp];
+      break;
+    case OP_MUL:
+      --sp;
+      stack[sp - 1] *= stack[sp];
+      break;
+    case OP_DIV:
+      --sp;
+      stack[sp - 1] /= stack[sp];
+      break;
+    case OP_NEG:
+      stack[sp - 1] = (-stack[sp - 1]);
+      break;
+    }
+  }
+  double res = stack[0];
+  if (stack != localStack)
+    delete[] stack;
+  return res;
+}
+
+void Formula::evaluate(int n, const double *const *columns,
+                       double *result) const {
+  int i = 0;
+  if (programLen == 0) {
+    for (; i < n; ++i)
+      result[i] = 0.;
+    return;
+  }
+#ifdef __SSE2__
+  // A value of stack is BATCH / 2 registers of 2 doubles
+  const int R = BATCH / 2;
+  __m128d *stack = new __m128d[stackDepth * R];
+  const __m128d signMask = _mm_set1_pd(-0.);
+  for (; i + BATCH <= n; i += BATCH) {
+    __m128d *top = stack; // Next free value
+    for (int k = 0; k < programLen; ++k) {
+      const Instruction &ins = program[k];
+      switch (ins.code) {
+      case PUSH_CONST: {
+        __m128d c = _mm_set1_pd(constants[ins.arg]);
+        for (int j = 0; j < R; ++j)
+          top[j] = c;
+        top += R;
+      } break;
+      case PUSH_VAR: {
+        const double *column = columns[ins.arg] + i;
+        for (int j = 0; j < R; ++j)
+          top[j] = _mm_loadu_pd(column + 2 * j);
+        top += R;
+      } break;
+      case OP_ADD:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_add_pd(top[j - R], top[j]);
+        break;
+      case OP_SUB:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_sub_pd(top[j - R], top[j]);
+        break;
+      case OP_MUL:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_mul_pd(top[j - R], top[j]);
+        break;
+      case OP_DIV:
+        top -= R;
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_div_pd(top[j - R], top[j]);
+        break;
+      case OP_NEG:
+        for (int j = 0; j < R; ++j)
+          top[j - R] = _mm_xor_pd(top[j - R], signMask);
+        break;
+      }
+    }
+    for (int j = 0; j < R; ++j)
+      _mm_storeu_pd(result + i + 2 * j, stack[j]);
+  }
+  delete[] stack;
+#endif
+  // The rest of points (all points without SSE2)
+  double variables[NUM_VARIABLES];
+  for (int v = 0; v < NUM_VARIABLES; ++v)
+    variables[v] = 0.;
+  for (; i < n; ++i) {
+    for (int v = 0; v < NUM_VARIABLES; ++v) {
+      if (used[v])
+        variables[v] = columns[v][i];
+    }
+    result[i] = evaluate(variables);
+  }
+}
+
+void Formula::print(FILE *f) const {
+  static const char operations[] = "+-*/";
+  for (int k = 0; k < programLen; ++k) {
+    const Instruction &ins = program[k];
+    if (k > 0)
+      fputc(' ', f);
+    if (ins.code == PUSH_CONST)
+      fprintf(f, "%lg", constants[ins.arg]);
+    else if (ins.code == PUSH_VAR)
+      fputc('a' + ins.arg, f);
+    else if (ins.code == OP_NEG)
+      fputc('~', f);
+    else
+      fputc(operations[ins.code - OP_ADD], f);
+  }
+  fputc('\n', f);
+}
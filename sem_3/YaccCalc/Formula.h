@@ -0,0 +1,121 @@
+//
+// Formulas compiled for repeated evaluation.
+//
+// The parser builds the tree of a formula (ExprTree) instead of
+// computing its value; the tree is compiled to a flat program in
+// reverse Polish notation (Formula). The program is evaluated for
+// many values of the variables without parsing the formula again.
+// A variable is a small latin letter a..z.
+//
+// A column of points is evaluated by BATCH points at once: every
+// instruction of the program is done with SSE2 registers holding
+// several points, so the interpretation costs are shared by the batch.
+//
+#ifndef FORMULA_H
+#define FORMULA_H
+
+#include <stdio.h>
+
+class ExprTree {
+public:
+  enum NodeType {
+    CONSTANT,
+    VARIABLE,
+    SUM,
+    DIFFERENCE,
+    PRODUCT,
+    QUOTIENT,
+    NEGATION
+  };
+
+  class Node {
+  public:
+    int type;
+    int left; // Operands (indices of nodes)
+    int right;
+    double value; // CONSTANT: value, VARIABLE: number of variable
+  };
+
+private:
+  Node *nodes;
+  int numNodes;
+  int capacity;
+
+public:
+  ExprTree() : nodes(0), numNodes(0), capacity(0) {}
+  ~ExprTree() { delete[] nodes; }
+
+  // Forget all nodes (after a formula is processed)
+  void clear() { numNodes = 0; }
+
+  // Add a node, return its index
+  int constant(double value) { return addNode(CONSTANT, -1, -1, value); }
+  int variable(int v) { return addNode(VARIABLE, -1, -1, (double)v); }
+  int binary(int type, int left, int right) {
+    return addNode(type, left, right, 0.);
+  }
+  int negate(int operand) { return addNode(NEGATION, operand, -1, 0.); }
+
+  int size() const { return numNodes; }
+  const Node &operator[](int i) const { return nodes[i]; }
+
+private:
+  ExprTree(const ExprTree &);            // Copying is prohibited
+  ExprTree &operator=(const ExprTree &); //
+
+  int addNode(int type, int left, int right, double value);
+};
+
+class Formula {
+public:
+  enum { NUM_VARIABLES = 26 };
+  enum { BATCH = 8 }; // Points evaluated at once
+
+  enum OpCode { PUSH_CONST, PUSH_VAR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG };
+
+  class Instruction {
+  public:
+    int code;
+    int arg; // PUSH_CONST: index of constant, PUSH_VAR: variable
+  };
+
+private:
+  Instruction *program;
+  int programLen;
+  double *constants;
+  int numConstants;
+  int stackDepth; // Maximal depth of stack during evaluation
+  bool used[NUM_VARIABLES];
+
+public:
+  Formula();
+  ~Formula();
+
+  // Compile the subtree with the root node
+  void compile(const ExprTree &tree, int root);
+
+  bool isCompiled() const { return (programLen > 0); }
+  bool usesVariable(int v) const { return used[v]; }
+  bool isConstant() const;
+
+  // The value for variables[0..NUM_VARIABLES-1] (values of a..z);
+  // a formula which is not compiled is 0
+  double evaluate(const double *variables) const;
+
+  // The values at n points: columns[v][i] is the value of variable v
+  // at the point i (columns[v] may be 0 if the variable is not used)
+  void evaluate(int n, const double *const *columns, double *result) const;
+
+  // Print the program in reverse Polish notation
+  void print(FILE *f) const;
+
+private:
+  Formula(const Formula &);            // Copying is prohibited
+  Formula &operator=(const Formula &); //
+
+  void clear();
+  void compileNode(const ExprTree &tree, int i, int depth);
+  void addInstruction(int code, int arg);
+};
+
+#endif /* FORMULA_H */
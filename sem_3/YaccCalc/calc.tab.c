@@ -90,6 +90,9 @@ enum yytokentype {
 #include "parser.h"
 
 /* Any C++ code may be added here... */
+#include <sys/time.h>
+
+static void formulaParsed(int root);
 
 /* Enabling traces.  */
 #ifndef YYDEBUG
@@ -887,8 +890,8 @@ yyreduce:
   switch (yyn) {
   case 3:
 #line 33 "calc.y"
-  { /* print the result */
-    printf("= %lf\n", yyvsp[-1]);
+  { /* compile and print the result */
+    formulaParsed(yyvsp[-1]);
     ;
   } break;
 
@@ -902,41 +905,42 @@ yyreduce:
   case 5:
 #line 37 "calc.y"
   {
+    exprTree.clear();
     ;
   } break;
 
   case 6:
 #line 40 "calc.y"
   {
-    yyval = yyvsp[-2] + yyvsp[0];
+    yyval = exprTree.binary(ExprTree::SUM, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 7:
 #line 41 "calc.y"
   {
-    yyval = yyvsp[-2] - yyvsp[0];
+    yyval = exprTree.binary(ExprTree::DIFFERENCE, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 8:
 #line 42 "calc.y"
   {
-    yyval = yyvsp[-2] * yyvsp[0];
+    yyval = exprTree.binary(ExprTree::PRODUCT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 9:
 #line 43 "calc.y"
   {
-    yyval = yyvsp[-2] / yyvsp[0];
+    yyval = exprTree.binary(ExprTree::QUOTIENT, yyvsp[-2], yyvsp[0]);
     ;
   } break;
 
   case 10:
 #line 44 "calc.y"
   {
-    yyval = (-yyvsp[0]);
+    yyval = exprTree.negate(yyvsp[0]);
     ;
   } break;
 
@@ -1154,14 +1158,151 @@ yyreturn:
 #line 51 "calc.y"
 
 /*================ 3. The Program Section ================================*/
-int main() {
+ExprTree exprTree;
+static Formula parsedFormula; /* The formula of the last line */
+static bool formulaFound = false;
+static bool syntaxError = false;
+static bool interactive = true;
+
+/* The scanner reads a string (see lex.yy.c) */
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_string(const char *str);
+void yy_delete_buffer(YY_BUFFER_STATE b);
+
+static void benchmark(const char *formula, int n);
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    /* calc formula [number of points] */
+    benchmark(argv[1], (argc > 2) ? atoi(argv[2]) : 1000000);
+    return 0;
+  }
   printf("Enter an expression to evaluate (empty line for quit):\n");
+  printf("(an expression with variables a..z is compiled and printed)\n");
   yyparse();
   return 0;
 }
 
+/* The line "expr ENDL" is parsed: root is the tree of expr */
+static void formulaParsed(int root) {
+  parsedFormula.compile(exprTree, root);
+  exprTree.clear();
+  formulaFound = true;
+  if (!interactive)
+    return;
+  if (parsedFormula.isConstant()) {
+    double variables[Formula::NUM_VARIABLES];
+    printf("= %lf\n", parsedFormula.evaluate(variables));
+  } else {
+    printf("RPN: ");
+    parsedFormula.print(stdout);
+  }
+}
+
+/* Parse the formula in a string to parsedFormula */
+static bool parseString(const char *formula) {
+  int len = strlen(formula);
+  char *line = new char[len + 2];
+  strcpy(line, formula);
+  strcpy(line + len, "\n");
+  formulaFound = false;
+  syntaxError = false;
+  YY_BUFFER_STATE buffer = yy_scan_string(line);
+  yyparse();
+  yy_delete_buffer(buffer);
+  exprTree.clear();
+  delete[] line;
+  return (formulaFound && !syntaxError);
+}
+
+static double currentTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+/* The value of variable v at the point i of benchmark */
+static double pointValue(int v, int i, int n) {
+  return (double)(i + v + 1) / (double)n;
+}
+
+/* Evaluate the formula at n points: parsing the formula for every point
+   is compared with the compiled formula (point by point and in batches) */
+static void benchmark(const char *formula, int n) {
+  interactive = false;
+  if (n <= 0 || !parseString(formula)) {
+    printf("Incorrect formula or number of points\n");
+    return;
+  }
+
+  const int NV = Formula::NUM_VARIABLES;
+  double *columns[NV];
+  for (int v = 0; v < NV; ++v) {
+    columns[v] = 0;
+    if (parsedFormula.usesVariable(v)) {
+      columns[v] = new double[n];
+      for (int i = 0; i < n; ++i)
+        columns[v][i] = pointValue(v, i, n);
+    }
+  }
+  double *values = new double[n];
+  double *batchValues = new double[n];
+  double variables[NV];
+  for (int v = 0; v < NV; ++v)
+    variables[v] = 0.;
+
+  /* Parsing is slow: it is measured at a part of points */
+  int numParsed = n / 100;
+  if (numParsed < 1)
+    numParsed = 1;
+  double t0 = currentTime();
+  for (int i = 0; i < numParsed; ++i) {
+    parseString(formula);
+    for (int v = 0; v < NV; ++v) {
+      if (columns[v] != 0)
+        variables[v] = columns[v][i];
+    }
+    values[i] = parsedFormula.evaluate(variables);
+  }
+  double t1 = currentTime();
+  for (int i = 0; i < n; ++i) {
+    for (int v = 0; v < NV; ++v) {
+      if (columns[v] != 0)
+        variables[v] = columns[v][i];
+    }
+    values[i] = parsedFormula.evaluate(variables);
+  }
+  double t2 = currentTime();
+  parsedFormula.evaluate(n, columns, batchValues);
+  double t3 = currentTime();
+
+  double maxDiff = 0.;
+  for (int i = 0; i < n; ++i) {
+    double a = values[i], b = batchValues[i];
+    if (a == b || (a != a && b != b))
+      continue; // Equal infinities or both NaN
+    double d = fabs(a - b); // NaN if one of them is NaN
+    if (d > maxDiff || d != d)
+      maxDiff = d;
+  }
+  printf("RPN: ");
+  parsedFormula.print(stdout);
+  printf("Parsing for every point: %.1lf ns/point\n",
+         (t1 - t0) * 1e9 / numParsed);
+  printf("Compiled, point by point: %.1lf ns/point\n", (t2 - t1) * 1e9 / n);
+  printf("Compiled, %d points at once: %.1lf ns/point\n", Formula::BATCH,
+         (t3 - t2) * 1e9 / n);
+  printf("Maximal difference of results: %lg\n", maxDiff);
+
+  for (int v = 0; v < NV; ++v)
+    delete[] columns[v];
+  delete[] values;
+  delete[] batchValues;
+}
+
 /* Parse error diagnostics */
 int yyerror(const char *s) {
+  syntaxError = true;
   printf("%s\n", s);
   return 0;
 }
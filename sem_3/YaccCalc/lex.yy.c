@@ -342,6 +342,7 @@ char *yytext;
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include "parser.h" /* Common definitions of parser and scanner.          */
                     /* Includes definitions of terminals                  */
                     /* generated by bison (PLUS, MINUS, etc.)             */
@@ -632,7 +633,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 29 "scan.l"
       {
-        yylval = (double)atoi(yytext);
+        yylval = exprTree.constant((double)atoi(yytext));
         return INT_CONST;
       }
       YY_BREAK
@@ -645,7 +646,7 @@ YY_DECL {
       YY_RULE_SETUP
 #line 40 "scan.l"
       {
-        yylval = atof(yytext);
+        yylval = exprTree.constant(atof(yytext));
         return DOUBLE_CONST;
       }
       YY_BREAK
@@ -660,6 +661,11 @@ YY_DECL {
       YY_RULE_SETUP
 #line 46 "scan.l"
       {
+        /* A variable is an operand like a constant */
+        if (islower((unsigned char)yytext[0])) {
+          yylval = exprTree.variable(yytext[0] - 'a');
+          return DOUBLE_CONST;
+        }
         return ILLEGAL;
       } /* Any other character */
       YY_BREAK
@@ -4,8 +4,13 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-/* The type of values associated with terminals and nonterminals */
-#define YYSTYPE double
+#include "Formula.h"
+
+/* The type of values associated with terminals and nonterminals: */
+/* the index of the node of formula tree                          */
+#define YYSTYPE int
+
+extern ExprTree exprTree; /* The tree of the formula being parsed */
 
 #include "calc.tab.h" /* File generated automatically by bison: */
                       /* contains the definitions of terminals  */